@@ -0,0 +1,86 @@
+#ifndef HE_ANALYSIS_H
+#define HE_ANALYSIS_H
+
+#include "code.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Marks an unreachable instruction's depth, or a function whose effect isn't known */
+#define HE_DEPTH_UNKNOWN INT32_MIN
+
+/**
+ * @brief The shape of the stack at every instruction of decoded code
+ *
+ * Code is split into functions, the entry point and every call target. Depths are
+ * relative to the depth the current function was entered at, so a function called
+ * from many places only has to be looked at once. Arrays indexed by function are
+ * indexed by the function's first instruction.
+ */
+typedef struct he_stack_analysis {
+    /** @brief The code that was analyzed */
+    const he_code *code;
+
+    /** @brief Depth before each instruction, HE_DEPTH_UNKNOWN if it can't be reached */
+    int32_t *depth;
+
+    /** @brief The function each reachable instruction belongs to */
+    size_t *owner;
+
+    /** @brief Net stack effect of each function, HE_DEPTH_UNKNOWN if it never returns */
+    int32_t *effect;
+
+    /** @brief The lowest slot each function touches, negative if it reads its caller's values */
+    int32_t *low;
+
+    /** @brief One past the highest slot each function touches */
+    int32_t *high;
+
+    /** @brief Whether control can reach each instruction from anywhere but the one before it */
+    bool *label;
+
+    /** @brief Describes why the analysis failed, NULL if it didn't */
+    const char *error;
+
+    /** @brief The instruction the analysis failed at */
+    size_t error_index;
+} he_stack_analysis;
+
+/**
+ * @brief Works out the stack depth at every instruction reachable from an entry point
+ *
+ * Fails if an instruction can be reached with two different depths or from two
+ * different functions, if a function returns with two different depths, or if the
+ * entry point's code returns.
+ *
+ * @param analysis The analysis to fill in, destroy it with he_stack_analysis_destroy
+ * even if this fails
+ * @param code The code to analyze
+ * @param entry The index of the instruction execution starts at
+ * @return Whether the code has a consistent stack depth
+ */
+bool he_stack_analysis_run(he_stack_analysis *analysis, const he_code *code, size_t entry);
+
+/**
+ * @brief Destroys an analysis's members
+ * @param analysis The analysis to destroy
+ */
+void he_stack_analysis_destroy(he_stack_analysis *analysis);
+
+/**
+ * @brief Gets how an instruction uses the stack
+ * @param op The opcode
+ * @param reads How many values below the top it looks at
+ * @param delta How much it changes the depth by
+ */
+void he_stack_effect(he_opcode op, int32_t *reads, int32_t *delta);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef HE_BATCH_H
+#define HE_BATCH_H
+
+#include "module.h"
+#include "value.h"
+#include "vm.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Runs a module over many independent inputs at once
+ *
+ * The lanes share one instruction pointer, and each slot of the stack is kept as a
+ * column with one entry per lane. Columns where every lane has the same type are stored
+ * unboxed, so arithmetic and comparisons on them run as one vectorized loop over the
+ * lanes, with an AVX2 version picked at load time on x86-64 Linux.
+ *
+ * Jumps and calls are fine as long as every lane goes the same way. When lanes
+ * disagree on a branch, or an instruction would fail on some of them, the lanes carry on
+ * one at a time on @p vm from that instruction, so each lane ends up with the result
+ * and error he_vm_run would have given it. Only modules he_module_verify accepted with
+ * a bounded stack run lane-parallel, every lane of anything else runs on its own.
+ *
+ * Hot spot counts, profiling and tracing only see the lanes that run on their own.
+ *
+ * @param vm The VM to run lanes on their own with, it's left reset
+ * @param mod The module to run
+ * @param inputs @p input_count values per lane, lane after lane. Each lane's stack
+ * starts with its values, the last one on top
+ * @param input_count The number of values per lane
+ * @param lanes The number of lanes
+ * @param results Where to write the value on the top of each lane's stack when it
+ * halts, left as it was for lanes that fail or halt with an empty stack
+ * @param flags Where to write whether each lane succeeded, can be NULL
+ * @return INTERPRET_SUCCESS if every lane did
+ */
+he_interpret_flag he_vm_run_batch(he_vm *vm, const he_module *mod, const he_value *inputs,
+                                  size_t input_count, size_t lanes, he_value *results,
+                                  he_interpret_flag *flags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef HE_CODE_H
+#define HE_CODE_H
+
+#include "instruction.h"
+#include "module.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief A module's bytecode decoded into an array of fixed-size instructions
+ *
+ * Operands are decoded once at load time: constants are copied into the
+ * instruction and jump/call targets are rewritten into indices into `ops`.
+ */
+typedef struct he_code {
+    /** @brief The decoded instructions, `size + 1` long. The last one is always OP_HALT */
+    he_op *ops;
+
+    /** @brief The number of instructions decoded from the module */
+    size_t size;
+
+    /** @brief Byte offset of every instruction in the module, `size + 1` long */
+    size_t *offsets;
+
+    /** @brief The module the code was decoded from */
+    const he_module *mod;
+
+    /** @brief The module's `id` and `generation` when it was decoded */
+    uint64_t mod_id;
+    uint64_t mod_generation;
+
+    /**
+     * @brief The dispatch table the `handler` fields were filled in from, NULL if they
+     * haven't been. Each interpreter loop has its own table
+     */
+    const void *const *threaded;
+
+    /** @brief Why the last he_code_translate failed, NULL if it didn't */
+    const char *error;
+
+    /** @brief Byte offset of the instruction the last he_code_translate failed at */
+    size_t error_offset;
+} he_code;
+
+/**
+ * @brief Initializes an empty code object
+ * @param code The code to initialize
+ */
+void he_code_init(he_code *code);
+
+/**
+ * @brief Destroys a code object's members
+ * @param code The code to destroy
+ */
+void he_code_destroy(he_code *code);
+
+/**
+ * @brief Decodes a module's bytecode into @p code, replacing whatever it held
+ * @param code The code object to decode into
+ * @param mod The module to decode
+ * @return False if the bytecode was malformed (truncated operands, unknown opcodes,
+ * jumps into the middle of an instruction or out of range constants), `code->error`
+ * says which
+ */
+bool he_code_translate(he_code *code, const he_module *mod);
+
+/**
+ * @brief Checks whether code was decoded from a module as it is now
+ * @param code The decoded code
+ * @param mod The module
+ * @return False if @p code came from another module, or @p mod has changed since
+ */
+static inline bool he_code_is_current(const he_code *code, const he_module *mod) {
+    return code->mod == mod && code->mod_id == mod->id && code->mod_generation == mod->generation;
+}
+
+/**
+ * @brief Maps a byte offset in the module to an instruction index
+ * @param code The decoded code
+ * @param offset The byte offset, must be the start of an instruction or the end of the module
+ * @return The index of the instruction at @p offset, or `code->size + 1` if there is none
+ */
+size_t he_code_index_of(const he_code *code, size_t offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
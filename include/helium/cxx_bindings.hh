@@ -5,6 +5,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <iterator>
+#include <string_view>
 #include <type_traits>
 #include <utility>
 
@@ -38,7 +39,7 @@ namespace helium {
 
       // I know it kind of ruins the point of enum classes, but in this case, I am
       // the one deciding when the values of each one changes
-      return static_cast<std::underlying_type_t<type>>(kind) == m_val.type;
+      return static_cast<std::underlying_type_t<type>>(kind) == he_val_type(&m_val);
     }
 
     bool is_bool() const { return he_val_is_bool(&m_val); }
@@ -57,7 +58,7 @@ namespace helium {
 
       // I know it kind of ruins the point of enum classes, but in this case, I am
       // the one deciding when the values of each one changes
-      return static_cast<type>(m_val.type);
+      return static_cast<type>(he_val_type(&m_val));
     }
 
     operator bool() const { return he_val_as_bool(&m_val); }
@@ -73,6 +74,26 @@ namespace helium {
     operator he_value() const { return m_val; }
   };
 
+  /** @brief Wraps a he_arena with RAII, it has to outlive everything allocated from it */
+  class arena {
+    he_arena m_arena;
+
+  public:
+    explicit arena(std::size_t block_size = 0) : m_arena() { he_arena_init(&m_arena, block_size); }
+
+    arena(const arena &) = delete;
+
+    arena &operator=(const arena &) = delete;
+
+    ~arena() { he_arena_destroy(&m_arena); }
+
+    void reset() { he_arena_reset(&m_arena); }
+
+    he_arena *raw() { return &m_arena; }
+
+    const he_arena *raw() const { return &m_arena; }
+  };
+
   /** @brief Wraps a he_module with RAII */
   class mod {
     he_module m_mod;
@@ -163,6 +184,8 @@ namespace helium {
 
     mod() : m_mod() { he_module_init(&m_mod); }
 
+    explicit mod(he_arena *arena) : m_mod() { he_module_init_arena(&m_mod, arena); }
+
     ~mod() { he_module_destroy(&m_mod); }
 
     void write_byte(std::uint8_t byte) { he_module_write_byte(&m_mod, byte); }
@@ -171,6 +194,21 @@ namespace helium {
 
     void add_constant(value val) { he_module_add_constant(&m_mod, val); }
 
+    bool save(const char *path) const { return he_module_save(&m_mod, path); }
+
+    bool load_mapped(const char *path) {
+      he_module_destroy(&m_mod);
+      return he_module_load_mapped(&m_mod, path);
+    }
+
+    bool optimize(he_opt_level level) { return he_module_optimize(&m_mod, level); }
+
+    bool fuse(std::size_t *fused = nullptr) {
+      return he_module_fuse(&m_mod, he_fusion_rules, he_fusion_rule_count, fused);
+    }
+
+    bool verify(he_verify_error *error = nullptr) { return he_module_verify(&m_mod, error); }
+
     [[nodiscard]] std::size_t ops_size() const { return m_mod.ops.size; }
 
     operator const he_module *() const { return &m_mod; }
@@ -205,6 +243,8 @@ namespace helium {
 
     vm() : m_vm() { he_vm_init(&m_vm); }
 
+    explicit vm(const he_vm_config &config) : m_vm() { he_vm_init_config(&m_vm, &config); }
+
     ~vm() { he_vm_destroy(&m_vm); }
 
     void use(const mod &mod) { he_vm_use(&m_vm, mod.raw()); }
@@ -231,13 +271,19 @@ namespace helium {
 
     operator const he_vm *() const { return &m_vm; }
 
-    value top() const { return value(*m_vm.stack.top); }
+    value top() const { return value(m_vm.stack.sp[-1]); }
+
+    [[nodiscard]] std::size_t stack_size() const { return static_cast<std::size_t>(m_vm.stack.sp - m_vm.stack.base); }
 
     he_vm *raw() { return &m_vm; }
 
     const he_vm *raw() const { return &m_vm; }
 
     [[nodiscard]] std::size_t pc() const { return m_vm.pc; }
+
+    void collect(he_gc_kind kind = GC_MINOR) { he_vm_collect(&m_vm, kind); }
+
+    value new_string(std::string_view str) { return value(he_vm_new_string(&m_vm, str.data(), str.size())); }
   };
 } // namespace helium
 // clang-format on
@@ -0,0 +1,62 @@
+#ifndef HE_DISASM_H
+#define HE_DISASM_H
+
+#include "module.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief The most characters one disassembled instruction takes, with its line break */
+#define HE_DISASM_LINE_MAX 64
+
+/**
+ * @brief Disassembles one instruction into a line like `0000001e: 16 (OP_JMP) arg: 00000004`
+ *
+ * Offsets and jump or call addresses are hex, constant indices decimal. Bytes that
+ * aren't opcodes come out as OP_UNKNOWN, and operands that run past the end of the
+ * bytecode or don't fit a size_t as `arg: ?`, both moving on by a single byte.
+ *
+ * @param mod The module to read from
+ * @param offset Where the instruction starts, moved to the next one
+ * @param buffer Where to write the line, with room for HE_DISASM_LINE_MAX characters.
+ * It isn't NUL-terminated
+ * @return The number of characters written, 0 if @p offset is at the end of the bytecode
+ */
+size_t he_disasm_instruction(const he_module *mod, size_t *offset, char *buffer);
+
+/**
+ * @brief Disassembles as many whole instructions of a range as fit in a buffer
+ *
+ * Call it again with the same @p offset to carry on, so a range of any size can be
+ * disassembled a buffer at a time. A range that starts in the middle of an instruction
+ * decodes as whatever the bytes there happen to be.
+ *
+ * @param mod The module to read from
+ * @param offset Where to start, moved past the last instruction written
+ * @param end Where to stop, clamped to the end of the bytecode
+ * @param buffer Where to write the lines, not NUL-terminated
+ * @param capacity The size of @p buffer, at least HE_DISASM_LINE_MAX to make progress
+ * @return The number of characters written, 0 once @p offset reaches @p end
+ */
+size_t he_disasm_range(const he_module *mod, size_t *offset, size_t end, char *buffer,
+                       size_t capacity);
+
+/**
+ * @brief Disassembles a range of a module to a file
+ * @param mod The module to read from
+ * @param start The offset to start at
+ * @param end Where to stop, clamped to the end of the bytecode
+ * @param file The file to write to
+ * @return Whether everything was written
+ */
+bool he_disasm_file(const he_module *mod, size_t start, size_t end, FILE *file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef HE_EXECUTOR_H
+#define HE_EXECUTOR_H
+
+#include "module.h"
+#include "value.h"
+#include "vm.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief The outcome of running a job */
+typedef struct he_job_result {
+    /** @brief Whether the run succeeded */
+    he_interpret_flag flag;
+
+    /** @brief Whether the stack had a value on it when the run finished */
+    bool has_value;
+
+    /** @brief The value on top of the stack when the run finished, if `has_value` */
+    he_value value;
+
+    /** @brief The VM's error if `flag` is INTERPRET_FAILURE */
+    const char *error;
+} he_job_result;
+
+/**
+ * @brief Called on the worker thread once a job finishes
+ * @param result The job's result, only valid for the duration of the call
+ * @param user_data The job's `user_data`
+ */
+typedef void (*he_job_callback)(const he_job_result *result, void *user_data);
+
+/** @brief A single run of a module */
+typedef struct he_job {
+    /** @brief The module to run, only ever read by the workers */
+    const he_module *mod;
+
+    /** @brief The byte offset in the module to start running at */
+    size_t entry;
+
+    /** @brief Values pushed onto the stack in order before running, must outlive the job */
+    const he_value *inputs;
+
+    /** @brief The number of values in `inputs` */
+    size_t input_count;
+
+    /** @brief Called with the result when the job finishes, may be NULL */
+    he_job_callback callback;
+
+    /** @brief Passed to `callback` */
+    void *user_data;
+} he_job;
+
+/** @brief Somewhere to wait for a job's result */
+typedef struct he_future {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    /** @brief Set once `result` has been filled in */
+    bool done;
+
+    /** @brief The job's result */
+    he_job_result result;
+} he_future;
+
+/** @brief A job waiting in a worker's deque */
+typedef struct he_task {
+    he_job job;
+    he_future *future;
+} he_task;
+
+/** @brief A worker thread, its reusable VM and its job deque */
+typedef struct he_worker {
+    pthread_t thread;
+
+    /** @brief The VM every job on this worker runs on */
+    he_vm vm;
+
+    /** @brief Protects the deque */
+    pthread_mutex_t lock;
+
+    /** @brief Ring buffer of queued tasks */
+    he_task *tasks;
+
+    /** @brief Capacity of `tasks`, always a power of two */
+    size_t capacity;
+
+    /** @brief Index of the oldest task */
+    size_t head;
+
+    /** @brief The number of queued tasks */
+    size_t size;
+
+    /** @brief The executor that owns the worker */
+    struct he_executor *owner;
+} he_worker;
+
+/**
+ * @brief A pool of worker threads that run jobs on their own VMs
+ *
+ * Jobs are spread over the workers' deques. A worker takes the oldest job from its
+ * own deque, and once that is empty it steals the newest job from another worker.
+ */
+typedef struct he_executor {
+    /** @brief The workers */
+    he_worker *workers;
+
+    /** @brief The number of workers */
+    size_t worker_count;
+
+    /** @brief The number of jobs queued but not yet started, only accessed atomically */
+    size_t pending;
+
+    /** @brief Round-robin counter picking the deque for a job, only accessed atomically */
+    size_t next_worker;
+
+    /** @brief Set when the executor is shutting down, only accessed atomically */
+    bool stopping;
+
+    /** @brief Idle workers sleep on `wake` */
+    pthread_mutex_t sleep_lock;
+    pthread_cond_t wake;
+} he_executor;
+
+/**
+ * @brief Initializes a future
+ * @param future The future to initialize
+ */
+void he_future_init(he_future *future);
+
+/**
+ * @brief Destroys a future, its job must have finished
+ * @param future The future to destroy
+ */
+void he_future_destroy(he_future *future);
+
+/**
+ * @brief Checks if a future's job has finished without blocking
+ * @param future The future to check
+ * @return True if the result is ready
+ */
+bool he_future_ready(he_future *future);
+
+/**
+ * @brief Blocks until a future's job has finished
+ * @param future The future to wait on
+ * @return The job's result
+ */
+he_job_result he_future_wait(he_future *future);
+
+/**
+ * @brief Starts an executor's worker threads
+ * @param executor The executor to initialize
+ * @param thread_count The number of workers, 0 uses one per online CPU
+ * @param config The configuration every worker's VM is created with, NULL for the default
+ * @return False if the threads couldn't be started
+ */
+bool he_executor_init(he_executor *executor, size_t thread_count, const he_vm_config *config);
+
+/**
+ * @brief Runs every queued job, then stops and joins the workers
+ * @param executor The executor to destroy
+ */
+void he_executor_destroy(he_executor *executor);
+
+/**
+ * @brief Queues a job on the executor
+ * @param executor The executor to run the job on
+ * @param job The job, copied into the queue
+ * @param future Where the result goes, may be NULL. Must be initialized and outlive the job
+ */
+void he_executor_submit(he_executor *executor, const he_job *job, he_future *future);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef HE_FUSION_H
+#define HE_FUSION_H
+
+#include "instruction.h"
+#include "module.h"
+#include "ngram.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Says that a pair of instructions can be replaced with a single superinstruction */
+typedef struct he_fusion_rule {
+    /** @brief The first instruction of the pair */
+    he_opcode first;
+
+    /** @brief The second instruction of the pair */
+    he_opcode second;
+
+    /** @brief The superinstruction that does the work of both */
+    he_opcode fused;
+} he_fusion_rule;
+
+/** @brief Every superinstruction the VM has a handler for */
+extern const he_fusion_rule he_fusion_rules[];
+
+/** @brief The number of rules in he_fusion_rules */
+extern const size_t he_fusion_rule_count;
+
+/**
+ * @brief Picks the rules worth applying for a workload, based on a profile of it
+ * @param bigrams A profile made by he_vm_profile_ngrams with `n` of 2
+ * @param min_count The fewest times a pair must have run for its rule to be picked
+ * @param out Where to put the picked rules, most frequent first. Must have room for
+ * he_fusion_rule_count rules
+ * @return The number of rules picked
+ */
+size_t he_fusion_select(const he_ngram_table *bigrams, size_t min_count, he_fusion_rule *out);
+
+/**
+ * @brief Rewrites a module's bytecode, replacing pairs of instructions with superinstructions
+ *
+ * Pairs are matched left to right and never overlap. A pair isn't fused if something
+ * jumps to or returns to its second instruction, and jump and call addresses are
+ * updated for the shorter code.
+ *
+ * @param mod The module to rewrite, no VM can be using it
+ * @param rules The rules to apply, all of them from he_fusion_rules
+ * @param rule_count The number of rules
+ * @param fused If not NULL, set to the number of pairs that were fused
+ * @return False if the module's bytecode is malformed or a rule isn't one of
+ * he_fusion_rules, in which case it's left unchanged. A module with nothing to fuse is
+ * also left unchanged, verification included
+ */
+bool he_module_fuse(he_module *mod, const he_fusion_rule *rules, size_t rule_count, size_t *fused);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
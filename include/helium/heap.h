@@ -0,0 +1,301 @@
+#ifndef HE_HEAP_H
+#define HE_HEAP_H
+
+#include "memory.h"
+#include "value.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief The size and alignment of the blocks a heap allocates objects from. Objects
+ * bigger than a quarter of a block get a block of their own
+ */
+#define HE_HEAP_BLOCK_SIZE ((size_t)32 * 1024)
+
+/** @brief The bytes of new objects a heap allocates between minor collections by default */
+#define HE_DEFAULT_NURSERY_SIZE ((size_t)256 * 1024)
+
+/** @brief The bytes of old objects a heap holds before its first major collection */
+#define HE_HEAP_INITIAL_OLD_LIMIT ((size_t)1024 * 1024)
+
+/** @brief What a heap object holds, which decides what the collector traces through */
+typedef enum he_object_kind {
+    /** @brief A he_string, referred to by TYPE_STRING values pointing at its characters */
+    OBJECT_STRING,
+
+    /** @brief A he_array, whose items are traced */
+    OBJECT_ARRAY,
+
+    /** @brief Bytes the collector doesn't look inside */
+    OBJECT_DATA,
+} he_object_kind;
+
+/** @brief The header in front of everything allocated on a heap */
+typedef struct he_object {
+    /** @brief The bytes the object takes up including this header, a multiple of 16 */
+    size_t size;
+
+    /** @brief What follows the header */
+    uint8_t kind;
+
+    /** @brief Set while a collection finds the object reachable */
+    uint8_t marked;
+
+    /** @brief Set while an old array is in the remembered set */
+    uint8_t remembered;
+
+    /** @brief Set once the object has survived a collection */
+    uint8_t old;
+
+    /** @brief Keeps what follows aligned for any type */
+    max_align_t payload[];
+} he_object;
+
+/** @brief An array of values on a heap, TYPE_OBJECT values point at it */
+typedef struct he_array {
+    /** @brief The number of items */
+    size_t length;
+
+    /** @brief The items, set them with he_heap_array_set so the collector sees them */
+    he_value items[];
+} he_array;
+
+/** @brief A value kept alive by the host, the collector treats it as a root */
+typedef struct he_handle {
+    /** @brief The value, can be changed freely */
+    he_value value;
+
+    /** @brief The handles around this one, for walking them all as roots */
+    struct he_handle *prev;
+    struct he_handle *next;
+} he_handle;
+
+/** @brief How much of a heap a collection looks at */
+typedef enum he_gc_kind {
+    /** @brief Only the objects allocated since the last collection */
+    GC_MINOR,
+
+    /** @brief Every object */
+    GC_MAJOR,
+} he_gc_kind;
+
+/** @brief A block of heap objects, defined in heap.c */
+typedef struct he_heap_block he_heap_block;
+
+struct he_heap;
+
+/**
+ * @brief Marks the roots of a collection with he_heap_mark_values
+ * @param heap The heap being collected
+ * @param data The pointer given to he_heap_collect
+ */
+typedef void (*he_heap_roots_fn)(struct he_heap *heap, void *data);
+
+/**
+ * @brief A garbage collected heap of strings, arrays and data
+ *
+ * New objects are bump allocated out of the free space in blocks. A minor collection
+ * marks the objects allocated since the last collection from the roots and the
+ * remembered set, turns the ones that weren't reached back into free space and makes
+ * the rest old where they are, so objects never move and pointers to them stay valid.
+ * A major collection does the same for every object. Blocks left with enough free space
+ * are allocated from again, and blocks left empty are reused or freed.
+ *
+ * Collections only happen when he_heap_collect is called, the heap just asks for one
+ * through `pending`. A heap isn't thread-safe, it belongs to whatever owns its roots.
+ */
+typedef struct he_heap {
+    /** @brief The blocks allocated from since the last collection, the current one first */
+    he_heap_block *nursery;
+
+    /** @brief Empty blocks kept to allocate from */
+    he_heap_block *free_blocks;
+
+    /** @brief The number of blocks in `free_blocks` */
+    size_t free_count;
+
+    /** @brief Blocks with old objects in them and enough free space to allocate from */
+    he_heap_block *recyclable;
+
+    /** @brief Where the next object goes in the current block */
+    uint8_t *cursor;
+
+    /** @brief The end of the free space `cursor` is in */
+    uint8_t *limit;
+
+    /** @brief Every block sorted by address, to tell heap pointers from anything else */
+    he_heap_block **blocks;
+
+    /** @brief The number of blocks in `blocks` */
+    size_t block_count;
+
+    /** @brief The capacity of `blocks` */
+    size_t block_capacity;
+
+    /** @brief Objects reachable while a collection is marking but not yet traced */
+    he_object **gray;
+
+    /** @brief The number of objects in `gray` */
+    size_t gray_count;
+
+    /** @brief The capacity of `gray` */
+    size_t gray_capacity;
+
+    /** @brief Old arrays that were given a pointer to a new object */
+    he_object **remembered;
+
+    /** @brief The number of arrays in `remembered` */
+    size_t remembered_count;
+
+    /** @brief The capacity of `remembered` */
+    size_t remembered_capacity;
+
+    /** @brief The handles, allocated from `handle_pool` */
+    he_handle *handles;
+
+    /** @brief Where handles come from */
+    he_pool handle_pool;
+
+    /** @brief The bytes of new objects that trigger a minor collection */
+    size_t nursery_size;
+
+    /** @brief The bytes of objects allocated since the last collection */
+    size_t nursery_bytes;
+
+    /** @brief The bytes of old objects that trigger a major collection */
+    size_t old_limit;
+
+    /** @brief The bytes of old objects, counting dead ones until a major collection */
+    size_t old_bytes;
+
+    /** @brief Set once enough has been allocated that a collection is due */
+    bool pending;
+
+    /** @brief The kind of collection that's due */
+    he_gc_kind pending_kind;
+
+    /** @brief Set while a collection is running */
+    bool collecting;
+
+    /** @brief The kind of the collection that's running */
+    he_gc_kind collecting_kind;
+
+    /** @brief The bytes of every object allocated since the heap was initialized */
+    size_t bytes_allocated;
+
+    /** @brief The bytes of blocks the heap holds */
+    size_t bytes_reserved;
+
+    /** @brief The bytes of objects the last collection found alive */
+    size_t bytes_live;
+
+    /** @brief The number of minor collections run */
+    size_t minor_collections;
+
+    /** @brief The number of major collections run */
+    size_t major_collections;
+} he_heap;
+
+/**
+ * @brief Initializes an empty heap, no memory is allocated until it's used
+ * @param heap The heap to initialize
+ * @param nursery_size The bytes to allocate between minor collections, 0 for
+ * HE_DEFAULT_NURSERY_SIZE
+ */
+void he_heap_init(he_heap *heap, size_t nursery_size);
+
+/**
+ * @brief Frees every object and handle on a heap
+ * @param heap The heap to destroy
+ */
+void he_heap_destroy(he_heap *heap);
+
+/**
+ * @brief Allocates a string on a heap
+ *
+ * If the characters are already interned the interned string is returned instead, so
+ * strings the program already knows about aren't copied.
+ *
+ * @param heap The heap to allocate from
+ * @param chars The characters, they don't need to be NUL terminated
+ * @param length The number of characters
+ * @return A string value, alive as long as it's reachable from the heap's roots
+ */
+he_value he_heap_string(he_heap *heap, const char *chars, size_t length);
+
+/**
+ * @brief Allocates an array on a heap, every item starts out as false
+ * @param heap The heap to allocate from
+ * @param length The number of items
+ * @return An object value pointing at the he_array
+ */
+he_value he_heap_array(he_heap *heap, size_t length);
+
+/**
+ * @brief Allocates bytes on a heap that the collector doesn't look inside
+ * @param heap The heap to allocate from
+ * @param size The number of bytes
+ * @return An object value pointing at the bytes, zeroed and aligned for any type
+ */
+he_value he_heap_data(he_heap *heap, size_t size);
+
+/**
+ * @brief Stores a value in an array on a heap, recording old arrays that start
+ * pointing at new objects so minor collections don't free them
+ * @param heap The heap the array is on
+ * @param array The array
+ * @param index The item to set, must be in bounds
+ * @param value The value to store
+ */
+void he_heap_array_set(he_heap *heap, he_array *array, size_t index, he_value value);
+
+/**
+ * @brief Finds the object a value points at on a heap
+ * @param heap The heap
+ * @param value The value
+ * @return The object's header, NULL if the value doesn't point at anything on @p heap
+ */
+he_object *he_heap_object_of(const he_heap *heap, const he_value *value);
+
+/**
+ * @brief Keeps a value alive until the handle is released
+ * @param heap The heap the value is on
+ * @param value The value
+ * @return A handle holding the value
+ */
+he_handle *he_heap_handle(he_heap *heap, he_value value);
+
+/**
+ * @brief Releases a handle, the value it held can be collected if nothing else refers to it
+ * @param heap The heap the handle came from
+ * @param handle The handle, can be NULL
+ */
+void he_heap_release(he_heap *heap, he_handle *handle);
+
+/**
+ * @brief Marks values as reachable, only valid from a he_heap_roots_fn
+ * @param heap The heap being collected
+ * @param values The values, anything not on the heap is skipped
+ * @param count The number of values
+ */
+void he_heap_mark_values(he_heap *heap, const he_value *values, size_t count);
+
+/**
+ * @brief Frees every object that can't be reached from the roots. Handles are always roots
+ * @param heap The heap to collect
+ * @param kind Whether to collect the nursery or everything
+ * @param roots Marks the rest of the roots, can be NULL
+ * @param data Passed to @p roots
+ */
+void he_heap_collect(he_heap *heap, he_gc_kind kind, he_heap_roots_fn roots, void *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,8 +1,17 @@
 #ifndef HE_HELIUM_H
 #define HE_HELIUM_H
 
+#include "batch.h"
+#include "disasm.h"
+#include "fusion.h"
+#include "heap.h"
 #include "instruction.h"
+#include "jit.h"
+#include "module_file.h"
+#include "optimize.h"
+#include "trace.h"
 #include "value.h"
+#include "verify.h"
 #include "vm.h"
 
 #endif
\ No newline at end of file
@@ -3,7 +3,9 @@
 
 #include "value.h"
 #include <assert.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -15,14 +17,14 @@ typedef enum he_opcode {
     OP_RET = 0,
 
     /**
-     * @brief Pushes the next address onto the return addr stack and
-     * reads next 8 bytes as an address and jumps to it
+     * @brief Pushes the next address onto the return addr stack and jumps to the
+     * address in its operand, a ULEB128 value as written by he_module_write_int
      */
     OP_CALL,
 
     /**
-     * @brief Reads the next 8 bytes as an index for the constant pool, and
-     * pushes the item at that index onto the stack
+     * @brief Reads its operand, a ULEB128 value as written by he_module_write_int, as an
+     * index for the constant pool, and pushes the item at that index onto the stack
      */
     OP_LOAD_CONST,
 
@@ -62,7 +64,7 @@ typedef enum he_opcode {
     /** @brief Pops 1 value, negates it. Returns -value */
     OP_NEGATE,
 
-    /** @brief Reads the next 8 bytes as an address */
+    /** @brief Jumps to its operand, a ULEB128 address as written by he_module_write_int */
     OP_JMP,
 
     /** @brief Checks if the stack value is 0, if it does, pops and jumps to */
@@ -73,19 +75,126 @@ typedef enum he_opcode {
 
     /** @brief Pops a value off of the stack */
     OP_POP,
+
+    /** @brief Pushes a copy of the value on the top of the stack */
+    OP_DUP,
+
+    /** @brief Stops execution, the decoder also appends one to the end of every module */
+    OP_HALT,
+
+    // superinstructions, only produced by he_module_fuse. each one does exactly what
+    // the pair of instructions it's named after would do
+
+    /** @brief OP_LOAD_CONST then OP_ADD, the operand is the constant's index */
+    OP_LOAD_CONST_ADD,
+
+    /** @brief OP_LOAD_CONST then OP_SUB, the operand is the constant's index */
+    OP_LOAD_CONST_SUB,
+
+    /** @brief OP_LT then OP_JZ, the operand is the jump's address */
+    OP_LT_JZ,
+
+    /** @brief OP_LT then OP_JNZ, the operand is the jump's address */
+    OP_LT_JNZ,
+
+    /** @brief OP_GT then OP_JZ, the operand is the jump's address */
+    OP_GT_JZ,
+
+    /** @brief OP_GT then OP_JNZ, the operand is the jump's address */
+    OP_GT_JNZ,
+
+    /** @brief OP_EQ then OP_NOT */
+    OP_EQ_NOT,
+
+    // quickened instructions, never in bytecode. the stack interpreter rewrites an
+    // instruction's `he_op::quick` to one of these once it has seen the types it runs on,
+    // and back to `he_op::op` if the operands stop matching
+
+    /** @brief OP_ADD on two integers */
+    OP_ADD_INT,
+
+    /** @brief OP_ADD on two floats */
+    OP_ADD_FLOAT,
+
+    /** @brief OP_SUB on two integers */
+    OP_SUB_INT,
+
+    /** @brief OP_SUB on two floats */
+    OP_SUB_FLOAT,
+
+    /** @brief OP_MUL on two integers */
+    OP_MUL_INT,
+
+    /** @brief OP_MUL on two floats */
+    OP_MUL_FLOAT,
+
+    /** @brief OP_GT on two integers */
+    OP_GT_INT,
+
+    /** @brief OP_GT on two floats */
+    OP_GT_FLOAT,
+
+    /** @brief OP_LT on two integers */
+    OP_LT_INT,
+
+    /** @brief OP_LT on two floats */
+    OP_LT_FLOAT,
+
+    /** @brief OP_GTEQ on two integers */
+    OP_GTEQ_INT,
+
+    /** @brief OP_GTEQ on two floats */
+    OP_GTEQ_FLOAT,
+
+    /** @brief OP_LTEQ on two integers */
+    OP_LTEQ_INT,
+
+    /** @brief OP_LTEQ on two floats */
+    OP_LTEQ_FLOAT,
+
+    /** @brief OP_LOAD_CONST_ADD with an integer on the stack and an integer constant */
+    OP_LOAD_CONST_ADD_INT,
+
+    /** @brief OP_LOAD_CONST_SUB with an integer on the stack and an integer constant */
+    OP_LOAD_CONST_SUB_INT,
+
+    /** @brief OP_LT_JZ on two integers */
+    OP_LT_JZ_INT,
+
+    /** @brief OP_LT_JNZ on two integers */
+    OP_LT_JNZ_INT,
+
+    /** @brief OP_GT_JZ on two integers */
+    OP_GT_JZ_INT,
+
+    /** @brief OP_GT_JNZ on two integers */
+    OP_GT_JNZ_INT,
 } __attribute__((packed)) he_opcode;
 
+/** @brief The number of opcodes, every valid opcode is less than this */
+#define HE_OPCODE_COUNT (OP_EQ_NOT + 1)
+
+/** @brief The number of opcodes the interpreter dispatches on, including the quickened ones */
+#define HE_DISPATCH_OPCODE_COUNT (OP_GT_JNZ_INT + 1)
+
+#ifdef __cplusplus
+static_assert(sizeof(he_opcode) == sizeof(uint8_t), "op_code should be same size as byte");
+#else
 _Static_assert(sizeof(he_opcode) == sizeof(uint8_t), "op_code should be same size as byte");
+#endif
 
 /** @brief Represents a call op */
 typedef struct he_op_call {
+    /** @brief The index of the instruction being called */
+    size_t address;
+
     /** @brief The address / PC of where to return to */
     size_t return_address;
 } he_op_call;
 
 /** @brief Represents one of the jump ops (jmp/jz/jnz) */
 typedef struct he_op_jmp {
-    /** @brief The address to jump to if the condition is met */
+    /** @brief The index of the instruction to jump to if the condition is met */
     size_t address;
 } he_op_jmp;
 
@@ -95,10 +204,26 @@ typedef struct he_op_push {
     struct he_value val;
 } he_op_push;
 
-/** @brief Represents a single instruction */
+/** @brief Represents a single decoded instruction */
 typedef struct he_op {
+    /** @brief Address of the interpreter's handler for `op`, NULL until the code is threaded */
+    const void *handler;
+
+    /** @brief The instruction's opcode */
     he_opcode op;
 
+    /** @brief What the stack interpreter dispatches on, `op` or a quickened form of it */
+    he_opcode quick;
+
+    /** @brief How many times a quickened form has gone back to `op`, which stops at a limit */
+    uint8_t deopts;
+
+    /**
+     * @brief How many times the stack interpreter reached this instruction through a
+     * backward jump or a call, while hot spots are being counted. Stops at UINT32_MAX
+     */
+    uint32_t hits;
+
     union he_op_as {
         he_op_call call;
         he_op_jmp jmp;
@@ -106,6 +231,34 @@ typedef struct he_op {
     } op_object;
 } he_op;
 
+/**
+ * @brief Checks whether an opcode is followed by an operand in the bytecode
+ * @param op The opcode to check
+ * @return True if @p op has an operand
+ */
+bool he_opcode_has_operand(he_opcode op);
+
+/**
+ * @brief Checks whether a byte is a known opcode
+ * @param byte The byte to check
+ * @return True if @p byte is a valid he_opcode
+ */
+bool he_opcode_is_valid(uint8_t byte);
+
+/**
+ * @brief Checks whether an opcode's operand is a jump address
+ * @param op The opcode to check
+ * @return True if @p op is a jump or a fused jump
+ */
+bool he_opcode_is_jump(he_opcode op);
+
+/**
+ * @brief Gets the name of an opcode, like "OP_ADD"
+ * @param op The opcode, quickened ones included
+ * @return A static string, "OP_UNKNOWN" if @p op isn't an opcode
+ */
+const char *he_opcode_name(he_opcode op);
+
 #ifdef __cplusplus
 }
 #endif
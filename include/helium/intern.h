@@ -0,0 +1,108 @@
+#ifndef HE_INTERN_H
+#define HE_INTERN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief A string, either interned or on a VM's heap. String values point at `chars`,
+ * so the length and hash are found just before the characters
+ */
+typedef struct he_string {
+    /** @brief FNV-1a hash of the characters, cached for hash tables keyed by strings */
+    uint64_t hash;
+
+    /** @brief The number of characters, not counting the NUL after them */
+    size_t length;
+
+    /** @brief False for strings on a heap, which can have the same characters as another */
+    bool interned;
+
+    /** @brief The characters, followed by a NUL */
+    char chars[];
+} he_string;
+
+/**
+ * @brief Gets the interned string with the same characters as @p chars, adding a copy
+ * to the intern table if there isn't one yet
+ *
+ * There is one table for the whole process, shared by every module and VM, and it can
+ * be used from any thread. Two interned strings are equal exactly when their pointers
+ * are, so comparing them never looks at the characters.
+ *
+ * Strings aren't counted or owned by anything, so destroying the modules and VMs that use
+ * them doesn't free them. The table holds every distinct string interned since the
+ * process started, or since the last he_intern_clear. A process that keeps loading
+ * modules with new strings keeps growing it.
+ *
+ * @param chars The characters, they don't need to be NUL terminated
+ * @param length The number of characters
+ * @return The interned characters, NUL terminated and alive until he_intern_clear
+ */
+const char *he_intern(const char *chars, size_t length);
+
+/**
+ * @brief Looks up the interned string with the same characters as @p chars
+ * @param chars The characters, they don't need to be NUL terminated
+ * @param length The number of characters
+ * @return The interned characters, NULL if they haven't been interned
+ */
+const char *he_intern_find(const char *chars, size_t length);
+
+/**
+ * @brief Gets the header of a string returned by he_intern or allocated on a heap
+ * @param chars The interned characters
+ * @return The string the characters belong to
+ */
+static inline const he_string *he_string_of(const char *chars) {
+    return (const he_string *)(const void *)(chars - offsetof(he_string, chars));
+}
+
+/**
+ * @brief Compares two strings, by pointer unless one of them is on a heap
+ * @param lhs The characters of one string
+ * @param rhs The characters of the other
+ * @return True if they hold the same characters
+ */
+static inline bool he_string_equal(const char *lhs, const char *rhs) {
+    if (lhs == rhs) { return true; }
+
+    const he_string *a = he_string_of(lhs);
+    const he_string *b = he_string_of(rhs);
+
+    // two interned strings are only equal if they're the same string
+    if (a->interned && b->interned) { return false; }
+
+    return a->hash == b->hash && a->length == b->length &&
+           memcmp(a->chars, b->chars, a->length) == 0;
+}
+
+/**
+ * @brief Hashes characters the way the intern table does
+ * @param chars The characters
+ * @param length The number of characters
+ * @return The hash
+ */
+uint64_t he_string_hash(const char *chars, size_t length);
+
+/** @brief The number of strings in the intern table */
+size_t he_intern_count(void);
+
+/**
+ * @brief Frees every interned string, the only way strings leave the table. Nothing that
+ * refers to one, including the constant pools of modules, can be used afterwards, so this
+ * is for when every module and VM has been destroyed, such as at exit
+ */
+void he_intern_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef HE_JIT_H
+#define HE_JIT_H
+
+#include "code.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Memory for generated code that's writable or executable, never both at once
+ *
+ * The buffer is mapped writable, filled in, then sealed, which makes it executable and
+ * read-only for the rest of its life.
+ */
+typedef struct he_jit_buffer {
+    /** @brief The start of the mapping */
+    uint8_t *memory;
+
+    /** @brief The bytes of code written so far */
+    size_t size;
+
+    /** @brief The bytes mapped, a multiple of the page size */
+    size_t capacity;
+
+    /** @brief Set once the buffer has been sealed */
+    bool executable;
+} he_jit_buffer;
+
+/**
+ * @brief Maps a writable buffer for code
+ * @param buffer The buffer to initialize
+ * @param capacity The bytes it needs to hold, rounded up to whole pages
+ * @return False if the memory couldn't be mapped, @p buffer is left empty
+ */
+bool he_jit_buffer_init(he_jit_buffer *buffer, size_t capacity);
+
+/**
+ * @brief Makes a buffer executable, after which it can't be written to
+ * @param buffer The buffer to seal
+ * @return False if the protection couldn't be changed
+ */
+bool he_jit_buffer_seal(he_jit_buffer *buffer);
+
+/**
+ * @brief Unmaps a buffer
+ * @param buffer The buffer to destroy
+ */
+void he_jit_buffer_destroy(he_jit_buffer *buffer);
+
+/**
+ * @brief Native code compiled from decoded code
+ *
+ * Every instruction becomes a fixed template of machine code. The data and return stacks
+ * stay in the VM's memory, so compiled code and the interpreters can take over from each
+ * other at any instruction, but nothing is dispatched and no operand is decoded at run
+ * time. Operations on integers are done inline, everything else calls into the same
+ * functions the interpreters use, errors included.
+ */
+typedef struct he_jit_code {
+    /** @brief The machine code */
+    he_jit_buffer buffer;
+
+    /** @brief Where each instruction of `code` starts in `buffer`, NULL if compiling failed */
+    const void **entries;
+
+    /** @brief The code this was compiled from, set even if compiling it failed */
+    const he_code *code;
+
+    /** @brief Why compiling failed, NULL if it didn't */
+    const char *error;
+} he_jit_code;
+
+/**
+ * @brief Initializes empty compiled code
+ * @param jit The code to initialize
+ */
+void he_jit_code_init(he_jit_code *jit);
+
+/**
+ * @brief Frees compiled code
+ * @param jit The code to destroy
+ */
+void he_jit_code_destroy(he_jit_code *jit);
+
+/**
+ * @brief Compiles decoded code to machine code, replacing whatever @p jit held
+ * @param jit Where to put the machine code
+ * @param code The decoded code, it must outlive @p jit
+ * @return False if the platform isn't supported or the code couldn't be compiled,
+ * `jit->error` says why
+ */
+bool he_jit_compile(he_jit_code *jit, const he_code *code);
+
+/** @brief Whether he_jit_compile can produce code on this platform and build */
+bool he_jit_supported(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
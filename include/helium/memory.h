@@ -3,6 +3,10 @@
 
 #include <stddef.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
  * @brief Allocates an array of @p sizeof_type bytes * @p length
  * @param sizeof_type The size of the type being allocated
@@ -20,10 +24,179 @@ void *he_alloc(size_t sizeof_type, size_t length);
  */
 void *he_grow_array(void *array_ptr, size_t type_size, size_t *current_length);
 
+/**
+ * @brief Resizes an array to exactly @p length elements, keeping what fits
+ * @param array_ptr Pointer to realloc
+ * @param type_size Size of the type of the array
+ * @param length The number of elements the array should hold, must not be 0
+ * @return Pointer to the new array
+ */
+void *he_resize_array(void *array_ptr, size_t type_size, size_t length);
+
 /**
  * @brief Frees a dynamic array
  * @param array The array to free
  */
 void he_free_array(void *array);
 
+/** @brief What the library has asked the system allocator for, across every thread */
+typedef struct he_memory_stats {
+    /** @brief The number of allocations and reallocations */
+    size_t allocations;
+
+    /** @brief The bytes they asked for */
+    size_t bytes;
+} he_memory_stats;
+
+/**
+ * @brief Gets the allocations the library has made since the program started
+ * @return The totals, subtract two of them to count what happened in between
+ */
+he_memory_stats he_memory_stats_get(void);
+
+/**
+ * @brief Counts an allocation made straight from the system allocator instead of
+ * through the functions above, so it shows up in he_memory_stats_get
+ * @param bytes The bytes asked for
+ */
+void he_memory_count(size_t bytes);
+
+/** @brief The size of the blocks an arena allocates from by default */
+#define HE_ARENA_BLOCK_SIZE ((size_t)64 * 1024)
+
+/** @brief A chunk of memory an arena hands out allocations from */
+typedef struct he_arena_block he_arena_block;
+
+/**
+ * @brief A bump allocator that releases everything it handed out at once
+ *
+ * Allocations are carved out of large blocks one after another and can't be freed on
+ * their own. Everything goes away together with he_arena_reset or he_arena_destroy,
+ * which is what modules and VMs built on an arena use to tear down in one step. An
+ * arena isn't thread-safe, give each thread (or tenant) its own.
+ */
+typedef struct he_arena {
+    /** @brief The block being allocated from, the others are chained behind it */
+    he_arena_block *head;
+
+    /** @brief The size of a normal block, bigger allocations get a block to themselves */
+    size_t block_size;
+
+    /** @brief The number of allocations made since the arena was initialized */
+    size_t allocations;
+
+    /** @brief The bytes handed out since the last reset */
+    size_t bytes_used;
+
+    /** @brief The most bytes that were handed out at once */
+    size_t peak_bytes_used;
+
+    /** @brief The bytes of every block the arena holds */
+    size_t bytes_reserved;
+
+    /** @brief The number of blocks the arena holds */
+    size_t blocks;
+} he_arena;
+
+/**
+ * @brief Initializes an empty arena, no memory is allocated until it's used
+ * @param arena The arena to initialize
+ * @param block_size The size of the blocks to allocate, 0 for HE_ARENA_BLOCK_SIZE
+ */
+void he_arena_init(he_arena *arena, size_t block_size);
+
+/**
+ * @brief Frees every block of an arena, everything allocated from it is gone
+ * @param arena The arena to destroy
+ */
+void he_arena_destroy(he_arena *arena);
+
+/**
+ * @brief Releases everything allocated from an arena, keeping one block to reuse
+ * @param arena The arena to reset
+ */
+void he_arena_reset(he_arena *arena);
+
+/**
+ * @brief Allocates memory from an arena, aligned for any type
+ * @param arena The arena to allocate from
+ * @param size The number of bytes
+ * @return The memory, alive until the arena is reset or destroyed
+ */
+void *he_arena_alloc(he_arena *arena, size_t size);
+
+/**
+ * @brief Resizes an allocation from an arena, in place if it's the latest one and
+ * there's room after it
+ * @param arena The arena @p ptr was allocated from
+ * @param ptr The allocation, can be NULL
+ * @param old_size The size @p ptr was allocated with
+ * @param new_size The size it should be
+ * @return The resized allocation, holding the first min(@p old_size, @p new_size) bytes
+ */
+void *he_arena_realloc(he_arena *arena, void *ptr, size_t old_size, size_t new_size);
+
+/**
+ * @brief Hands out fixed-size objects, reusing freed ones before allocating more
+ *
+ * Objects come from blocks of `objects_per_block` at a time, either from the heap or
+ * from an arena. Freeing an object puts it on a free list, and allocating takes the
+ * most recently freed one, so both are a couple of pointer moves.
+ */
+typedef struct he_pool {
+    /** @brief The size of every object, rounded up to keep them aligned */
+    size_t object_size;
+
+    /** @brief How many objects each block holds */
+    size_t objects_per_block;
+
+    /** @brief Where blocks come from, NULL for the heap */
+    he_arena *arena;
+
+    /** @brief Freed objects, each one's first bytes point to the next */
+    void *free_list;
+
+    /** @brief Every block the pool allocated from the heap, chained through their headers */
+    void *blocks;
+
+    /** @brief The number of objects handed out and not freed */
+    size_t in_use;
+
+    /** @brief The number of objects the blocks have room for */
+    size_t capacity;
+} he_pool;
+
+/**
+ * @brief Initializes an empty pool
+ * @param pool The pool to initialize
+ * @param object_size The size of the objects it hands out
+ * @param objects_per_block How many objects to allocate room for at a time
+ * @param arena The arena to allocate blocks from, NULL for the heap
+ */
+void he_pool_init(he_pool *pool, size_t object_size, size_t objects_per_block, he_arena *arena);
+
+/**
+ * @brief Frees every object in a pool. Blocks from an arena stay until it's reset
+ * @param pool The pool to destroy
+ */
+void he_pool_destroy(he_pool *pool);
+
+/**
+ * @brief Allocates an object from a pool
+ * @param pool The pool
+ * @return An object of the pool's size, aligned for any type
+ */
+void *he_pool_alloc(he_pool *pool);
+
+/**
+ * @brief Gives an object back to its pool
+ * @param pool The pool the object came from
+ * @param object The object, can be NULL
+ */
+void he_pool_free(he_pool *pool, void *object);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
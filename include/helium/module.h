@@ -1,6 +1,7 @@
 #ifndef HE_MODULE_H
 #define HE_MODULE_H
 
+#include "memory.h"
 #include "value.h"
 #include "vector.h"
 #include <assert.h>
@@ -12,12 +13,69 @@
 extern "C" {
 #endif
 
+/** @brief How much of each stack a function can use, worked out by he_module_verify */
+typedef struct he_function_bounds {
+    /** @brief Byte offset of the function's first instruction */
+    size_t offset;
+
+    /**
+     * @brief Whether the function can end up in a call cycle, which leaves its stack
+     * use unbounded. The counts below are 0 if it can
+     */
+    bool recursive;
+
+    /** @brief How many of its caller's values the function pops */
+    size_t stack_inputs;
+
+    /** @brief The most values the function and its callees push on top of its frame */
+    size_t max_stack_depth;
+
+    /** @brief The most return addresses the function's calls push, counting nested calls */
+    size_t max_return_depth;
+} he_function_bounds;
+
 typedef struct he_module {
     /** @brief Vector of opcodes */
     he_vector ops;
 
     /** @brief Pool of constant values */
     he_vector pool;
+
+    /** @brief The arena the module allocates from, NULL for the heap */
+    he_arena *arena;
+
+    /**
+     * @brief The file a module loaded by he_module_load_mapped was mapped from, NULL
+     * otherwise. Its bytecode points into this
+     */
+    void *mapping;
+
+    /** @brief The size of `mapping` in bytes */
+    size_t mapping_size;
+
+    /**
+     * @brief Tells the module apart from every other one, including a later module at the
+     * same address. he_module_init and he_module_destroy give it a new one
+     */
+    uint64_t id;
+
+    /** @brief Goes up whenever the bytecode or the constant pool changes */
+    uint64_t generation;
+
+    /**
+     * @brief Whether he_module_verify has accepted the module's bytecode. Writing to
+     * the bytecode clears it, along with the bounds below
+     */
+    bool verified;
+
+    /** @brief How much of each stack the code uses from the entry point on */
+    he_function_bounds bounds;
+
+    /** @brief The bounds of every function reachable from the entry point, by offset */
+    he_function_bounds *functions;
+
+    /** @brief The number of entries in `functions` */
+    size_t function_count;
 } he_module;
 
 /**
@@ -27,11 +85,38 @@ typedef struct he_module {
 void he_module_init(he_module *mod);
 
 /**
- * @brief Destroys a module's members
+ * @brief Initializes a module that allocates its bytecode, constants and verification
+ * results from an arena
+ *
+ * None of it is freed on its own. Resetting the arena releases all of it at once, and
+ * he_module_destroy doesn't have to be called first.
+ *
+ * @param mod The module to initialize
+ * @param arena The arena to allocate from, NULL for the heap
+ */
+void he_module_init_arena(he_module *mod, he_arena *arena);
+
+/**
+ * @brief Destroys a module's members, it stays initialized with the same arena
  * @param mod The module to destroy
  */
 void he_module_destroy(he_module *mod);
 
+/**
+ * @brief Empties a module's bytecode so it can be rewritten, keeping its constants
+ * @param mod The module to clear, it can be one loaded by he_module_load_mapped
+ */
+void he_module_clear_ops(he_module *mod);
+
+/**
+ * @brief Looks up the stack bounds of a function in a verified module
+ * @param mod The module
+ * @param offset The byte offset of the function's first instruction
+ * @return The function's bounds, NULL if the module isn't verified or no reachable
+ * function starts at @p offset
+ */
+const he_function_bounds *he_module_function_bounds(const he_module *mod, size_t offset);
+
 /**
  * @brief Adds a byte to the module
  * @param mod The module to add to
@@ -39,13 +124,71 @@ void he_module_destroy(he_module *mod);
  */
 void he_module_write_byte(he_module *mod, uint8_t byte);
 
+/** @brief The most bytes an operand written by he_module_write_int can take up */
+#define HE_MAX_OPERAND_SIZE 10
+
+/** @brief One instruction for he_module_write_ops */
+typedef struct he_module_op {
+    /** @brief The instruction's opcode */
+    uint8_t op;
+
+    /**
+     * @brief The operand, if the opcode has one. For jumps and calls this is the index
+     * of the instruction to go to, and an index one past the last means the end of the code
+     */
+    size_t operand;
+} he_module_op;
+
 /**
- * @brief Adds a native-width integer to the byte array
+ * @brief Adds an operand to the byte array
+ *
+ * Operands are ULEB128 encoded, 7 bits per byte starting from the least significant
+ * with the top bit set on every byte but the last. Small operands (the common case)
+ * take a single byte, and the encoding is the same on every host.
+ *
  * @param mod The module to add to
  * @param num The number to write
  */
 void he_module_write_int(he_module *mod, size_t num);
 
+/**
+ * @brief Gets the number of bytes he_module_write_int would use for a number
+ * @param num The number
+ * @return Between 1 and HE_MAX_OPERAND_SIZE
+ */
+size_t he_module_int_size(size_t num);
+
+/**
+ * @brief Reads an operand written by he_module_write_int
+ * @param bytes The bytecode
+ * @param size The number of bytes in @p bytes
+ * @param offset Where the operand starts, moved past it on success
+ * @param num Where to put the operand
+ * @return False if the operand runs past the end of the bytes or doesn't fit in a size_t
+ */
+bool he_module_read_int(const uint8_t *bytes, size_t size, size_t *offset, size_t *num);
+
+/**
+ * @brief Writes a list of instructions, working out the byte address of every jump
+ *
+ * Jump operands are variable length, so the layout is worked out before anything is
+ * written. This is what code that rewrites bytecode should use instead of patching
+ * addresses in place.
+ *
+ * @param mod The module to add to
+ * @param ops The instructions, every jump and call operand must be at most @p count
+ * @param count The number of instructions
+ */
+void he_module_write_ops(he_module *mod, const he_module_op *ops, size_t count);
+
+/**
+ * @brief Adds a constant to the const_pool without writing an instruction for it
+ * @param mod The module to add to
+ * @param val The constant value to add
+ * @return The constant's index in the pool
+ */
+size_t he_module_push_constant(he_module *mod, he_value val);
+
 /**
  * @brief Adds a constant to the const_pool, and writes an OP_LOAD_CONST
  * @param mod The module to add t o
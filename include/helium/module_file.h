@@ -0,0 +1,72 @@
+#ifndef HE_MODULE_FILE_H
+#define HE_MODULE_FILE_H
+
+#include "module.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Module files are laid out as a fixed size header followed by three sections. Every
+ * integer is little-endian, so files are portable between hosts.
+ *
+ *  - header: HE_FILE_MAGIC, then the version, flags, the offset and size of each
+ *    section, a CRC-32 of each section and a CRC-32 of the header itself
+ *  - code: the module's bytecode, exactly as it is in memory
+ *  - constant pool: one 16 byte entry per constant, a HE_FILE_CONST_* tag byte, 7 zero
+ *    bytes and an 8 byte payload. Strings are an offset into the string table
+ *  - string table: NUL terminated strings
+ *
+ * he_value's layout depends on the build and holds pointers, so the constant pool is
+ * the one thing that isn't used in place. The bytecode and the strings are.
+ */
+
+/** @brief The first 8 bytes of every module file */
+#define HE_FILE_MAGIC "\177HELIUM"
+
+/** @brief The version of the format written by he_module_save */
+#define HE_FILE_VERSION 1
+
+/** @brief The size of the header in bytes */
+#define HE_FILE_HEADER_SIZE 80
+
+/** @brief Constant pool tags */
+#define HE_FILE_CONST_BOOL 0
+#define HE_FILE_CONST_INT 1
+#define HE_FILE_CONST_FLOAT 2
+#define HE_FILE_CONST_STRING 3
+
+/** @brief The size of a constant pool entry in bytes */
+#define HE_FILE_CONST_SIZE 16
+
+/**
+ * @brief Writes a module to a file
+ * @param mod The module to write. Object constants have no representation in a file
+ * @param path Where to write it
+ * @return False if the file couldn't be written or the module has an object constant
+ */
+bool he_module_save(const he_module *mod, const char *path);
+
+/**
+ * @brief Loads a module by mapping its file into memory
+ *
+ * The bytecode is used straight out of the mapping, so every process that loads the
+ * same file shares the pages through the page cache. String constants are interned
+ * like any other string. The mapping lives until he_module_destroy. The bytecode can't be
+ * written to (see he_module_clear_ops), but constants can still be added.
+ *
+ * @param mod The module to load into, must not be initialized
+ * @param path The file to load
+ * @return False if the file can't be read, isn't a module file, is a newer version
+ * or fails its checksums. @p mod is left initialized but empty
+ */
+bool he_module_load_mapped(he_module *mod, const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef HE_NGRAM_H
+#define HE_NGRAM_H
+
+#include "instruction.h"
+#include "module.h"
+#include "vm.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief The longest opcode sequence a he_ngram_table can count */
+#define HE_NGRAM_MAX 4
+
+/** @brief A sequence of opcodes and the number of times it was executed */
+typedef struct he_ngram {
+    /** @brief The opcodes packed one per byte, the first opcode in the most significant byte */
+    uint32_t key;
+
+    /** @brief How many times the sequence ran, 0 marks an empty slot in the table */
+    size_t count;
+} he_ngram;
+
+/** @brief Counts of every opcode sequence of a fixed length seen during a run */
+typedef struct he_ngram_table {
+    /** @brief Open addressed hash table of the sequences */
+    he_ngram *entries;
+
+    /** @brief The number of slots in `entries`, always a power of two */
+    size_t capacity;
+
+    /** @brief The number of distinct sequences */
+    size_t size;
+
+    /** @brief The length of every sequence in the table */
+    size_t n;
+} he_ngram_table;
+
+/**
+ * @brief Initializes an empty table
+ * @param table The table to initialize
+ * @param n The sequence length to count, between 1 and HE_NGRAM_MAX
+ */
+void he_ngram_table_init(he_ngram_table *table, size_t n);
+
+/**
+ * @brief Destroys a table's members
+ * @param table The table to destroy
+ */
+void he_ngram_table_destroy(he_ngram_table *table);
+
+/**
+ * @brief Packs a sequence of opcodes into a key
+ * @param ops The opcodes
+ * @param n How many there are, at most HE_NGRAM_MAX
+ * @return The key
+ */
+uint32_t he_ngram_key(const he_opcode *ops, size_t n);
+
+/**
+ * @brief Gets one of the opcodes of a table's key
+ * @param table The table the key came from
+ * @param key The key
+ * @param i Which opcode to get, 0 is the first one executed
+ * @return The opcode
+ */
+he_opcode he_ngram_opcode(const he_ngram_table *table, uint32_t key, size_t i);
+
+/**
+ * @brief Adds one to the count of a sequence
+ * @param table The table to add to
+ * @param key The sequence's key
+ */
+void he_ngram_table_add(he_ngram_table *table, uint32_t key);
+
+/**
+ * @brief Gets how many times a sequence was seen
+ * @param table The table to look in
+ * @param key The sequence's key
+ * @return The count, 0 if it was never seen
+ */
+size_t he_ngram_table_count(const he_ngram_table *table, uint32_t key);
+
+/**
+ * @brief Gets the most frequent sequences in a table
+ * @param table The table to look in
+ * @param out Where to put the sequences, most frequent first
+ * @param max The number of slots in @p out
+ * @return The number of sequences put in @p out
+ */
+size_t he_ngram_table_top(const he_ngram_table *table, he_ngram *out, size_t max);
+
+/**
+ * @brief Runs a module one instruction at a time, counting every sequence of
+ * `table->n` opcodes that executes back to back
+ *
+ * This is far slower than he_vm_run, it's meant for picking which superinstructions
+ * are worth fusing for a workload. Runs start at the VM's pc and stop at the first
+ * OP_HALT, the end of the module or after @p max_steps instructions.
+ *
+ * @param vm The VM to run with
+ * @param mod The module to run
+ * @param table The table to add the counts to
+ * @param max_steps The most instructions to run, 0 for no limit
+ * @return Whether the module ran without errors
+ */
+he_interpret_flag he_vm_profile_ngrams(he_vm *vm, const he_module *mod, he_ngram_table *table,
+                                       size_t max_steps);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef HE_OPTIMIZE_H
+#define HE_OPTIMIZE_H
+
+#include "module.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief How much work he_module_optimize does, each level includes the ones before it */
+typedef enum he_opt_level {
+    /** @brief Leaves the module alone */
+    OPT_NONE = 0,
+
+    /**
+     * @brief Removes values that are pushed and immediately popped, and turns
+     * `OP_NOT; OP_JZ` into `OP_JNZ` when both branches pop the condition
+     */
+    OPT_PEEPHOLE,
+
+    /** @brief Evaluates arithmetic, comparisons and unary ops on constants ahead of time */
+    OPT_FOLD,
+
+    /** @brief Replaces common instruction pairs with superinstructions, see he_module_fuse */
+    OPT_FUSE,
+} he_opt_level;
+
+/**
+ * @brief Rewrites a module's bytecode into faster code that does the same thing
+ *
+ * Meant to be run once after a front end finishes emitting a module and before any
+ * VM uses it. Jump and call addresses are fixed up for the new code, and constants
+ * produced by folding are added to the pool. Anything that would raise an error at
+ * runtime (like dividing a constant by zero) is left for the VM to raise.
+ *
+ * @param mod The module to rewrite, no VM can be using it
+ * @param level How much to optimize
+ * @return False if the module's bytecode is malformed, in which case it's left unchanged
+ */
+bool he_module_optimize(he_module *mod, he_opt_level level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
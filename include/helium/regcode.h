@@ -0,0 +1,201 @@
+#ifndef HE_REGCODE_H
+#define HE_REGCODE_H
+
+#include "code.h"
+#include "value.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Opcodes of the register-based instruction format
+ *
+ * Registers are numbered relative to the current frame's base, register `i` is the
+ * stack slot that would be `i` values above the frame base in the stack-based code.
+ * Negative registers belong to the caller (or are inputs to the entry frame).
+ */
+typedef enum he_reg_opcode {
+    /** @brief r[a] = k */
+    REG_LOADK = 0,
+
+    /** @brief r[a] = r[b] */
+    REG_MOVE,
+
+    /** @brief r[a] = r[b] + r[c] */
+    REG_ADD,
+
+    /** @brief r[a] = r[b] - r[c] */
+    REG_SUB,
+
+    /** @brief r[a] = r[b] * r[c] */
+    REG_MUL,
+
+    /** @brief r[a] = r[b] / r[c] */
+    REG_DIV,
+
+    /** @brief r[a] = r[b] % r[c] */
+    REG_MOD,
+
+    /** @brief r[a] = r[b] > r[c] */
+    REG_GT,
+
+    /** @brief r[a] = r[b] < r[c] */
+    REG_LT,
+
+    /** @brief r[a] = r[b] >= r[c] */
+    REG_GTEQ,
+
+    /** @brief r[a] = r[b] <= r[c] */
+    REG_LTEQ,
+
+    /** @brief r[a] = r[b] == r[c] */
+    REG_EQ,
+
+    /** @brief r[a] = r[b] + k */
+    REG_ADDK,
+
+    /** @brief r[a] = r[b] - k */
+    REG_SUBK,
+
+    /** @brief r[a] = r[b] * k */
+    REG_MULK,
+
+    /** @brief r[a] = r[b] / k */
+    REG_DIVK,
+
+    /** @brief r[a] = r[b] % k */
+    REG_MODK,
+
+    /** @brief r[a] = r[b] > k */
+    REG_GTK,
+
+    /** @brief r[a] = r[b] < k */
+    REG_LTK,
+
+    /** @brief r[a] = r[b] >= k */
+    REG_GTEQK,
+
+    /** @brief r[a] = r[b] <= k */
+    REG_LTEQK,
+
+    /** @brief r[a] = r[b] == k */
+    REG_EQK,
+
+    /** @brief r[a] = !r[b] */
+    REG_NOT,
+
+    /** @brief r[a] = -r[b] */
+    REG_NEGATE,
+
+    /** @brief Jumps to `target` */
+    REG_JMP,
+
+    /** @brief Jumps to `target` if r[a] is true, same as OP_JZ */
+    REG_JZ,
+
+    /** @brief Jumps to `target` if r[a] is false, same as OP_JNZ */
+    REG_JNZ,
+
+    /**
+     * @brief Moves the frame base up by `a` registers and jumps to `target`. The callee
+     * touches registers `b` through `c` (exclusive) of the caller's frame
+     */
+    REG_CALL,
+
+    /** @brief Returns to the caller's frame */
+    REG_RET,
+
+    /** @brief Stops, leaving `a` values on the stack above the frame base */
+    REG_HALT,
+} he_reg_opcode;
+
+/** @brief A single register instruction */
+typedef struct he_reg_op {
+    /** @brief Address of the interpreter's handler for `op`, NULL until the code is threaded */
+    const void *handler;
+
+    /** @brief The instruction's opcode */
+    he_reg_opcode op;
+
+    /** @brief Destination/tested register, frame shift for REG_CALL, depth for REG_HALT */
+    int32_t a;
+
+    /** @brief First source register, lowest touched register for REG_CALL */
+    int32_t b;
+
+    /** @brief Second source register, one past the highest touched register for REG_CALL */
+    int32_t c;
+
+    /** @brief Instruction index for jumps and calls */
+    size_t target;
+
+    /** @brief The constant operand of REG_LOADK and the K forms */
+    he_value k;
+} he_reg_op;
+
+/** @brief Register code translated from one entry point of a module's decoded code */
+typedef struct he_reg_code {
+    /** @brief The translated instructions */
+    he_reg_op *ops;
+
+    /** @brief The number of instructions, 0 if translating `code` from `entry` failed */
+    size_t size;
+
+    /** @brief The module byte offset each instruction was translated from */
+    size_t *offsets;
+
+    /** @brief The code this was translated from */
+    const he_code *code;
+
+    /** @brief The byte offset the translation started from */
+    size_t entry;
+
+    /** @brief The index of the instruction `entry` was translated to, where runs start */
+    size_t entry_op;
+
+    /** @brief The lowest register the entry frame touches */
+    int32_t entry_low;
+
+    /** @brief One past the highest register the entry frame touches */
+    int32_t entry_high;
+
+    /** @brief Whether the `handler` fields have been filled in by the interpreter */
+    bool threaded;
+} he_reg_code;
+
+/**
+ * @brief Initializes an empty register code object
+ * @param reg The object to initialize
+ */
+void he_reg_code_init(he_reg_code *reg);
+
+/**
+ * @brief Destroys a register code object's members
+ * @param reg The object to destroy
+ */
+void he_reg_code_destroy(he_reg_code *reg);
+
+/**
+ * @brief Translates decoded stack code into register code, starting at a given instruction
+ *
+ * Translation needs the stack depth at every reachable instruction to be the same along
+ * every path, every called function to have a single stack effect, and the entry code to
+ * never return. Code that doesn't meet that can only run on the stack interpreter.
+ *
+ * @param reg Where to put the translation, whatever it held is replaced. On failure it's
+ * left empty but still records @p code and @p entry, so the attempt isn't repeated
+ * @param code The decoded code to translate
+ * @param entry Byte offset of the instruction execution starts at
+ * @return False if the code can't be translated
+ */
+bool he_reg_code_translate(he_reg_code *reg, const he_code *code, size_t entry);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef HE_TRACE_H
+#define HE_TRACE_H
+
+#include "value.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief One instruction a he_trace recorded, as it was about to run */
+typedef struct he_trace_entry {
+    /** @brief The value on the top of the stack, only meaningful if `depth` isn't 0 */
+    he_value top;
+
+    /** @brief The byte offset of the instruction in the module */
+    size_t pc;
+
+    /** @brief The number of values on the stack */
+    uint32_t depth;
+
+    /** @brief The opcode dispatched on, which can be a quickened form */
+    uint8_t opcode;
+} he_trace_entry;
+
+/**
+ * @brief A ring buffer of the last instructions a VM ran
+ *
+ * Recording only copies a few words into the next slot, everything is formatted
+ * afterwards by he_trace_print. Values on the top of the stack are copied as they are,
+ * so strings and objects they point to may have been collected by the time they're read.
+ */
+typedef struct he_trace {
+    /** @brief The recorded instructions, NULL when tracing is off */
+    he_trace_entry *entries;
+
+    /** @brief The number of entries minus one, the size is always a power of two */
+    size_t mask;
+
+    /** @brief How many instructions have been recorded, the newest is at `count - 1` */
+    uint64_t count;
+} he_trace;
+
+/**
+ * @brief Initializes a trace
+ * @param trace The trace to initialize
+ * @param size The number of instructions to keep, rounded up to a power of two. 0 turns
+ * tracing off
+ */
+void he_trace_init(he_trace *trace, size_t size);
+
+/**
+ * @brief Destroys a trace's members, it's left off
+ * @param trace The trace to destroy
+ */
+void he_trace_destroy(he_trace *trace);
+
+/**
+ * @brief Forgets everything a trace recorded, keeping its buffer
+ * @param trace The trace to clear
+ */
+void he_trace_clear(he_trace *trace);
+
+/** @brief Fills in an entry for an instruction about to run with the stack from @p base to @p sp */
+static inline void he_trace_fill(he_trace_entry *entry, size_t pc, uint8_t opcode,
+                                 const he_value *base, const he_value *sp) {
+    entry->pc = pc;
+    entry->opcode = opcode;
+    entry->depth = (uint32_t)(sp - base);
+
+    if (sp != base) { entry->top = sp[-1]; }
+}
+
+/** @brief Records an instruction about to run with the stack from @p base to @p sp */
+static inline void he_trace_record(he_trace *trace, size_t pc, uint8_t opcode,
+                                   const he_value *base, const he_value *sp) {
+    he_trace_fill(&trace->entries[trace->count++ & trace->mask], pc, opcode, base, sp);
+}
+
+/**
+ * @brief Copies out the last instructions a trace recorded, oldest first
+ * @param trace The trace
+ * @param entries Where to copy them
+ * @param count The most to copy
+ * @return The number copied, less than @p count if the trace holds fewer
+ */
+size_t he_trace_last(const he_trace *trace, he_trace_entry *entries, size_t count);
+
+/**
+ * @brief Writes the last instructions a trace recorded to a file, one per line, oldest first
+ * @param trace The trace
+ * @param count The most instructions to write
+ * @param file The file to write to
+ * @return Whether everything was written
+ */
+bool he_trace_print(const he_trace *trace, size_t count, FILE *file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,10 +1,12 @@
 #ifndef HE_VALUE_H
 #define HE_VALUE_H
 
+#include "intern.h"
 #include <assert.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -19,6 +21,177 @@ typedef enum he_value_type {
     TYPE_OBJECT
 } he_value_type;
 
+#ifdef HE_NAN_BOXING
+
+/**
+ * @brief A value of some type packed into the bits of a double
+ *
+ * Every double that isn't a NaN is stored as-is, and NaNs are canonicalized to a single
+ * quiet NaN. That leaves the quiet NaNs with the top 16 bits 0x7FFC-0x7FFF free to tag
+ * the other types, with the low 48 bits as the payload. Integers are 48 bits wide,
+ * anything that doesn't fit is promoted to a float.
+ */
+typedef struct he_value {
+    /** @brief The raw bits of the value */
+    uint64_t bits;
+} he_value;
+
+#define HE_NAN_BOX_TAG_MASK 0xFFFC000000000000ULL
+#define HE_NAN_BOX_PAYLOAD_MASK 0x0000FFFFFFFFFFFFULL
+#define HE_NAN_BOX_CANONICAL_NAN 0x7FF8000000000000ULL
+#define HE_NAN_BOX_BOOL 0x7FFC000000000000ULL
+#define HE_NAN_BOX_INT 0x7FFD000000000000ULL
+#define HE_NAN_BOX_STRING 0x7FFE000000000000ULL
+#define HE_NAN_BOX_OBJECT 0x7FFF000000000000ULL
+
+/** @brief The smallest integer that can be stored without being promoted to a float */
+#define HE_INT_MIN (-(INT64_C(1) << 47))
+
+/** @brief The largest integer that can be stored without being promoted to a float */
+#define HE_INT_MAX ((INT64_C(1) << 47) - 1)
+
+/** @brief Returns if the value is TYPE_FLOAT */
+static inline bool he_val_is_float(const he_value *val) {
+    return (val->bits & HE_NAN_BOX_TAG_MASK) != HE_NAN_BOX_BOOL;
+}
+
+/** @brief Returns the type of the value */
+static inline he_value_type he_val_type(const he_value *val) {
+    static const he_value_type tags[] = {TYPE_BOOL, TYPE_INT, TYPE_STRING, TYPE_OBJECT};
+
+    if (he_val_is_float(val)) { return TYPE_FLOAT; }
+
+    return tags[(val->bits >> 48) & 0x3];
+}
+
+/** @brief Returns if the value is TYPE_BOOL */
+static inline bool he_val_is_bool(const he_value *val) {
+    return (val->bits & ~HE_NAN_BOX_PAYLOAD_MASK) == HE_NAN_BOX_BOOL;
+}
+
+/** @brief Returns if the value is TYPE_INT */
+static inline bool he_val_is_int(const he_value *val) {
+    return (val->bits & ~HE_NAN_BOX_PAYLOAD_MASK) == HE_NAN_BOX_INT;
+}
+
+/** @brief Returns if the value is TYPE_STRING */
+static inline bool he_val_is_string(const he_value *val) {
+    return (val->bits & ~HE_NAN_BOX_PAYLOAD_MASK) == HE_NAN_BOX_STRING;
+}
+
+/** @brief Returns if the value is TYPE_OBJECT */
+static inline bool he_val_is_object(const he_value *val) {
+    return (val->bits & ~HE_NAN_BOX_PAYLOAD_MASK) == HE_NAN_BOX_OBJECT;
+}
+
+/** @brief Reads a value as a boolean */
+static inline bool he_val_as_bool(const he_value *val) {
+    assert(he_val_is_bool(val) && "not attempting to read non-bool as bool");
+
+    return (val->bits & 1) != 0;
+}
+
+/** @brief Reads a value as an integer */
+static inline int64_t he_val_as_int(const he_value *val) {
+    assert(he_val_is_int(val) && "not attempting to read non-int as int");
+
+    // shift the payload's sign bit into the real sign bit and back down to sign-extend it
+    return (int64_t)(val->bits << 16) >> 16;
+}
+
+/** @brief Reads a value as a float */
+static inline double he_val_as_float(const he_value *val) {
+    assert(he_val_is_float(val) && "not attempting to read non-float as float");
+
+    double fl;
+    memcpy(&fl, &val->bits, sizeof(double));
+
+    return fl;
+}
+
+/** @brief Reads a value as a string */
+static inline const char *he_val_as_string(const he_value *val) {
+    assert(he_val_is_string(val) && "not attempting to read non-string as string");
+
+    return (const char *)(uintptr_t)(val->bits & HE_NAN_BOX_PAYLOAD_MASK);
+}
+
+/** @brief Reads a value as an object */
+static inline void *he_val_as_object(const he_value *val) {
+    assert(he_val_is_object(val) && "not attempting to read non-object as object");
+
+    return (void *)(uintptr_t)(val->bits & HE_NAN_BOX_PAYLOAD_MASK);
+}
+
+/** @brief Creates a he_value from a bool */
+static inline he_value he_val_from_bool(bool boolean) {
+    he_value val;
+    val.bits = HE_NAN_BOX_BOOL | (boolean ? 1 : 0);
+
+    return val;
+}
+
+/** @brief Creates a he_value from a float */
+static inline he_value he_val_from_float(double fl) {
+    he_value val;
+
+    if (fl != fl) {
+        // every NaN becomes the same one so that they can't be mistaken for a tag
+        val.bits = HE_NAN_BOX_CANONICAL_NAN;
+    } else {
+        memcpy(&val.bits, &fl, sizeof(double));
+    }
+
+    return val;
+}
+
+/** @brief Creates a he_value from an integer, promoting it to a float if it needs over 48 bits */
+static inline he_value he_val_from_int(int64_t integer) {
+    if (integer < HE_INT_MIN || integer > HE_INT_MAX) { return he_val_from_float((double)integer); }
+
+    he_value val;
+    val.bits = HE_NAN_BOX_INT | ((uint64_t)integer & HE_NAN_BOX_PAYLOAD_MASK);
+
+    return val;
+}
+
+/** @brief Creates a he_value from a string, interning it */
+static inline he_value he_val_from_string(const char *string) {
+    string = he_intern(string, strlen(string));
+
+    assert(((uintptr_t)string & ~HE_NAN_BOX_PAYLOAD_MASK) == 0 && "pointer is wider than 48 bits");
+
+    he_value val;
+    val.bits = HE_NAN_BOX_STRING | (uint64_t)(uintptr_t)string;
+
+    return val;
+}
+
+/**
+ * @brief Creates a he_value from characters that are already interned or on a heap,
+ * without interning them again
+ */
+static inline he_value he_val_wrap_string(const char *chars) {
+    assert(((uintptr_t)chars & ~HE_NAN_BOX_PAYLOAD_MASK) == 0 && "pointer is wider than 48 bits");
+
+    he_value val;
+    val.bits = HE_NAN_BOX_STRING | (uint64_t)(uintptr_t)chars;
+
+    return val;
+}
+
+/** @brief Creates a he_value from a pointer */
+static inline he_value he_val_from_object(void *object) {
+    assert(((uintptr_t)object & ~HE_NAN_BOX_PAYLOAD_MASK) == 0 && "pointer is wider than 48 bits");
+
+    he_value val;
+    val.bits = HE_NAN_BOX_OBJECT | (uint64_t)(uintptr_t)object;
+
+    return val;
+}
+
+#else
+
 /** @brief Simply a tagged union for a value of some type */
 typedef struct he_value {
     /** @brief The type of object the union holds */
@@ -34,50 +207,149 @@ typedef struct he_value {
     } as;
 } he_value;
 
+/** @brief The smallest integer that can be stored without being promoted to a float */
+#define HE_INT_MIN INT64_MIN
+
+/** @brief The largest integer that can be stored without being promoted to a float */
+#define HE_INT_MAX INT64_MAX
+
+/** @brief Returns the type of the value */
+static inline he_value_type he_val_type(const he_value *val) {
+    return val->type;
+}
+
 /** @brief Returns if the value is TYPE_BOOL */
-bool he_val_is_bool(const he_value *val);
+static inline bool he_val_is_bool(const he_value *val) {
+    return val->type == TYPE_BOOL;
+}
 
 /** @brief Returns if the value is TYPE_INT */
-bool he_val_is_int(const he_value *val);
+static inline bool he_val_is_int(const he_value *val) {
+    return val->type == TYPE_INT;
+}
 
 /** @brief Returns if the value is TYPE_FLOAT */
-bool he_val_is_float(const he_value *val);
+static inline bool he_val_is_float(const he_value *val) {
+    return val->type == TYPE_FLOAT;
+}
 
 /** @brief Returns if the value is TYPE_STRING */
-bool he_val_is_string(const he_value *val);
+static inline bool he_val_is_string(const he_value *val) {
+    return val->type == TYPE_STRING;
+}
 
 /** @brief Returns if the value is TYPE_OBJECT */
-bool he_val_is_object(const he_value *val);
+static inline bool he_val_is_object(const he_value *val) {
+    return val->type == TYPE_OBJECT;
+}
 
 /** @brief Reads a value as a boolean */
-bool he_val_as_bool(const he_value *val);
+static inline bool he_val_as_bool(const he_value *val) {
+    assert(he_val_is_bool(val) && "not attempting to read non-bool as bool");
+
+    return val->as.boolean;
+}
 
 /** @brief Reads a value as an integer */
-int64_t he_val_as_int(const he_value *val);
+static inline int64_t he_val_as_int(const he_value *val) {
+    assert(he_val_is_int(val) && "not attempting to read non-int as int");
+
+    return val->as.integer;
+}
 
 /** @brief Reads a value as a float */
-double he_val_as_float(const he_value *val);
+static inline double he_val_as_float(const he_value *val) {
+    assert(he_val_is_float(val) && "not attempting to read non-float as float");
+
+    return val->as.floating;
+}
 
 /** @brief Reads a value as a string */
-const char *he_val_as_string(const he_value *val);
+static inline const char *he_val_as_string(const he_value *val) {
+    assert(he_val_is_string(val) && "not attempting to read non-string as string");
+
+    return val->as.string;
+}
 
 /** @brief Reads a value as an object */
-void *he_val_as_object(const he_value *val);
+static inline void *he_val_as_object(const he_value *val) {
+    assert(he_val_is_object(val) && "not attempting to read non-object as object");
+
+    return val->as.object;
+}
 
 /** @brief Creates a he_value from a bool */
-he_value he_val_from_bool(bool boolean);
+static inline he_value he_val_from_bool(bool boolean) {
+    he_value val;
+    val.type = TYPE_BOOL;
+    val.as.integer = 0;
+    val.as.boolean = boolean;
+
+    return val;
+}
 
 /** @brief Creates a he_value from an integer */
-he_value he_val_from_int(int64_t integer);
+static inline he_value he_val_from_int(int64_t integer) {
+    he_value val;
+    val.type = TYPE_INT;
+    val.as.integer = integer;
+
+    return val;
+}
 
 /** @brief Creates a he_value from a float */
-he_value he_val_from_float(double fl);
+static inline he_value he_val_from_float(double fl) {
+    he_value val;
+    val.type = TYPE_FLOAT;
+    val.as.floating = fl;
+
+    return val;
+}
+
+/** @brief Creates a he_value from a string, interning it */
+static inline he_value he_val_from_string(const char *string) {
+    he_value val;
+    val.type = TYPE_STRING;
+    val.as.integer = 0;
+    val.as.string = he_intern(string, strlen(string));
+
+    return val;
+}
 
-/** @brief Creates a he_value from a string */
-he_value he_val_from_string(const char *string);
+/**
+ * @brief Creates a he_value from characters that are already interned or on a heap,
+ * without interning them again
+ */
+static inline he_value he_val_wrap_string(const char *chars) {
+    he_value val;
+    val.type = TYPE_STRING;
+    val.as.integer = 0;
+    val.as.string = chars;
+
+    return val;
+}
 
 /** @brief Creates a he_value from a pointer */
-he_value he_val_from_object(void *object);
+static inline he_value he_val_from_object(void *object) {
+    he_value val;
+    val.type = TYPE_OBJECT;
+    val.as.integer = 0;
+    val.as.object = object;
+
+    return val;
+}
+
+#endif
+
+/** @brief Gets the length of a string value without walking its characters */
+static inline size_t he_val_string_length(const he_value *val) {
+    return he_string_of(he_val_as_string(val))->length;
+}
+
+/** @brief Gets the hash of a string value, computed when it was interned */
+static inline uint64_t he_val_string_hash(const he_value *val) {
+    return he_string_of(he_val_as_string(val))->hash;
+}
 
 #ifdef __cplusplus
 }
@@ -24,6 +24,9 @@ typedef struct he_vector {
 
     /** @brief Pointer to the last element of the array */
     void *top;
+
+    /** @brief The arena the array is allocated from, NULL for the heap */
+    struct he_arena *arena;
 } he_vector;
 
 /**
@@ -33,6 +36,18 @@ typedef struct he_vector {
  */
 void he_vector_init(he_vector *vec, size_t type_size);
 
+/**
+ * @brief Initializes a vector that allocates its array from an arena
+ *
+ * The array is never freed on its own, destroying the vector only forgets it and the
+ * memory comes back when the arena is reset.
+ *
+ * @param vec Pointer to the vec
+ * @param type_size sizeof(T) where he_vector is he_vector<T>
+ * @param arena The arena to allocate from, NULL for the heap
+ */
+void he_vector_init_arena(he_vector *vec, size_t type_size, struct he_arena *arena);
+
 /**
  * @brief Initializes a vector with an initially allocated array
  * @param vec Pointer to the vec
@@ -78,7 +93,7 @@ void *he_vector_last(const he_vector *vec);
 void *he_vector_at(const he_vector *vec, size_t idx);
 
 /**
- * @brief Frees the vector's array and sets it to a pre-defined state
+ * @brief Frees the vector's array and sets it to a pre-defined state, keeping its arena
  * @param vec The vec to destroy
  */
 void he_vector_destroy(he_vector *vec);
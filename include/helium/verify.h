@@ -0,0 +1,44 @@
+#ifndef HE_VERIFY_H
+#define HE_VERIFY_H
+
+#include "module.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Where and why he_module_verify rejected a module */
+typedef struct he_verify_error {
+    /** @brief What's wrong with the bytecode */
+    const char *message;
+
+    /** @brief Byte offset of the instruction the problem was found at */
+    size_t offset;
+} he_verify_error;
+
+/**
+ * @brief Checks that a module's bytecode is safe to run without per-instruction checks
+ *
+ * Every opcode has to be known with all of its operand bytes, every constant index has
+ * to be in the pool, every jump and call has to land on the start of an instruction,
+ * and every instruction reachable from the start has to be reached with one stack
+ * depth. From that the verifier works out how much of each stack the code and every
+ * function it calls can use. he_vm_use sizes a VM's stacks to fit, and he_vm_run uses
+ * the bounds to pick a loop that doesn't check pushes against the end of the stacks.
+ * Functions that can recurse get no bound, VMs grow their stacks as they run those.
+ *
+ * The results are stored in @p mod and stay valid until its bytecode is written to.
+ *
+ * @param mod The module to verify
+ * @param error Where to describe why the module was rejected, can be NULL
+ * @return Whether the module was accepted
+ */
+bool he_module_verify(he_module *mod, he_verify_error *error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,8 +1,15 @@
 #ifndef HE_VM_H
 #define HE_VM_H
 
+#include "code.h"
+#include "heap.h"
+#include "instruction.h"
+#include "jit.h"
 #include "module.h"
+#include "regcode.h"
+#include "trace.h"
 #include "value.h"
+#include <setjmp.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -20,24 +27,173 @@ typedef struct he_interpret_result {
     he_interpret_flag flag;
 } he_interpret_result;
 
-/** @brief Represents the data stack of the VM */
+/** @brief The number of values a VM's data stack can grow to by default */
+#define HE_DEFAULT_STACK_SIZE 4096
+
+/** @brief The number of return addresses a VM's return stack can grow to by default */
+#define HE_DEFAULT_RETURN_STACK_SIZE 1024
+
+/** @brief The number of values a VM's data stack starts out with room for */
+#define HE_INITIAL_STACK_SIZE 64
+
+/** @brief The number of return addresses a VM's return stack starts out with room for */
+#define HE_INITIAL_RETURN_STACK_SIZE 16
+
+/**
+ * @brief Represents the data stack of the VM. he_vm_use sizes it for verified modules,
+ * otherwise it grows as values are pushed
+ */
 typedef struct he_stack {
-    /** @brief Vector representing the stack */
-    he_vector vec;
+    /** @brief The bottom of the stack */
+    he_value *base;
+
+    /** @brief One past the value on the top of the stack */
+    he_value *sp;
 
-    /** @brief Pointer to the top of the stack */
-    he_value *top;
+    /** @brief One past the last allocated slot, pushing here grows the stack */
+    he_value *limit;
+
+    /** @brief The most values the stack can grow to, pushing past that is a stack overflow */
+    size_t max_size;
 } he_stack;
 
-/** @brief Represents the return address stack of the VM */
+/**
+ * @brief Represents the return address stack of the VM. he_vm_use sizes it for verified
+ * modules, otherwise it grows as addresses are pushed
+ */
 typedef struct he_return_stack {
-    /** @brief Vector representing the stack */
-    he_vector vec;
+    /** @brief The bottom of the stack */
+    size_t *base;
 
-    /** @brief Pointer to the top of the stack */
-    size_t *top;
+    /** @brief One past the address on the top of the stack */
+    size_t *sp;
+
+    /** @brief One past the last allocated slot, pushing here grows the stack */
+    size_t *limit;
+
+    /** @brief The most addresses the stack can grow to, pushing past that is a stack overflow */
+    size_t max_size;
 } he_return_stack;
 
+/** @brief Selects which interpreter he_vm_run executes code with */
+typedef enum he_vm_engine {
+    /** @brief The stack interpreter, which runs anything the decoder accepts */
+    ENGINE_STACK,
+
+    /**
+     * @brief The register interpreter, code it can't translate (or runs that start with
+     * return addresses on the stack) falls back to the stack interpreter
+     */
+    ENGINE_REGISTER,
+
+    /**
+     * @brief Machine code compiled from the decoded code the first time the module runs.
+     * Where the JIT isn't supported or the code can't be compiled, the stack interpreter
+     * runs it instead
+     */
+    ENGINE_JIT,
+} he_vm_engine;
+
+/** @brief What made an instruction hot */
+typedef enum he_hot_kind {
+    /** @brief Backward jumps to it, it's the head of a loop */
+    HOT_LOOP,
+
+    /** @brief Calls to it, it's the entry of a function */
+    HOT_CALL,
+} he_hot_kind;
+
+struct he_vm;
+
+/**
+ * @brief Called when an instruction gets hot, once per instruction per decoding of the module
+ *
+ * The VM is in the middle of a run, so its stacks and pc aren't up to date and it must not
+ * be run or reset from here. Setting its `engine` takes effect from the next he_vm_run.
+ *
+ * @param vm The VM running the module
+ * @param kind Whether a loop or a call made it hot
+ * @param offset The byte offset of the instruction in the module
+ * @param data The pointer given in the he_hot_config
+ */
+typedef void (*he_hot_fn)(struct he_vm *vm, he_hot_kind kind, size_t offset, void *data);
+
+/**
+ * @brief How the stack interpreter finds hot spots. Every backward jump and every call
+ * adds one to the `hits` of the instruction it goes to, and an instruction whose hits
+ * reach a threshold is reported to `on_hot`
+ */
+typedef struct he_hot_config {
+    /** @brief The backward jumps to an instruction that make it hot, 0 to not count them */
+    uint32_t loop_threshold;
+
+    /** @brief The calls to an instruction that make it hot, 0 to not count them */
+    uint32_t call_threshold;
+
+    /** @brief What to call when an instruction gets hot, can be NULL to only count */
+    he_hot_fn on_hot;
+
+    /** @brief Passed to `on_hot` */
+    void *data;
+} he_hot_config;
+
+/** @brief An instruction that was reached through backward jumps or calls */
+typedef struct he_hot_spot {
+    /** @brief The byte offset of the instruction in the module */
+    size_t offset;
+
+    /** @brief How many times it was reached */
+    uint32_t hits;
+} he_hot_spot;
+
+/** @brief Options for initializing a VM */
+typedef struct he_vm_config {
+    /** @brief The most values the data stack can hold */
+    size_t stack_size;
+
+    /** @brief The most return addresses the return stack can hold */
+    size_t return_stack_size;
+
+    /** @brief The interpreter he_vm_run uses */
+    he_vm_engine engine;
+
+    /**
+     * @brief The arena to allocate the stacks from, NULL for the heap. Decoded code is
+     * replaced whenever the module changes, so it stays on the heap either way
+     */
+    he_arena *arena;
+
+    /** @brief The bytes the VM's heap allocates between minor collections */
+    size_t nursery_size;
+
+    /** @brief Hot spot detection, off by default */
+    he_hot_config hot;
+
+    /**
+     * @brief The number of instructions to keep in the VM's trace, 0 (the default) to not
+     * trace. A traced VM always runs on the stack interpreter, with the stack checks on
+     */
+    size_t trace_size;
+} he_vm_config;
+
+/**
+ * @brief What the interpreters spent their time on, only filled in when the library is
+ * built with HELIUM_PROFILE. Without it nothing is recorded and running costs nothing extra
+ */
+typedef struct he_vm_stats {
+    /**
+     * @brief How many times each opcode ran, indexed by the opcode dispatched on, so
+     * quickened forms are counted apart from their generic ones
+     */
+    uint64_t counts[HE_DISPATCH_OPCODE_COUNT];
+
+    /**
+     * @brief The time spent in each opcode, in he_vm_stats_unit. The stack interpreter
+     * charges entering and leaving its loop to OP_HALT
+     */
+    uint64_t time[HE_DISPATCH_OPCODE_COUNT];
+} he_vm_stats;
+
 /** @brief Represents the VM */
 typedef struct he_vm {
     /** @brief The data stack */
@@ -49,16 +205,82 @@ typedef struct he_vm {
     /** @brief Index of the current instruction */
     size_t pc;
 
+    /**
+     * @brief Whether `pc` and the return addresses are instruction indices into `code`
+     * rather than byte offsets, which they only are while he_vm_run is running it
+     */
+    bool indexed;
+
     /** @brief Pointer to the module being interpreted */
     const he_module *mod;
+
+    /** @brief The decoded form of `mod` that he_vm_run executes */
+    he_code code;
+
+    /** @brief The interpreter he_vm_run uses */
+    he_vm_engine engine;
+
+    /** @brief The arena the stacks are allocated from, NULL for the heap */
+    he_arena *arena;
+
+    /** @brief Where strings and objects the VM manages live */
+    he_heap heap;
+
+    /** @brief Register form of `code`, translated on demand when `engine` is ENGINE_REGISTER */
+    he_reg_code reg_code;
+
+    /** @brief Machine code for `code`, compiled on demand when `engine` is ENGINE_JIT */
+    he_jit_code jit;
+
+    /** @brief Per-opcode counts and times, see he_vm_stats */
+    he_vm_stats stats;
+
+    /** @brief Hot spot detection, counts are kept in `code` */
+    he_hot_config hot;
+
+    /** @brief The last instructions run, recorded if `trace.entries` isn't NULL */
+    he_trace trace;
+
+    /** @brief Where errors raised while this VM is running jump back to */
+    jmp_buf error_env;
+
+    /** @brief Description of the last error the VM hit, NULL if there hasn't been one */
+    const char *error;
 } he_vm;
 
 /**
- * @brief Initializes a VM instance
+ * @brief Evaluates an arithmetic, comparison or unary instruction on values the same
+ * way the interpreter does, without needing a VM
+ * @param op The instruction, one of OP_ADD through OP_NEGATE
+ * @param top The value on the top of the stack, replaced with the result
+ * @param second The value that would be popped first, ignored for OP_NOT and OP_NEGATE
+ * @return False if the interpreter would raise an error, @p top is left unchanged
+ */
+bool he_vm_evaluate(he_opcode op, he_value *top, he_value second);
+
+/**
+ * @brief Gets the configuration he_vm_init uses
+ * @return The default configuration
+ */
+he_vm_config he_vm_default_config(void);
+
+/**
+ * @brief Initializes a VM instance with the default configuration
  * @param vm The VM to initialize
  */
 void he_vm_init(he_vm *vm);
 
+/**
+ * @brief Initializes a VM instance
+ *
+ * The stacks start small, he_vm_use resizes them to exactly what a verified module
+ * needs and they grow on demand for anything else, up to the configured sizes.
+ *
+ * @param vm The VM to initialize
+ * @param config The sizes to use, both stack sizes must be non-zero
+ */
+void he_vm_init_config(he_vm *vm, const he_vm_config *config);
+
 /**
  * @brief Destroys a VM's members
  * @param vm The VM to de-initialize
@@ -66,12 +288,104 @@ void he_vm_init(he_vm *vm);
 void he_vm_destroy(he_vm *vm);
 
 /**
- * @brief Sets up a VM instance to use a certain mod
+ * @brief Empties a VM's stacks and clears its pc and error, keeping its allocations
+ * and decoded code so it can be reused for another run
+ * @param vm The VM to reset
+ */
+void he_vm_reset(he_vm *vm);
+
+/**
+ * @brief Sets up a VM instance to use a certain mod, decoding its bytecode
+ *
+ * If the module has been verified and doesn't recurse, the stacks are resized once to
+ * hold exactly what it can use on top of what they already hold, so running it never
+ * has to grow them. The module must not be modified while the VM is using it.
+ *
  * @param vm The VM to give the module to
  * @param mod The module to give to a VM
  */
 void he_vm_use(he_vm *vm, const he_module *mod);
 
+/**
+ * @brief Pushes values onto a VM's data stack, growing it if they don't fit
+ * @param vm The VM to push onto
+ * @param values The values to push, the last one ends up on top
+ * @param count The number of values
+ * @return False if the stack can't grow enough, in which case nothing is pushed
+ */
+bool he_vm_push_values(he_vm *vm, const he_value *values, size_t count);
+
+/**
+ * @brief Pushes return addresses onto a VM's return stack, growing it if they don't fit
+ * @param vm The VM to push onto
+ * @param offsets The byte offsets to return to, the last one is returned to first
+ * @param count The number of addresses
+ * @return False if the stack can't grow enough, in which case nothing is pushed
+ */
+bool he_vm_push_returns(he_vm *vm, const size_t *offsets, size_t count);
+
+/**
+ * @brief Collects a VM's heap. The roots are the data stack, the constant pool of the
+ * module it's using and the heap's handles
+ * @param vm The VM to collect
+ * @param kind Whether to collect only new objects or everything
+ */
+void he_vm_collect(he_vm *vm, he_gc_kind kind);
+
+/**
+ * @brief Allocates a string on a VM's heap, first running a collection if one is due.
+ * Anything on the heap that isn't reachable from a root may be freed by the collection
+ * @param vm The VM
+ * @param chars The characters, they don't need to be NUL terminated
+ * @param length The number of characters
+ * @return The string
+ */
+he_value he_vm_new_string(he_vm *vm, const char *chars, size_t length);
+
+/**
+ * @brief Allocates an array on a VM's heap, first running a collection if one is due
+ * @param vm The VM
+ * @param length The number of items, set them with he_heap_array_set
+ * @return The array, as a TYPE_OBJECT value pointing at a he_array
+ */
+he_value he_vm_new_array(he_vm *vm, size_t length);
+
+/**
+ * @brief Allocates zeroed bytes on a VM's heap, first running a collection if one is due
+ * @param vm The VM
+ * @param size The number of bytes
+ * @return The bytes, as a TYPE_OBJECT value
+ */
+he_value he_vm_new_data(he_vm *vm, size_t size);
+
+/**
+ * @brief Lists the instructions backward jumps and calls went to, in module order.
+ * Counts start over whenever the VM decodes a module
+ * @param vm The VM
+ * @param spots Where to write them, can be NULL if @p capacity is 0
+ * @param capacity The most to write
+ * @return The number of instructions with any hits, which can be more than @p capacity
+ */
+size_t he_vm_hot_spots(const he_vm *vm, he_hot_spot *spots, size_t capacity);
+
+/**
+ * @brief Checks whether the library was built to fill in he_vm_stats
+ * @return True if it was built with HELIUM_PROFILE
+ */
+bool he_vm_stats_enabled(void);
+
+/**
+ * @brief Gets the unit of he_vm_stats::time
+ * @return "cycles" where a cycle counter is read, "ns" otherwise
+ */
+const char *he_vm_stats_unit(void);
+
+/**
+ * @brief Zeroes a VM's stats
+ * @param vm The VM
+ */
+void he_vm_stats_reset(he_vm *vm);
+
 /**
  * @brief Executes a single instruction on the VM using the vm's module
  * @param vm The vm to execute with
@@ -80,7 +394,14 @@ void he_vm_use(he_vm *vm, const he_module *mod);
 he_interpret_flag he_vm_execute_instruction(he_vm *vm, bool has_setjmp_env);
 
 /**
- * @brief Runs a module with a VM instance
+ * @brief Runs a module with a VM instance, starting from the VM's pc
+ *
+ * If @p mod isn't the module the VM last decoded, or has changed since, it is decoded first.
+ * All of a VM's state lives in the he_vm, so different VMs can run on different threads
+ * at the same time, including over the same module. On failure `vm->error` describes
+ * what went wrong, and the stack interpreter and machine code leave the pc and stacks as
+ * they were when the failing instruction started.
+ *
  * @param vm The VM instance to use
  * @param mod The module to run
  */
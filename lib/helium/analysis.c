@@ -0,0 +1,257 @@
+#include "helium/analysis.h"
+#include "helium/memory.h"
+
+/** @brief Deeper than this and the depths could overflow an int32_t */
+#define DEPTH_LIMIT (INT32_MAX / 4)
+
+void he_stack_effect(he_opcode op, int32_t *reads, int32_t *delta) {
+    switch (op) {
+        case OP_LOAD_CONST:
+            *reads = 0;
+            *delta = 1;
+            break;
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        case OP_MOD:
+        case OP_GT:
+        case OP_LT:
+        case OP_GTEQ:
+        case OP_LTEQ:
+        case OP_EQ:
+        case OP_LT_JZ:
+        case OP_LT_JNZ:
+        case OP_GT_JZ:
+        case OP_GT_JNZ:
+        case OP_EQ_NOT:
+            *reads = 2;
+            *delta = -1;
+            break;
+        case OP_NOT:
+        case OP_NEGATE:
+        case OP_JZ:
+        case OP_JNZ:
+        case OP_LOAD_CONST_ADD:
+        case OP_LOAD_CONST_SUB:
+            *reads = 1;
+            *delta = 0;
+            break;
+        case OP_POP:
+            *reads = 1;
+            *delta = -1;
+            break;
+        case OP_DUP:
+            *reads = 1;
+            *delta = 1;
+            break;
+        default:
+            // OP_RET, OP_CALL, OP_JMP and OP_HALT don't touch the values on the stack
+            *reads = 0;
+            *delta = 0;
+            break;
+    }
+}
+
+typedef struct analyzer {
+    he_stack_analysis *a;
+    size_t *worklist;
+    size_t work_size;
+} analyzer;
+
+static bool fail(analyzer *an, size_t index, const char *message) {
+    an->a->error = message;
+    an->a->error_index = index;
+
+    return false;
+}
+
+static bool visit(analyzer *an, size_t from, size_t index, int32_t depth, size_t owner) {
+    he_stack_analysis *a = an->a;
+
+    if (depth > DEPTH_LIMIT || depth < -DEPTH_LIMIT) {
+        return fail(an, from, "stack depth is too large");
+    }
+
+    if (a->depth[index] == HE_DEPTH_UNKNOWN) {
+        a->depth[index] = depth;
+        a->owner[index] = owner;
+        an->worklist[an->work_size++] = index;
+
+        return true;
+    }
+
+    if (a->owner[index] != owner) {
+        return fail(an, from, "instruction is reachable from two different functions");
+    }
+
+    if (a->depth[index] != depth) {
+        return fail(an, from, "stack depth differs between paths to an instruction");
+    }
+
+    return true;
+}
+
+static bool enter_function(analyzer *an, size_t from, size_t entry) {
+    he_stack_analysis *a = an->a;
+
+    if (a->depth[entry] != HE_DEPTH_UNKNOWN) {
+        if (a->depth[entry] == 0 && a->owner[entry] == entry) { return true; }
+
+        return fail(an, from, "call target is in the middle of another function");
+    }
+
+    a->low[entry] = 0;
+    a->high[entry] = 0;
+
+    return visit(an, from, entry, 0, entry);
+}
+
+static bool step(analyzer *an, size_t entry, size_t i, bool *progress) {
+    he_stack_analysis *a = an->a;
+    const he_op *op = &a->code->ops[i];
+    int32_t depth = a->depth[i];
+    size_t owner = a->owner[i];
+    int32_t reads, delta;
+
+    he_stack_effect(op->op, &reads, &delta);
+
+    if (depth - reads < a->low[owner]) { a->low[owner] = depth - reads; }
+    if (depth + delta > a->high[owner]) { a->high[owner] = depth + delta; }
+    if (depth > a->high[owner]) { a->high[owner] = depth; }
+
+    switch (op->op) {
+        case OP_RET:
+            if (owner == entry) { return fail(an, i, "return from the entry point"); }
+
+            if (a->effect[owner] == HE_DEPTH_UNKNOWN) {
+                a->effect[owner] = depth;
+                *progress = true;
+            } else if (a->effect[owner] != depth) {
+                return fail(an, i, "function returns with different stack depths");
+            }
+
+            return true;
+        case OP_CALL: {
+            size_t callee = op->op_object.call.address;
+
+            if (!enter_function(an, i, callee)) { return false; }
+
+            a->label[callee] = true;
+            a->label[i + 1] = true;
+
+            // if the callee's effect isn't known yet, the call is picked up again later
+            if (a->effect[callee] == HE_DEPTH_UNKNOWN) { return true; }
+
+            return visit(an, i, i + 1, depth + a->effect[callee], owner);
+        }
+        case OP_JMP:
+            a->label[op->op_object.jmp.address] = true;
+
+            return visit(an, i, op->op_object.jmp.address, depth, owner);
+        case OP_JZ:
+        case OP_JNZ:
+        case OP_LT_JZ:
+        case OP_LT_JNZ:
+        case OP_GT_JZ:
+        case OP_GT_JNZ:
+            a->label[op->op_object.jmp.address] = true;
+
+            return visit(an, i, op->op_object.jmp.address, depth + delta, owner) &&
+                   visit(an, i, i + 1, depth + delta, owner);
+        case OP_HALT:
+            return true;
+        default:
+            return visit(an, i, i + 1, depth + delta, owner);
+    }
+}
+
+static bool analyze(analyzer *an, size_t entry) {
+    he_stack_analysis *a = an->a;
+    const he_code *code = a->code;
+    bool progress = true;
+
+    if (!enter_function(an, entry, entry)) { return false; }
+
+    // calls to functions whose effect isn't known yet can't continue past the call,
+    // so keep going over the calls until every reachable one has been followed
+    while (progress) {
+        progress = false;
+
+        while (an->work_size != 0) {
+            if (!step(an, entry, an->worklist[--an->work_size], &progress)) { return false; }
+        }
+
+        for (size_t i = 0; i < code->size; ++i) {
+            const he_op *op = &code->ops[i];
+
+            if (op->op != OP_CALL || a->depth[i] == HE_DEPTH_UNKNOWN ||
+                a->depth[i + 1] != HE_DEPTH_UNKNOWN) {
+                continue;
+            }
+
+            size_t callee = op->op_object.call.address;
+
+            if (a->effect[callee] != HE_DEPTH_UNKNOWN) {
+                if (!visit(an, i, i + 1, a->depth[i] + a->effect[callee], a->owner[i])) {
+                    return false;
+                }
+
+                progress = true;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool he_stack_analysis_run(he_stack_analysis *analysis, const he_code *code, size_t entry) {
+    size_t count = code->size + 1;
+    analyzer an;
+
+    analysis->code = code;
+    analysis->depth = he_alloc(sizeof(int32_t), count);
+    analysis->owner = he_alloc(sizeof(size_t), count);
+    analysis->effect = he_alloc(sizeof(int32_t), count);
+    analysis->low = he_alloc(sizeof(int32_t), count);
+    analysis->high = he_alloc(sizeof(int32_t), count);
+    analysis->label = he_alloc(sizeof(bool), count);
+    analysis->error = NULL;
+    analysis->error_index = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        analysis->depth[i] = HE_DEPTH_UNKNOWN;
+        analysis->owner[i] = 0;
+        analysis->effect[i] = HE_DEPTH_UNKNOWN;
+        analysis->low[i] = 0;
+        analysis->high[i] = 0;
+        analysis->label[i] = false;
+    }
+
+    // every instruction goes on the worklist at most once
+    an.a = analysis;
+    an.worklist = he_alloc(sizeof(size_t), count);
+    an.work_size = 0;
+
+    bool ok = analyze(&an, entry);
+
+    he_free_array(an.worklist);
+
+    return ok;
+}
+
+void he_stack_analysis_destroy(he_stack_analysis *analysis) {
+    he_free_array(analysis->depth);
+    he_free_array(analysis->owner);
+    he_free_array(analysis->effect);
+    he_free_array(analysis->low);
+    he_free_array(analysis->high);
+    he_free_array(analysis->label);
+
+    analysis->depth = NULL;
+    analysis->owner = NULL;
+    analysis->effect = NULL;
+    analysis->low = NULL;
+    analysis->high = NULL;
+    analysis->label = NULL;
+}
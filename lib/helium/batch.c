@@ -0,0 +1,766 @@
+#include "helium/batch.h"
+#include "helium/code.h"
+#include "helium/memory.h"
+#include <string.h>
+
+// lanes run a block at a time. every kernel loops over exactly this many, so the
+// compiler can vectorize them without a scalar tail. the last block is padded out with
+// copies of its last lane, which compute the same thing and are never reported
+#define BLOCK_LANES 256
+
+#if defined(__x86_64__) && defined(__GNUC__) && defined(__linux__)
+// the kernels get an AVX2 version next to the baseline one, the loader picks between them
+#define KERNEL __attribute__((target_clones("avx2", "default")))
+#else
+#define KERNEL
+#endif
+
+// with NaN-boxing an int64_t result can still be too wide for a he_value
+#ifdef HE_NAN_BOXING
+#define INT_FITS(num) ((num) >= HE_INT_MIN && (num) <= HE_INT_MAX)
+#else
+#define INT_FITS(num) ((void)(num), true)
+#endif
+
+/** @brief How a column stores its lanes */
+typedef enum column_kind {
+    /** @brief Every lane is an integer, stored as int64_t */
+    COLUMN_INT,
+
+    /** @brief Every lane is a float, stored as double */
+    COLUMN_FLOAT,
+
+    /** @brief Every lane is a bool, stored as an int64_t that's 0 or 1 */
+    COLUMN_BOOL,
+
+    /** @brief The lanes have different types, stored as he_value */
+    COLUMN_VALUE,
+} column_kind;
+
+/** @brief One slot of the stack across a block of lanes */
+typedef struct column {
+    column_kind kind;
+
+    /** @brief BLOCK_LANES entries, with room for that many he_values whatever the kind */
+    void *lanes;
+} column;
+
+/** @brief The state of a block of lanes */
+typedef struct batch {
+    he_vm *vm;
+    const he_module *mod;
+    const he_code *code;
+
+    /** @brief The data stack, `capacity` columns of which `depth` are in use */
+    column *stack;
+    size_t depth;
+    size_t capacity;
+
+    /** @brief Where instructions put their result before it replaces an operand */
+    column result;
+
+    /** @brief Where columns are converted to, before they swap places */
+    column spare;
+
+    /** @brief The return stack as instruction indices, every lane returns the same way */
+    size_t *returns;
+    size_t return_depth;
+    size_t return_capacity;
+
+    /** @brief The lane the block starts at, and how many real lanes it has */
+    size_t first;
+    size_t count;
+
+    he_value *results;
+    he_interpret_flag *flags;
+
+    /** @brief Whether any lane has failed */
+    bool failed;
+} batch;
+
+static void swap_lanes(column *lhs, column *rhs) {
+    void *lanes = lhs->lanes;
+    lhs->lanes = rhs->lanes;
+    rhs->lanes = lanes;
+}
+
+static he_value lane_value(const column *col, size_t lane) {
+    switch (col->kind) {
+        case COLUMN_INT:
+            return he_val_from_int(((const int64_t *)col->lanes)[lane]);
+        case COLUMN_FLOAT:
+            return he_val_from_float(((const double *)col->lanes)[lane]);
+        case COLUMN_BOOL:
+            return he_val_from_bool(((const int64_t *)col->lanes)[lane] != 0);
+        case COLUMN_VALUE:
+            break;
+    }
+
+    return ((const he_value *)col->lanes)[lane];
+}
+
+/** @brief Boxes every lane of a column into a he_value */
+static void box_column(batch *b, column *col) {
+    if (col->kind == COLUMN_VALUE) { return; }
+
+    he_value *values = b->spare.lanes;
+
+    for (size_t i = 0; i < BLOCK_LANES; ++i) {
+        values[i] = lane_value(col, i);
+    }
+
+    swap_lanes(col, &b->spare);
+    col->kind = COLUMN_VALUE;
+}
+
+/** @brief Unboxes a COLUMN_VALUE column if all its lanes are integers, floats or bools */
+static void unbox_column(batch *b, column *col) {
+    if (col->kind != COLUMN_VALUE) { return; }
+
+    const he_value *values = col->lanes;
+    he_value_type type = he_val_type(&values[0]);
+
+    for (size_t i = 1; i < BLOCK_LANES; ++i) {
+        if (he_val_type(&values[i]) != type) { return; }
+    }
+
+    switch (type) {
+        case TYPE_INT: {
+            int64_t *ints = b->spare.lanes;
+
+            for (size_t i = 0; i < BLOCK_LANES; ++i) {
+                ints[i] = he_val_as_int(&values[i]);
+            }
+
+            col->kind = COLUMN_INT;
+            break;
+        }
+        case TYPE_FLOAT: {
+            double *floats = b->spare.lanes;
+
+            for (size_t i = 0; i < BLOCK_LANES; ++i) {
+                floats[i] = he_val_as_float(&values[i]);
+            }
+
+            col->kind = COLUMN_FLOAT;
+            break;
+        }
+        case TYPE_BOOL: {
+            int64_t *bools = b->spare.lanes;
+
+            for (size_t i = 0; i < BLOCK_LANES; ++i) {
+                bools[i] = he_val_as_bool(&values[i]);
+            }
+
+            col->kind = COLUMN_BOOL;
+            break;
+        }
+        default:
+            return;
+    }
+
+    swap_lanes(col, &b->spare);
+}
+
+// the integer kernels return false if any lane overflowed, its result is then wrong and
+// the instruction is redone on he_values, which promotes those lanes to floats
+#define INT_KERNEL(name, overflowed, op)                                                           \
+    KERNEL static bool name(int64_t *restrict out, const int64_t *restrict lhs,                    \
+                            const int64_t *restrict rhs) {                                         \
+        uint64_t bad = 0;                                                                          \
+                                                                                                   \
+        for (size_t i = 0; i < BLOCK_LANES; ++i) {                                                 \
+            int64_t a = lhs[i];                                                                    \
+            int64_t b = rhs[i];                                                                    \
+            int64_t result = (int64_t)((uint64_t)a op (uint64_t)b);                                \
+                                                                                                   \
+            bad |= (uint64_t)(overflowed) >> 63;                                                   \
+            bad |= !INT_FITS(result);                                                              \
+            out[i] = result;                                                                       \
+        }                                                                                          \
+                                                                                                   \
+        return bad == 0;                                                                           \
+    }
+
+INT_KERNEL(add_ints, (a ^ result) & (b ^ result), +)
+INT_KERNEL(sub_ints, (a ^ b) & (a ^ result), -)
+
+#undef INT_KERNEL
+
+// there's no vector multiply of 64 bit integers before AVX-512, so this one stays scalar
+static bool mul_ints(int64_t *restrict out, const int64_t *restrict lhs,
+                     const int64_t *restrict rhs) {
+    bool bad = false;
+
+    for (size_t i = 0; i < BLOCK_LANES; ++i) {
+        bad |= __builtin_mul_overflow(lhs[i], rhs[i], &out[i]);
+        bad |= !INT_FITS(out[i]);
+    }
+
+    return !bad;
+}
+
+#define FLOAT_KERNEL(name, op)                                                                     \
+    KERNEL static void name(double *restrict out, const double *restrict lhs,                      \
+                            const double *restrict rhs) {                                          \
+        for (size_t i = 0; i < BLOCK_LANES; ++i) {                                                 \
+            out[i] = lhs[i] op rhs[i];                                                             \
+        }                                                                                          \
+    }
+
+FLOAT_KERNEL(add_floats, +)
+FLOAT_KERNEL(sub_floats, -)
+FLOAT_KERNEL(mul_floats, *)
+FLOAT_KERNEL(div_floats, /)
+
+#undef FLOAT_KERNEL
+
+#define COMPARE_KERNEL(name, type, op)                                                             \
+    KERNEL static void name(int64_t *restrict out, const type *restrict lhs,                       \
+                            const type *restrict rhs) {                                            \
+        for (size_t i = 0; i < BLOCK_LANES; ++i) {                                                 \
+            out[i] = lhs[i] op rhs[i];                                                             \
+        }                                                                                          \
+    }
+
+COMPARE_KERNEL(gt_ints, int64_t, >)
+COMPARE_KERNEL(lt_ints, int64_t, <)
+COMPARE_KERNEL(gteq_ints, int64_t, >=)
+COMPARE_KERNEL(lteq_ints, int64_t, <=)
+COMPARE_KERNEL(eq_ints, int64_t, ==)
+COMPARE_KERNEL(gt_floats, double, >)
+COMPARE_KERNEL(lt_floats, double, <)
+COMPARE_KERNEL(gteq_floats, double, >=)
+COMPARE_KERNEL(lteq_floats, double, <=)
+COMPARE_KERNEL(eq_floats, double, ==)
+
+#undef COMPARE_KERNEL
+
+KERNEL static void not_bools(int64_t *restrict out, const int64_t *restrict bools) {
+    for (size_t i = 0; i < BLOCK_LANES; ++i) {
+        out[i] = bools[i] ^ 1;
+    }
+}
+
+KERNEL static void negate_floats(double *restrict out, const double *restrict floats) {
+    for (size_t i = 0; i < BLOCK_LANES; ++i) {
+        out[i] = -floats[i];
+    }
+}
+
+/** @brief Negates integers, false if any lane needs promoting to a float */
+static bool negate_ints(int64_t *restrict out, const int64_t *restrict ints) {
+    uint64_t bad = 0;
+
+    for (size_t i = 0; i < BLOCK_LANES; ++i) {
+        int64_t result = (int64_t)(0 - (uint64_t)ints[i]);
+
+        bad |= ints[i] == INT64_MIN;
+        bad |= !INT_FITS(result);
+        out[i] = result;
+    }
+
+    return bad == 0;
+}
+
+/** @brief Runs an instruction on every lane of unboxed columns, false if it can't */
+static bool binary_unboxed(he_opcode op, column *out, const column *lhs, const column *rhs) {
+    void *o = out->lanes;
+    const void *l = lhs->lanes;
+    const void *r = rhs->lanes;
+
+    if (lhs->kind == COLUMN_INT && rhs->kind == COLUMN_INT) {
+        out->kind = COLUMN_BOOL;
+
+        switch (op) {
+            case OP_ADD:
+                out->kind = COLUMN_INT;
+                return add_ints(o, l, r);
+            case OP_SUB:
+                out->kind = COLUMN_INT;
+                return sub_ints(o, l, r);
+            case OP_MUL:
+                out->kind = COLUMN_INT;
+                return mul_ints(o, l, r);
+            case OP_GT:
+                gt_ints(o, l, r);
+                return true;
+            case OP_LT:
+                lt_ints(o, l, r);
+                return true;
+            case OP_GTEQ:
+                gteq_ints(o, l, r);
+                return true;
+            case OP_LTEQ:
+                lteq_ints(o, l, r);
+                return true;
+            case OP_EQ:
+                eq_ints(o, l, r);
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    if (lhs->kind == COLUMN_FLOAT && rhs->kind == COLUMN_FLOAT) {
+        out->kind = COLUMN_BOOL;
+
+        switch (op) {
+            case OP_ADD:
+                out->kind = COLUMN_FLOAT;
+                add_floats(o, l, r);
+                return true;
+            case OP_SUB:
+                out->kind = COLUMN_FLOAT;
+                sub_floats(o, l, r);
+                return true;
+            case OP_MUL:
+                out->kind = COLUMN_FLOAT;
+                mul_floats(o, l, r);
+                return true;
+            case OP_DIV:
+                out->kind = COLUMN_FLOAT;
+                div_floats(o, l, r);
+                return true;
+            case OP_GT:
+                gt_floats(o, l, r);
+                return true;
+            case OP_LT:
+                lt_floats(o, l, r);
+                return true;
+            case OP_GTEQ:
+                gteq_floats(o, l, r);
+                return true;
+            case OP_LTEQ:
+                lteq_floats(o, l, r);
+                return true;
+            case OP_EQ:
+                eq_floats(o, l, r);
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    if (lhs->kind == COLUMN_BOOL && rhs->kind == COLUMN_BOOL && op == OP_EQ) {
+        out->kind = COLUMN_BOOL;
+        eq_ints(o, l, r);
+
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Runs a binary instruction on the top two columns into `b->result`, leaving the
+ * stack as it is. False if it would fail on any lane
+ */
+static bool binary(batch *b, he_opcode op) {
+    column *lhs = &b->stack[b->depth - 2];
+    column *rhs = &b->stack[b->depth - 1];
+
+    if (binary_unboxed(op, &b->result, lhs, rhs)) { return true; }
+
+    // lanes that differ in type, or need promoting, take the same path as the interpreter
+    box_column(b, lhs);
+    box_column(b, rhs);
+
+    const he_value *l = lhs->lanes;
+    const he_value *r = rhs->lanes;
+    he_value *out = b->result.lanes;
+
+    for (size_t i = 0; i < BLOCK_LANES; ++i) {
+        out[i] = l[i];
+
+        if (!he_vm_evaluate(op, &out[i], r[i])) { return false; }
+    }
+
+    b->result.kind = COLUMN_VALUE;
+    unbox_column(b, &b->result);
+
+    return true;
+}
+
+/** @brief Replaces the top two columns with `b->result` */
+static void commit_binary(batch *b) {
+    column *lhs = &b->stack[--b->depth - 1];
+
+    swap_lanes(lhs, &b->result);
+    lhs->kind = b->result.kind;
+}
+
+/** @brief Runs OP_NOT or OP_NEGATE on the top column in place, false if it can't */
+static bool unary(batch *b, he_opcode op) {
+    column *top = &b->stack[b->depth - 1];
+
+    if (op == OP_NOT && top->kind == COLUMN_BOOL) {
+        not_bools(b->result.lanes, top->lanes);
+        swap_lanes(top, &b->result);
+        return true;
+    }
+
+    if (op == OP_NEGATE && top->kind == COLUMN_FLOAT) {
+        negate_floats(b->result.lanes, top->lanes);
+        swap_lanes(top, &b->result);
+        return true;
+    }
+
+    if (op == OP_NEGATE && top->kind == COLUMN_INT && negate_ints(b->result.lanes, top->lanes)) {
+        swap_lanes(top, &b->result);
+        return true;
+    }
+
+    box_column(b, top);
+
+    he_value *values = top->lanes;
+    he_value *out = b->result.lanes;
+
+    for (size_t i = 0; i < BLOCK_LANES; ++i) {
+        out[i] = values[i];
+
+        if (!he_vm_evaluate(op, &out[i], values[i])) { return false; }
+    }
+
+    swap_lanes(top, &b->result);
+    unbox_column(b, top);
+
+    return true;
+}
+
+static void push_constant(batch *b, const he_value *val) {
+    column *col = &b->stack[b->depth++];
+
+    switch (he_val_type(val)) {
+        case TYPE_INT: {
+            int64_t *ints = col->lanes;
+            int64_t num = he_val_as_int(val);
+
+            for (size_t i = 0; i < BLOCK_LANES; ++i) {
+                ints[i] = num;
+            }
+
+            col->kind = COLUMN_INT;
+            return;
+        }
+        case TYPE_FLOAT: {
+            double *floats = col->lanes;
+            double num = he_val_as_float(val);
+
+            for (size_t i = 0; i < BLOCK_LANES; ++i) {
+                floats[i] = num;
+            }
+
+            col->kind = COLUMN_FLOAT;
+            return;
+        }
+        default: {
+            he_value *values = col->lanes;
+
+            for (size_t i = 0; i < BLOCK_LANES; ++i) {
+                values[i] = *val;
+            }
+
+            col->kind = COLUMN_VALUE;
+            unbox_column(b, col);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Checks which way a jump on a column goes
+ * @return False if the lanes don't all agree, or aren't all bools
+ */
+static bool uniform_truth(const column *col, bool *truth) {
+    if (col->kind != COLUMN_BOOL) { return false; }
+
+    const int64_t *bools = col->lanes;
+    int64_t differ = 0;
+
+    for (size_t i = 0; i < BLOCK_LANES; ++i) {
+        differ |= bools[i] ^ bools[0];
+    }
+
+    *truth = bools[0] != 0;
+
+    return differ == 0;
+}
+
+static void report(batch *b, size_t lane, he_interpret_flag flag) {
+    if (b->flags) { b->flags[lane] = flag; }
+    if (flag == INTERPRET_FAILURE) { b->failed = true; }
+}
+
+/**
+ * @brief Runs one lane on the VM on its own, from @p pc with the stacks given
+ * @param b The batch the lane belongs to
+ * @param lane The lane's index among all the lanes
+ * @param values The lane's data stack, `count` values with the top last
+ * @param pc The byte offset to start at
+ */
+static void run_lane(batch *b, size_t lane, const he_value *values, size_t count,
+                     const size_t *returns, size_t return_count, size_t pc) {
+    he_vm *vm = b->vm;
+
+    he_vm_reset(vm);
+
+    if (!he_vm_push_values(vm, values, count) ||
+        !he_vm_push_returns(vm, returns, return_count)) {
+        vm->error = "he_vm_run_batch: lane doesn't fit on the stack";
+        report(b, lane, INTERPRET_FAILURE);
+        return;
+    }
+
+    vm->pc = pc;
+
+    he_interpret_flag flag = he_vm_run(vm, b->mod);
+
+    if (flag == INTERPRET_SUCCESS && vm->stack.sp != vm->stack.base) {
+        b->results[lane] = vm->stack.sp[-1];
+    }
+
+    report(b, lane, flag);
+}
+
+/** @brief Hands every real lane of the block over to run_lane, from instruction @p ip */
+static void split(batch *b, size_t ip) {
+    // the return stack is the same for every lane, only the values differ
+    size_t *returns = he_alloc(sizeof(size_t), b->return_depth + 1);
+    he_value *values = he_alloc(sizeof(he_value), b->depth + 1);
+
+    for (size_t i = 0; i < b->return_depth; ++i) {
+        returns[i] = b->code->offsets[b->returns[i]];
+    }
+
+    for (size_t lane = 0; lane < b->count; ++lane) {
+        for (size_t slot = 0; slot < b->depth; ++slot) {
+            values[slot] = lane_value(&b->stack[slot], lane);
+        }
+
+        run_lane(b, b->first + lane, values, b->depth, returns, b->return_depth,
+                 b->code->offsets[ip]);
+    }
+
+    he_free_array(values);
+    he_free_array(returns);
+    he_vm_reset(b->vm);
+}
+
+static void halt(batch *b) {
+    if (b->depth != 0) {
+        const column *top = &b->stack[b->depth - 1];
+
+        for (size_t lane = 0; lane < b->count; ++lane) {
+            b->results[b->first + lane] = lane_value(top, lane);
+        }
+    }
+
+    if (!b->flags) { return; }
+
+    for (size_t lane = 0; lane < b->count; ++lane) {
+        b->flags[b->first + lane] = INTERPRET_SUCCESS;
+    }
+}
+
+/** @brief Runs the block until it halts, or its lanes split up */
+static void run_block(batch *b) {
+    const he_op *ops = b->code->ops;
+    size_t ip = 0;
+    bool truth = false;
+
+    for (;;) {
+        const he_op *op = &ops[ip];
+
+        // the verifier bounds how deep the stacks get, anything else is for run_lane to report
+        switch (op->op) {
+            case OP_HALT:
+                halt(b);
+                return;
+            case OP_LOAD_CONST:
+                if (b->depth == b->capacity) { break; }
+
+                push_constant(b, &op->op_object.push.val);
+                ++ip;
+                continue;
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:
+            case OP_MOD:
+            case OP_GT:
+            case OP_LT:
+            case OP_GTEQ:
+            case OP_LTEQ:
+            case OP_EQ:
+                if (b->depth < 2 || !binary(b, op->op)) { break; }
+
+                commit_binary(b);
+                ++ip;
+                continue;
+            case OP_NOT:
+            case OP_NEGATE:
+                if (b->depth < 1 || !unary(b, op->op)) { break; }
+
+                ++ip;
+                continue;
+            case OP_EQ_NOT:
+                if (b->depth < 2 || !binary(b, OP_EQ)) { break; }
+
+                commit_binary(b);
+                unary(b, OP_NOT);
+                ++ip;
+                continue;
+            case OP_LOAD_CONST_ADD:
+            case OP_LOAD_CONST_SUB:
+                if (b->depth < 1 || b->depth == b->capacity) { break; }
+
+                push_constant(b, &op->op_object.push.val);
+
+                if (!binary(b, op->op == OP_LOAD_CONST_ADD ? OP_ADD : OP_SUB)) {
+                    --b->depth;
+                    break;
+                }
+
+                commit_binary(b);
+                ++ip;
+                continue;
+            case OP_JMP:
+                ip = op->op_object.jmp.address;
+                continue;
+            case OP_JZ:
+            case OP_JNZ:
+                if (b->depth < 1 || !uniform_truth(&b->stack[b->depth - 1], &truth)) { break; }
+
+                ip = (truth == (op->op == OP_JZ)) ? op->op_object.jmp.address : ip + 1;
+                continue;
+            case OP_LT_JZ:
+            case OP_LT_JNZ:
+            case OP_GT_JZ:
+            case OP_GT_JNZ: {
+                bool lt = op->op == OP_LT_JZ || op->op == OP_LT_JNZ;
+                bool jz = op->op == OP_LT_JZ || op->op == OP_GT_JZ;
+
+                // the comparison only replaces its operands once the lanes agree on the jump
+                if (b->depth < 2 || !binary(b, lt ? OP_LT : OP_GT) ||
+                    !uniform_truth(&b->result, &truth)) {
+                    break;
+                }
+
+                commit_binary(b);
+                ip = (truth == jz) ? op->op_object.jmp.address : ip + 1;
+                continue;
+            }
+            case OP_POP:
+                if (b->depth < 1) { break; }
+
+                --b->depth;
+                ++ip;
+                continue;
+            case OP_DUP: {
+                if (b->depth < 1 || b->depth == b->capacity) { break; }
+
+                column *top = &b->stack[b->depth - 1];
+                column *copy = &b->stack[b->depth++];
+
+                size_t size = top->kind == COLUMN_VALUE ? sizeof(he_value) : sizeof(int64_t);
+
+                memcpy(copy->lanes, top->lanes, BLOCK_LANES * size);
+                copy->kind = top->kind;
+                ++ip;
+                continue;
+            }
+            case OP_CALL:
+                if (b->return_depth == b->return_capacity) { break; }
+
+                b->returns[b->return_depth++] = op->op_object.call.return_address;
+                ip = op->op_object.call.address;
+                continue;
+            case OP_RET:
+                if (b->return_depth == 0) { break; }
+
+                ip = b->returns[--b->return_depth];
+                continue;
+            default:
+                break;
+        }
+
+        // anything that didn't continue can't run on every lane together
+        split(b, ip);
+        return;
+    }
+}
+
+/** @brief Fills the block's stack with its lanes' inputs */
+static void load_block(batch *b, const he_value *inputs, size_t input_count) {
+    b->depth = input_count;
+    b->return_depth = 0;
+
+    for (size_t slot = 0; slot < input_count; ++slot) {
+        column *col = &b->stack[slot];
+        he_value *values = col->lanes;
+
+        for (size_t i = 0; i < BLOCK_LANES; ++i) {
+            size_t lane = b->first + (i < b->count ? i : b->count - 1);
+
+            values[i] = inputs[lane * input_count + slot];
+        }
+
+        col->kind = COLUMN_VALUE;
+        unbox_column(b, col);
+    }
+}
+
+he_interpret_flag he_vm_run_batch(he_vm *vm, const he_module *mod, const he_value *inputs,
+                                  size_t input_count, size_t lanes, he_value *results,
+                                  he_interpret_flag *flags) {
+    batch b = {.vm = vm, .mod = mod, .code = &vm->code, .results = results, .flags = flags};
+
+    if (vm->mod != mod || !he_code_is_current(&vm->code, mod)) { he_vm_use(vm, mod); }
+
+    const he_function_bounds *bounds = &mod->bounds;
+    bool parallel = he_code_is_current(&vm->code, mod) && mod->verified && !bounds->recursive &&
+                    input_count >= bounds->stack_inputs;
+
+    if (!parallel) {
+        // every lane runs on its own, he_vm_run reports anything wrong with the module
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            run_lane(&b, lane, inputs + lane * input_count, input_count, NULL, 0, 0);
+        }
+
+        he_vm_reset(vm);
+
+        return b.failed ? INTERPRET_FAILURE : INTERPRET_SUCCESS;
+    }
+
+    // one more column than the verifier counts, for the constant OP_LOAD_CONST_ADD pushes
+    b.capacity = input_count + bounds->max_stack_depth + 1;
+    b.return_capacity = bounds->max_return_depth;
+
+    // two extra columns for `result` and `spare`
+    size_t column_bytes = BLOCK_LANES * sizeof(he_value);
+    uint8_t *storage = he_alloc(column_bytes, b.capacity + 2);
+
+    b.stack = he_alloc(sizeof(column), b.capacity + 1);
+    b.returns = he_alloc(sizeof(size_t), b.return_capacity + 1);
+
+    for (size_t slot = 0; slot < b.capacity; ++slot) {
+        b.stack[slot].lanes = storage + slot * column_bytes;
+    }
+
+    b.result.lanes = storage + b.capacity * column_bytes;
+    b.spare.lanes = storage + (b.capacity + 1) * column_bytes;
+
+    for (b.first = 0; b.first < lanes; b.first += BLOCK_LANES) {
+        b.count = (lanes - b.first < BLOCK_LANES) ? lanes - b.first : BLOCK_LANES;
+
+        load_block(&b, inputs, input_count);
+        run_block(&b);
+    }
+
+    he_free_array(b.returns);
+    he_free_array(b.stack);
+    he_free_array(storage);
+
+    return b.failed ? INTERPRET_FAILURE : INTERPRET_SUCCESS;
+}
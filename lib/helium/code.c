@@ -0,0 +1,199 @@
+#include "helium/code.h"
+#include "helium/memory.h"
+#include <string.h>
+
+void he_code_init(he_code *code) {
+    code->ops = NULL;
+    code->size = 0;
+    code->offsets = NULL;
+    code->mod = NULL;
+    code->mod_id = 0;
+    code->mod_generation = 0;
+    code->threaded = NULL;
+    code->error = NULL;
+    code->error_offset = 0;
+}
+
+void he_code_destroy(he_code *code) {
+    he_free_array(code->ops);
+    he_free_array(code->offsets);
+
+    he_code_init(code);
+}
+
+size_t he_code_index_of(const he_code *code, size_t offset) {
+    // offsets is sorted, and includes the end of the module as the last entry
+    size_t low = 0;
+    size_t high = code->size + 1;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+
+        if (code->offsets[mid] < offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low <= code->size && code->offsets[low] == offset) { return low; }
+
+    return code->size + 1;
+}
+
+/**
+ * @brief Reads the instruction at @p pc, moving @p pc past it
+ * @return NULL, or why the instruction can't be read
+ */
+static const char *read_instruction(const he_module *mod, size_t *pc, he_opcode *op,
+                                    size_t *operand) {
+    const uint8_t *bytes = mod->ops.array;
+
+    if (!he_opcode_is_valid(bytes[*pc])) { return "unknown opcode"; }
+
+    *op = (he_opcode)bytes[(*pc)++];
+    *operand = 0;
+
+    if (he_opcode_has_operand(*op) && !he_module_read_int(bytes, mod->ops.size, pc, operand)) {
+        return "operand is cut off or too large";
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Walks the bytecode, counting instructions and checking that every
+ * opcode is known and has all of its operand bytes
+ */
+static bool count_instructions(he_code *code, const he_module *mod, size_t *count) {
+    size_t pc = 0;
+    size_t n = 0;
+
+    while (pc < mod->ops.size) {
+        size_t start = pc;
+        he_opcode op;
+        size_t operand;
+        const char *error = read_instruction(mod, &pc, &op, &operand);
+
+        if (error) {
+            code->error = error;
+            code->error_offset = start;
+            return false;
+        }
+
+        ++n;
+    }
+
+    *count = n;
+
+    return true;
+}
+
+static bool resolve_target(const he_code *code, size_t address, size_t *index) {
+    *index = he_code_index_of(code, address);
+
+    return *index <= code->size;
+}
+
+bool he_code_translate(he_code *code, const he_module *mod) {
+    size_t count;
+
+    he_code_destroy(code);
+
+    if (!count_instructions(code, mod, &count)) { return false; }
+
+    code->ops = he_alloc(sizeof(he_op), count + 1);
+    code->offsets = he_alloc(sizeof(size_t), count + 1);
+    code->size = count;
+    code->mod = mod;
+    code->mod_id = mod->id;
+    code->mod_generation = mod->generation;
+
+    size_t *operands = he_alloc(sizeof(size_t), count + 1);
+    const char *error = NULL;
+    size_t error_index = 0;
+    size_t pc = 0;
+
+    // the bytecode was already checked while counting, so reading it again can't fail
+    for (size_t i = 0; i < count; ++i) {
+        he_opcode opcode;
+
+        code->offsets[i] = pc;
+        read_instruction(mod, &pc, &opcode, &operands[i]);
+        code->ops[i].op = opcode;
+    }
+
+    code->offsets[count] = mod->ops.size;
+
+    for (size_t i = 0; i < count; ++i) {
+        he_op *op = &code->ops[i];
+        size_t operand = operands[i];
+
+        op->handler = NULL;
+        op->quick = op->op;
+        op->deopts = 0;
+        op->hits = 0;
+        memset(&op->op_object, 0, sizeof(op->op_object));
+
+        switch (op->op) {
+            case OP_CALL:
+                if (!resolve_target(code, operand, &op->op_object.call.address)) {
+                    error = "call target is not the start of an instruction";
+                    error_index = i;
+                    goto malformed;
+                }
+
+                op->op_object.call.return_address = i + 1;
+                break;
+            case OP_LOAD_CONST:
+            case OP_LOAD_CONST_ADD:
+            case OP_LOAD_CONST_SUB:
+                if (operand >= mod->pool.size) {
+                    error = "constant index is out of range";
+                    error_index = i;
+                    goto malformed;
+                }
+
+                op->op_object.push.val = *(const he_value *)he_vector_at(&mod->pool, operand);
+                break;
+            case OP_JMP:
+            case OP_JZ:
+            case OP_JNZ:
+            case OP_LT_JZ:
+            case OP_LT_JNZ:
+            case OP_GT_JZ:
+            case OP_GT_JNZ:
+                if (!resolve_target(code, operand, &op->op_object.jmp.address)) {
+                    error = "jump target is not the start of an instruction";
+                    error_index = i;
+                    goto malformed;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    // the sentinel means the interpreter never has to check for running off the end
+    code->ops[count].handler = NULL;
+    code->ops[count].op = OP_HALT;
+    code->ops[count].quick = OP_HALT;
+    code->ops[count].deopts = 0;
+    code->ops[count].hits = 0;
+    memset(&code->ops[count].op_object, 0, sizeof(code->ops[count].op_object));
+
+    he_free_array(operands);
+
+    return true;
+
+malformed:
+    error_index = code->offsets[error_index];
+
+    he_free_array(operands);
+    he_code_destroy(code);
+
+    code->error = error;
+    code->error_offset = error_index;
+
+    return false;
+}
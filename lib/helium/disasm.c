@@ -0,0 +1,116 @@
+#include "helium/disasm.h"
+#include "helium/instruction.h"
+#include <string.h>
+
+// enough lines per write that dumping a large module isn't dominated by fwrite
+#define FILE_BUFFER_SIZE (64 * 1024)
+
+static const char hex_digits[] = "0123456789abcdef";
+
+/** @brief Writes @p num as at least @p width hex digits, returning the end */
+static char *write_hex(char *out, size_t num, int width) {
+    int digits = 1;
+
+    while (digits < (int)(sizeof(size_t) * 2) && (num >> (digits * 4)) != 0) {
+        ++digits;
+    }
+
+    if (digits < width) { digits = width; }
+
+    for (int i = digits - 1; i >= 0; --i) {
+        out[i] = hex_digits[num & 0xF];
+        num >>= 4;
+    }
+
+    return out + digits;
+}
+
+static char *write_decimal(char *out, size_t num) {
+    char digits[20];
+    size_t count = 0;
+
+    do {
+        digits[count++] = (char)('0' + num % 10);
+        num /= 10;
+    } while (num != 0);
+
+    while (count != 0) {
+        *out++ = digits[--count];
+    }
+
+    return out;
+}
+
+static char *write_string(char *out, const char *string) {
+    size_t length = strlen(string);
+
+    memcpy(out, string, length);
+
+    return out + length;
+}
+
+size_t he_disasm_instruction(const he_module *mod, size_t *offset, char *buffer) {
+    const uint8_t *bytes = mod->ops.array;
+    size_t size = mod->ops.size;
+    size_t at = *offset;
+
+    if (at >= size) { return 0; }
+
+    uint8_t byte = bytes[at];
+    bool valid = he_opcode_is_valid(byte);
+    char *out = buffer;
+
+    out = write_hex(out, at, 8);
+    out = write_string(out, ": ");
+    out = write_hex(out, byte, 2);
+    out = write_string(out, " (");
+    out = write_string(out, valid ? he_opcode_name((he_opcode)byte) : "OP_UNKNOWN");
+    *out++ = ')';
+
+    *offset = at + 1;
+
+    if (valid && he_opcode_has_operand((he_opcode)byte)) {
+        size_t next = at + 1;
+        size_t operand = 0;
+
+        out = write_string(out, " arg: ");
+
+        if (!he_module_read_int(bytes, size, &next, &operand)) {
+            *out++ = '?';
+        } else {
+            bool is_address = byte == OP_CALL || he_opcode_is_jump((he_opcode)byte);
+
+            out = is_address ? write_hex(out, operand, 8) : write_decimal(out, operand);
+            *offset = next;
+        }
+    }
+
+    *out++ = '\n';
+
+    return (size_t)(out - buffer);
+}
+
+size_t he_disasm_range(const he_module *mod, size_t *offset, size_t end, char *buffer,
+                       size_t capacity) {
+    size_t written = 0;
+
+    if (end > mod->ops.size) { end = mod->ops.size; }
+
+    while (*offset < end && capacity - written >= HE_DISASM_LINE_MAX) {
+        written += he_disasm_instruction(mod, offset, buffer + written);
+    }
+
+    return written;
+}
+
+bool he_disasm_file(const he_module *mod, size_t start, size_t end, FILE *file) {
+    char buffer[FILE_BUFFER_SIZE];
+    size_t offset = start;
+    size_t written = 0;
+
+    while ((written = he_disasm_range(mod, &offset, end, buffer, sizeof(buffer))) != 0) {
+        if (fwrite(buffer, 1, written, file) != written) { return false; }
+    }
+
+    return true;
+}
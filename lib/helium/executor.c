@@ -0,0 +1,281 @@
+#include "helium/executor.h"
+#include "helium/memory.h"
+#include <unistd.h>
+
+#define INITIAL_DEQUE_CAPACITY 64
+
+void he_future_init(he_future *future) {
+    pthread_mutex_init(&future->lock, NULL);
+    pthread_cond_init(&future->cond, NULL);
+
+    future->done = false;
+}
+
+void he_future_destroy(he_future *future) {
+    pthread_mutex_destroy(&future->lock);
+    pthread_cond_destroy(&future->cond);
+}
+
+bool he_future_ready(he_future *future) {
+    pthread_mutex_lock(&future->lock);
+    bool done = future->done;
+    pthread_mutex_unlock(&future->lock);
+
+    return done;
+}
+
+he_job_result he_future_wait(he_future *future) {
+    pthread_mutex_lock(&future->lock);
+
+    while (!future->done) {
+        pthread_cond_wait(&future->cond, &future->lock);
+    }
+
+    he_job_result result = future->result;
+    pthread_mutex_unlock(&future->lock);
+
+    return result;
+}
+
+static void he_future_complete(he_future *future, const he_job_result *result) {
+    pthread_mutex_lock(&future->lock);
+    future->result = *result;
+    future->done = true;
+    pthread_cond_broadcast(&future->cond);
+    pthread_mutex_unlock(&future->lock);
+}
+
+/** @brief Pushes a task onto the back of a worker's deque, growing it if it's full */
+static void he_worker_push(he_worker *worker, const he_task *task) {
+    pthread_mutex_lock(&worker->lock);
+
+    if (worker->size == worker->capacity) {
+        size_t capacity = worker->capacity;
+        he_task *tasks = he_grow_array(NULL, sizeof(he_task), &capacity);
+
+        // unwrap the ring so the tasks start at index 0 again
+        for (size_t i = 0; i < worker->size; ++i) {
+            tasks[i] = worker->tasks[(worker->head + i) & (worker->capacity - 1)];
+        }
+
+        he_free_array(worker->tasks);
+
+        worker->tasks = tasks;
+        worker->capacity = capacity;
+        worker->head = 0;
+    }
+
+    worker->tasks[(worker->head + worker->size) & (worker->capacity - 1)] = *task;
+    ++worker->size;
+
+    pthread_mutex_unlock(&worker->lock);
+}
+
+/** @brief Takes the oldest task from the front of a worker's own deque */
+static bool he_worker_pop(he_worker *worker, he_task *task) {
+    bool found = false;
+
+    pthread_mutex_lock(&worker->lock);
+
+    if (worker->size != 0) {
+        *task = worker->tasks[worker->head];
+        worker->head = (worker->head + 1) & (worker->capacity - 1);
+        --worker->size;
+        found = true;
+    }
+
+    pthread_mutex_unlock(&worker->lock);
+
+    return found;
+}
+
+/** @brief Takes the newest task from the back of another worker's deque */
+static bool he_worker_steal(he_worker *victim, he_task *task) {
+    bool found = false;
+
+    // don't queue up behind a busy owner, there are other victims to try
+    if (pthread_mutex_trylock(&victim->lock) != 0) { return false; }
+
+    if (victim->size != 0) {
+        --victim->size;
+        *task = victim->tasks[(victim->head + victim->size) & (victim->capacity - 1)];
+        found = true;
+    }
+
+    pthread_mutex_unlock(&victim->lock);
+
+    return found;
+}
+
+static bool he_executor_find_task(he_executor *executor, he_worker *self, he_task *task) {
+    if (he_worker_pop(self, task)) { return true; }
+
+    size_t self_index = (size_t)(self - executor->workers);
+
+    for (size_t i = 1; i < executor->worker_count; ++i) {
+        he_worker *victim = &executor->workers[(self_index + i) % executor->worker_count];
+
+        if (he_worker_steal(victim, task)) { return true; }
+    }
+
+    return false;
+}
+
+static void he_worker_run_task(he_worker *worker, const he_task *task) {
+    const he_job *job = &task->job;
+    he_vm *vm = &worker->vm;
+    he_job_result result;
+
+    he_vm_reset(vm);
+
+    // decoding is the expensive part of switching modules, so it only happens on a change.
+    // a module created where a destroyed one was, or changed since, counts as a change
+    if (!he_code_is_current(&vm->code, job->mod)) { he_vm_use(vm, job->mod); }
+
+    vm->pc = job->entry;
+
+    if (!he_vm_push_values(vm, job->inputs, job->input_count)) {
+        result.flag = INTERPRET_FAILURE;
+        result.error = "he_executor: too many inputs for the VM's stack";
+    } else {
+        result.flag = he_vm_run(vm, job->mod);
+        result.error = vm->error;
+    }
+
+    result.has_value = result.flag == INTERPRET_SUCCESS && vm->stack.sp != vm->stack.base;
+
+    if (result.has_value) { result.value = vm->stack.sp[-1]; }
+
+    if (job->callback) { job->callback(&result, job->user_data); }
+
+    if (task->future) { he_future_complete(task->future, &result); }
+}
+
+static void *he_worker_main(void *arg) {
+    he_worker *self = arg;
+    he_executor *executor = self->owner;
+    he_task task;
+
+    for (;;) {
+        if (he_executor_find_task(executor, self, &task)) {
+            __atomic_fetch_sub(&executor->pending, 1, __ATOMIC_ACQ_REL);
+
+            he_worker_run_task(self, &task);
+            continue;
+        }
+
+        pthread_mutex_lock(&executor->sleep_lock);
+
+        // pending is bumped before submitters take sleep_lock, so checking it under
+        // the lock means a wakeup can't be missed
+        while (__atomic_load_n(&executor->pending, __ATOMIC_ACQUIRE) == 0) {
+            if (__atomic_load_n(&executor->stopping, __ATOMIC_ACQUIRE)) {
+                pthread_mutex_unlock(&executor->sleep_lock);
+                return NULL;
+            }
+
+            pthread_cond_wait(&executor->wake, &executor->sleep_lock);
+        }
+
+        pthread_mutex_unlock(&executor->sleep_lock);
+    }
+}
+
+/** @brief Stops and joins the first @p started workers, then frees everything */
+static void he_executor_shutdown(he_executor *executor, size_t started) {
+    pthread_mutex_lock(&executor->sleep_lock);
+    __atomic_store_n(&executor->stopping, true, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&executor->wake);
+    pthread_mutex_unlock(&executor->sleep_lock);
+
+    for (size_t i = 0; i < started; ++i) {
+        pthread_join(executor->workers[i].thread, NULL);
+    }
+
+    for (size_t i = 0; i < executor->worker_count; ++i) {
+        he_worker *worker = &executor->workers[i];
+
+        he_vm_destroy(&worker->vm);
+        pthread_mutex_destroy(&worker->lock);
+        he_free_array(worker->tasks);
+    }
+
+    pthread_mutex_destroy(&executor->sleep_lock);
+    pthread_cond_destroy(&executor->wake);
+    he_free_array(executor->workers);
+
+    executor->workers = NULL;
+    executor->worker_count = 0;
+}
+
+static size_t he_cpu_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (count > 0) ? (size_t)count : 1;
+}
+
+bool he_executor_init(he_executor *executor, size_t thread_count, const he_vm_config *config) {
+    he_vm_config default_config = he_vm_default_config();
+
+    if (!config) { config = &default_config; }
+    if (thread_count == 0) { thread_count = he_cpu_count(); }
+
+    executor->workers = he_alloc(sizeof(he_worker), thread_count);
+    executor->worker_count = thread_count;
+    executor->pending = 0;
+    executor->next_worker = 0;
+    executor->stopping = false;
+
+    pthread_mutex_init(&executor->sleep_lock, NULL);
+    pthread_cond_init(&executor->wake, NULL);
+
+    // every deque has to exist before any worker can try to steal from it
+    for (size_t i = 0; i < thread_count; ++i) {
+        he_worker *worker = &executor->workers[i];
+
+        he_vm_init_config(&worker->vm, config);
+        pthread_mutex_init(&worker->lock, NULL);
+
+        worker->tasks = he_alloc(sizeof(he_task), INITIAL_DEQUE_CAPACITY);
+        worker->capacity = INITIAL_DEQUE_CAPACITY;
+        worker->head = 0;
+        worker->size = 0;
+        worker->owner = executor;
+    }
+
+    for (size_t i = 0; i < thread_count; ++i) {
+        he_worker *worker = &executor->workers[i];
+
+        if (pthread_create(&worker->thread, NULL, he_worker_main, worker) != 0) {
+            // nothing has been submitted yet, so only the started workers need stopping
+            he_executor_shutdown(executor, i);
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void he_executor_destroy(he_executor *executor) {
+    he_executor_shutdown(executor, executor->worker_count);
+}
+
+void he_executor_submit(he_executor *executor, const he_job *job, he_future *future) {
+    assert(executor->worker_count != 0 && "submitting to an executor with no workers");
+
+    size_t index = __atomic_fetch_add(&executor->next_worker, 1, __ATOMIC_RELAXED);
+    he_task task;
+
+    task.job = *job;
+    task.future = future;
+
+    // counted before it's visible so that a worker taking it can't underflow pending
+    __atomic_fetch_add(&executor->pending, 1, __ATOMIC_ACQ_REL);
+
+    he_worker_push(&executor->workers[index % executor->worker_count], &task);
+
+    pthread_mutex_lock(&executor->sleep_lock);
+    pthread_cond_signal(&executor->wake);
+    pthread_mutex_unlock(&executor->sleep_lock);
+}
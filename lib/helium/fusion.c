@@ -0,0 +1,165 @@
+#include "helium/fusion.h"
+#include "helium/code.h"
+#include "helium/memory.h"
+#include <string.h>
+
+const he_fusion_rule he_fusion_rules[] = {
+    {OP_LOAD_CONST, OP_ADD, OP_LOAD_CONST_ADD},
+    {OP_LOAD_CONST, OP_SUB, OP_LOAD_CONST_SUB},
+    {OP_LT, OP_JZ, OP_LT_JZ},
+    {OP_LT, OP_JNZ, OP_LT_JNZ},
+    {OP_GT, OP_JZ, OP_GT_JZ},
+    {OP_GT, OP_JNZ, OP_GT_JNZ},
+    {OP_EQ, OP_NOT, OP_EQ_NOT},
+};
+
+const size_t he_fusion_rule_count = sizeof(he_fusion_rules) / sizeof(he_fusion_rules[0]);
+
+size_t he_fusion_select(const he_ngram_table *bigrams, size_t min_count, he_fusion_rule *out) {
+    size_t counts[sizeof(he_fusion_rules) / sizeof(he_fusion_rules[0])];
+    size_t picked = 0;
+
+    assert(bigrams->n == 2 && "fusion rules can only be picked from a bigram profile");
+
+    for (size_t i = 0; i < he_fusion_rule_count; ++i) {
+        he_opcode pair[2] = {he_fusion_rules[i].first, he_fusion_rules[i].second};
+        size_t count = he_ngram_table_count(bigrams, he_ngram_key(pair, 2));
+
+        if (count == 0 || count < min_count) { continue; }
+
+        // insertion sort, there are only a handful of rules
+        size_t j = picked++;
+
+        for (; j > 0 && counts[j - 1] < count; --j) {
+            out[j] = out[j - 1];
+            counts[j] = counts[j - 1];
+        }
+
+        out[j] = he_fusion_rules[i];
+        counts[j] = count;
+    }
+
+    return picked;
+}
+
+static const he_fusion_rule *find_rule(const he_fusion_rule *rules, size_t rule_count,
+                                       he_opcode first, he_opcode second) {
+    for (size_t i = 0; i < rule_count; ++i) {
+        if (rules[i].first == first && rules[i].second == second) { return &rules[i]; }
+    }
+
+    return NULL;
+}
+
+/** @brief Checks that a rule is one of he_fusion_rules, the only pairs the VM can run fused */
+static bool is_known_rule(const he_fusion_rule *rule) {
+    for (size_t i = 0; i < he_fusion_rule_count; ++i) {
+        const he_fusion_rule *known = &he_fusion_rules[i];
+
+        if (known->first == rule->first && known->second == rule->second &&
+            known->fused == rule->fused) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/** @brief Reads the constant index of an already decoded OP_LOAD_CONST */
+static size_t read_constant(const he_module *mod, const he_code *code, size_t i) {
+    size_t offset = code->offsets[i] + 1;
+    size_t operand = 0;
+
+    he_module_read_int(mod->ops.array, mod->ops.size, &offset, &operand);
+
+    return operand;
+}
+
+bool he_module_fuse(he_module *mod, const he_fusion_rule *rules, size_t rule_count, size_t *fused) {
+    he_code code;
+    size_t n_fused = 0;
+
+    for (size_t i = 0; i < rule_count; ++i) {
+        if (!is_known_rule(&rules[i])) { return false; }
+    }
+
+    // decoding checks the bytecode and resolves every jump to an instruction index
+    he_code_init(&code);
+
+    if (!he_code_translate(&code, mod)) { return false; }
+
+    size_t count = code.size + 1;
+    bool *is_target = he_alloc(sizeof(bool), count);
+    size_t *new_index = he_alloc(sizeof(size_t), count);
+    he_module_op *out = he_alloc(sizeof(he_module_op), count);
+    size_t out_size = 0;
+
+    memset(is_target, 0, sizeof(bool) * count);
+
+    for (size_t i = 0; i < code.size; ++i) {
+        const he_op *op = &code.ops[i];
+
+        if (op->op == OP_CALL) {
+            is_target[op->op_object.call.address] = true;
+            is_target[i + 1] = true;
+        } else if (he_opcode_is_jump(op->op)) {
+            is_target[op->op_object.jmp.address] = true;
+        }
+    }
+
+    // jumps still hold old instruction indices here, they're mapped once every
+    // instruction's new index is known
+    for (size_t i = 0; i < code.size; ++i) {
+        const he_op *op = &code.ops[i];
+        const he_fusion_rule *rule = NULL;
+        he_module_op *emitted = &out[out_size];
+
+        if (i + 1 < code.size && !is_target[i + 1]) {
+            rule = find_rule(rules, rule_count, op->op, code.ops[i + 1].op);
+        }
+
+        new_index[i] = out_size++;
+        emitted->op = op->op;
+        emitted->operand = 0;
+
+        if (rule) {
+            // the superinstruction takes whichever operand the pair had
+            ++i;
+            new_index[i] = new_index[i - 1];
+            emitted->op = rule->fused;
+            op = he_opcode_is_jump(rule->fused) ? &code.ops[i] : op;
+            ++n_fused;
+        }
+
+        if (op->op == OP_CALL) {
+            emitted->operand = op->op_object.call.address;
+        } else if (he_opcode_is_jump(op->op)) {
+            emitted->operand = op->op_object.jmp.address;
+        } else if (he_opcode_has_operand(op->op)) {
+            emitted->operand = read_constant(mod, &code, (size_t)(op - code.ops));
+        }
+    }
+
+    new_index[code.size] = out_size;
+
+    // with nothing fused the bytecode would come out the same, and keeps its verification
+    if (n_fused != 0) {
+        for (size_t i = 0; i < out_size; ++i) {
+            if (out[i].op == OP_CALL || he_opcode_is_jump((he_opcode)out[i].op)) {
+                out[i].operand = new_index[out[i].operand];
+            }
+        }
+
+        he_module_clear_ops(mod);
+        he_module_write_ops(mod, out, out_size);
+    }
+
+    he_free_array(is_target);
+    he_free_array(new_index);
+    he_free_array(out);
+    he_code_destroy(&code);
+
+    if (fused) { *fused = n_fused; }
+
+    return true;
+}
@@ -0,0 +1,616 @@
+#include "helium/heap.h"
+#include "helium/intern.h"
+#include "helium/memory.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ALIGNMENT _Alignof(max_align_t)
+
+/** @brief The kind of the filler objects free space is made of */
+#define OBJECT_FREE 0xFF
+
+/** @brief The number of handles each of the handle pool's blocks holds */
+#define HANDLES_PER_BLOCK 64
+
+/** @brief Bigger objects than this get a block to themselves, and start out old */
+#define LARGE_OBJECT_SIZE (HE_HEAP_BLOCK_SIZE / 4)
+
+/** @brief Where a block is kept between uses */
+typedef enum block_state {
+    /** @brief In the nursery, or full enough that it isn't on any list */
+    BLOCK_IN_USE,
+
+    /** @brief In `recyclable` */
+    BLOCK_RECYCLABLE,
+
+    /** @brief In `free_blocks` */
+    BLOCK_FREE,
+} block_state;
+
+/**
+ * @brief A block of objects laid out one after another, with free space filled in by
+ * OBJECT_FREE objects so that the block can always be walked. Blocks are aligned to
+ * HE_HEAP_BLOCK_SIZE, so the block an object is in is found by masking its address
+ */
+struct he_heap_block {
+    /** @brief The next block in whichever list this one is in */
+    he_heap_block *next;
+
+    /** @brief The bytes of the block including this header, a multiple of HE_HEAP_BLOCK_SIZE */
+    size_t size;
+
+    block_state state;
+
+    max_align_t objects[];
+};
+
+static size_t align_up(size_t size) {
+    return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+_Noreturn static void out_of_memory(const char *function) {
+    fprintf(stderr, "%s: unable to allocate memory!\n", function);
+    exit(-1);
+}
+
+static he_heap_block *block_of(const void *ptr) {
+    return (he_heap_block *)((uintptr_t)ptr & ~(uintptr_t)(HE_HEAP_BLOCK_SIZE - 1));
+}
+
+static uint8_t *block_begin(he_heap_block *block) {
+    return (uint8_t *)block->objects;
+}
+
+static uint8_t *block_end(he_heap_block *block) {
+    return (uint8_t *)block + block->size;
+}
+
+/** @brief Turns @p size bytes at @p at into free space */
+static void fill(uint8_t *at, size_t size) {
+    he_object *filler = (he_object *)at;
+
+    filler->size = size;
+    filler->kind = OBJECT_FREE;
+    filler->marked = 0;
+    filler->remembered = 0;
+    filler->old = 0;
+}
+
+/** @brief Finds where a block is in the sorted array of blocks, or where it would go */
+static size_t find_block_index(const he_heap *heap, const he_heap_block *block) {
+    size_t low = 0;
+    size_t count = heap->block_count;
+
+    while (count > 0) {
+        size_t half = count / 2;
+
+        if ((uintptr_t)heap->blocks[low + half] < (uintptr_t)block) {
+            low += half + 1;
+            count -= half + 1;
+        } else {
+            count = half;
+        }
+    }
+
+    return low;
+}
+
+static bool owns_block(const he_heap *heap, const he_heap_block *block) {
+    size_t index = find_block_index(heap, block);
+
+    return index < heap->block_count && heap->blocks[index] == block;
+}
+
+/** @brief Allocates an empty block of @p size bytes and adds it to the sorted array */
+static he_heap_block *new_block(he_heap *heap, size_t size) {
+    he_heap_block *block = aligned_alloc(HE_HEAP_BLOCK_SIZE, size);
+
+    if (!block) { out_of_memory("he_heap"); }
+
+    he_memory_count(size);
+
+    if (heap->block_count == heap->block_capacity) {
+        heap->blocks = he_grow_array(heap->blocks, sizeof(he_heap_block *), &heap->block_capacity);
+    }
+
+    size_t index = find_block_index(heap, block);
+
+    memmove(&heap->blocks[index + 1], &heap->blocks[index],
+            (heap->block_count - index) * sizeof(he_heap_block *));
+
+    heap->blocks[index] = block;
+    ++heap->block_count;
+    heap->bytes_reserved += size;
+
+    block->next = NULL;
+    block->size = size;
+    block->state = BLOCK_IN_USE;
+
+    fill(block_begin(block), block_end(block) - block_begin(block));
+
+    return block;
+}
+
+static void release_block(he_heap *heap, he_heap_block *block) {
+    size_t index = find_block_index(heap, block);
+
+    assert(index < heap->block_count && heap->blocks[index] == block && "block isn't the heap's");
+
+    memmove(&heap->blocks[index], &heap->blocks[index + 1],
+            (heap->block_count - index - 1) * sizeof(he_heap_block *));
+
+    --heap->block_count;
+    heap->bytes_reserved -= block->size;
+
+    free(block);
+}
+
+static void request_collection(he_heap *heap, he_gc_kind kind) {
+    if (!heap->pending || kind == GC_MAJOR) { heap->pending_kind = kind; }
+
+    heap->pending = true;
+}
+
+/** @brief Gives the rest of the free space being allocated from back to the block */
+static void close_free_space(he_heap *heap) {
+    if (heap->cursor != heap->limit) { fill(heap->cursor, heap->limit - heap->cursor); }
+
+    heap->cursor = NULL;
+    heap->limit = NULL;
+}
+
+/** @brief Moves the cursor to the next free space in the current block that @p size fits in */
+static bool find_free_space(he_heap *heap, size_t size) {
+    he_heap_block *block = heap->nursery;
+    uint8_t *at = heap->limit ? heap->limit : block_begin(block);
+
+    close_free_space(heap);
+
+    for (uint8_t *end = block_end(block); at < end; at += ((he_object *)at)->size) {
+        he_object *object = (he_object *)at;
+
+        if (object->kind == OBJECT_FREE && object->size >= size) {
+            heap->cursor = at;
+            heap->limit = at + object->size;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/** @brief Starts allocating from another block, one with old objects in it if there is one */
+static void next_block(he_heap *heap) {
+    he_heap_block *block;
+
+    close_free_space(heap);
+
+    if (heap->recyclable) {
+        block = heap->recyclable;
+        heap->recyclable = block->next;
+    } else if (heap->free_blocks) {
+        block = heap->free_blocks;
+        heap->free_blocks = block->next;
+        --heap->free_count;
+    } else {
+        block = new_block(heap, HE_HEAP_BLOCK_SIZE);
+    }
+
+    block->state = BLOCK_IN_USE;
+    block->next = heap->nursery;
+    heap->nursery = block;
+}
+
+static he_object *allocate_small(he_heap *heap, size_t size) {
+    while ((size_t)(heap->limit - heap->cursor) < size) {
+        if (!heap->nursery || !find_free_space(heap, size)) { next_block(heap); }
+    }
+
+    he_object *object = (he_object *)heap->cursor;
+
+    heap->cursor += size;
+    heap->nursery_bytes += size;
+
+    if (heap->nursery_bytes >= heap->nursery_size) { request_collection(heap, GC_MINOR); }
+
+    return object;
+}
+
+/** @brief Gives a big object a block of its own, where it starts out old */
+static he_object *allocate_large(he_heap *heap, size_t size) {
+    size_t block_size = offsetof(he_heap_block, objects) + size;
+
+    block_size = (block_size + HE_HEAP_BLOCK_SIZE - 1) & ~(HE_HEAP_BLOCK_SIZE - 1);
+
+    he_heap_block *block = new_block(heap, block_size);
+    uint8_t *object = block_begin(block);
+    uint8_t *end = block_end(block);
+
+    if (object + size != end) { fill(object + size, end - object - size); }
+
+    heap->old_bytes += size;
+
+    if (heap->old_bytes > heap->old_limit) { request_collection(heap, GC_MAJOR); }
+
+    return (he_object *)object;
+}
+
+/** @brief Allocates an object, the caller fills in the payload */
+static he_object *allocate(he_heap *heap, he_object_kind kind, size_t payload_size) {
+    // big enough that rounding it up to whole blocks can't overflow
+    if (payload_size > SIZE_MAX / 2) { out_of_memory("he_heap"); }
+
+    size_t size = align_up(sizeof(he_object) + payload_size);
+    bool large = size > LARGE_OBJECT_SIZE;
+    he_object *object = large ? allocate_large(heap, size) : allocate_small(heap, size);
+
+    object->size = size;
+    object->kind = (uint8_t)kind;
+    object->marked = 0;
+    object->remembered = 0;
+    object->old = large;
+
+    heap->bytes_allocated += size;
+
+    return object;
+}
+
+void he_heap_init(he_heap *heap, size_t nursery_size) {
+    heap->nursery = NULL;
+    heap->free_blocks = NULL;
+    heap->free_count = 0;
+    heap->recyclable = NULL;
+    heap->cursor = NULL;
+    heap->limit = NULL;
+    heap->blocks = NULL;
+    heap->block_count = 0;
+    heap->block_capacity = 0;
+    heap->gray = NULL;
+    heap->gray_count = 0;
+    heap->gray_capacity = 0;
+    heap->remembered = NULL;
+    heap->remembered_count = 0;
+    heap->remembered_capacity = 0;
+    heap->handles = NULL;
+    heap->nursery_size = (nursery_size == 0) ? HE_DEFAULT_NURSERY_SIZE : nursery_size;
+    heap->nursery_bytes = 0;
+    heap->old_limit = HE_HEAP_INITIAL_OLD_LIMIT;
+    heap->old_bytes = 0;
+    heap->pending = false;
+    heap->pending_kind = GC_MINOR;
+    heap->collecting = false;
+    heap->collecting_kind = GC_MINOR;
+    heap->bytes_allocated = 0;
+    heap->bytes_reserved = 0;
+    heap->bytes_live = 0;
+    heap->minor_collections = 0;
+    heap->major_collections = 0;
+
+    he_pool_init(&heap->handle_pool, sizeof(he_handle), HANDLES_PER_BLOCK, NULL);
+}
+
+void he_heap_destroy(he_heap *heap) {
+    for (size_t i = 0; i < heap->block_count; ++i) {
+        free(heap->blocks[i]);
+    }
+
+    he_free_array(heap->blocks);
+    he_free_array(heap->gray);
+    he_free_array(heap->remembered);
+    he_pool_destroy(&heap->handle_pool);
+
+    he_heap_init(heap, heap->nursery_size);
+}
+
+he_value he_heap_string(he_heap *heap, const char *chars, size_t length) {
+    const char *interned = he_intern_find(chars, length);
+
+    if (interned) { return he_val_wrap_string(interned); }
+
+    he_object *object = allocate(heap, OBJECT_STRING, offsetof(he_string, chars) + length + 1);
+    he_string *str = (he_string *)object->payload;
+
+    str->hash = he_string_hash(chars, length);
+    str->length = length;
+    str->interned = false;
+    memcpy(str->chars, chars, length);
+    str->chars[length] = '\0';
+
+    return he_val_wrap_string(str->chars);
+}
+
+he_value he_heap_array(he_heap *heap, size_t length) {
+    if (length > SIZE_MAX / 2 / sizeof(he_value)) { out_of_memory("he_heap_array"); }
+
+    he_object *object = allocate(heap, OBJECT_ARRAY,
+                                 offsetof(he_array, items) + length * sizeof(he_value));
+    he_array *array = (he_array *)object->payload;
+
+    array->length = length;
+
+    for (size_t i = 0; i < length; ++i) {
+        array->items[i] = he_val_from_bool(false);
+    }
+
+    return he_val_from_object(array);
+}
+
+he_value he_heap_data(he_heap *heap, size_t size) {
+    he_object *object = allocate(heap, OBJECT_DATA, size);
+
+    memset(object->payload, 0, size);
+
+    return he_val_from_object(object->payload);
+}
+
+he_object *he_heap_object_of(const he_heap *heap, const he_value *value) {
+    const void *payload;
+
+    if (he_val_is_string(value)) {
+        const he_string *str = he_string_of(he_val_as_string(value));
+
+        if (str->interned) { return NULL; }
+
+        payload = str;
+    } else if (he_val_is_object(value)) {
+        payload = he_val_as_object(value);
+    } else {
+        return NULL;
+    }
+
+    he_heap_block *block = block_of(payload);
+
+    if (!payload || !owns_block(heap, block)) { return NULL; }
+
+    uint8_t *object = (uint8_t *)payload - offsetof(he_object, payload);
+
+    // anything else pointing into a block isn't an object the heap handed out
+    if (object < block_begin(block) || object >= block_end(block)) { return NULL; }
+
+    return (he_object *)object;
+}
+
+void he_heap_array_set(he_heap *heap, he_array *array, size_t index, he_value value) {
+    assert(index < array->length && "array index out of bounds");
+
+    array->items[index] = value;
+
+    he_object *object = (he_object *)((uint8_t *)array - offsetof(he_object, payload));
+
+    if (object->remembered || !object->old) { return; }
+
+    he_object *target = he_heap_object_of(heap, &value);
+
+    // an old array pointing at a new object is a root for minor collections
+    if (target && !target->old) {
+        if (heap->remembered_count == heap->remembered_capacity) {
+            heap->remembered = he_grow_array(heap->remembered, sizeof(he_object *),
+                                             &heap->remembered_capacity);
+        }
+
+        object->remembered = 1;
+        heap->remembered[heap->remembered_count++] = object;
+    }
+}
+
+he_handle *he_heap_handle(he_heap *heap, he_value value) {
+    he_handle *handle = he_pool_alloc(&heap->handle_pool);
+
+    handle->value = value;
+    handle->prev = NULL;
+    handle->next = heap->handles;
+
+    if (heap->handles) { heap->handles->prev = handle; }
+
+    heap->handles = handle;
+
+    return handle;
+}
+
+void he_heap_release(he_heap *heap, he_handle *handle) {
+    if (!handle) { return; }
+
+    if (handle->prev) {
+        handle->prev->next = handle->next;
+    } else {
+        heap->handles = handle->next;
+    }
+
+    if (handle->next) { handle->next->prev = handle->prev; }
+
+    he_pool_free(&heap->handle_pool, handle);
+}
+
+void he_heap_mark_values(he_heap *heap, const he_value *values, size_t count) {
+    assert(heap->collecting && "marking outside of a collection");
+
+    for (size_t i = 0; i < count; ++i) {
+        he_object *object = he_heap_object_of(heap, &values[i]);
+
+        if (!object || object->marked) { continue; }
+
+        // minor collections treat old objects as alive without looking inside them
+        if (heap->collecting_kind == GC_MINOR && object->old) { continue; }
+
+        object->marked = 1;
+
+        if (object->kind == OBJECT_ARRAY) {
+            if (heap->gray_count == heap->gray_capacity) {
+                heap->gray = he_grow_array(heap->gray, sizeof(he_object *), &heap->gray_capacity);
+            }
+
+            heap->gray[heap->gray_count++] = object;
+        }
+    }
+}
+
+/** @brief Marks everything reachable from the gray objects */
+static void trace(he_heap *heap) {
+    while (heap->gray_count > 0) {
+        he_object *object = heap->gray[--heap->gray_count];
+        he_array *array = (he_array *)object->payload;
+
+        he_heap_mark_values(heap, array->items, array->length);
+    }
+}
+
+/**
+ * @brief Frees a block's unmarked objects, merging free space that's next to each other,
+ * and makes the marked ones old. Minor collections leave the old objects alone
+ * @return The bytes of free space left in the block
+ */
+static size_t sweep_block(he_heap *heap, he_heap_block *block, he_gc_kind kind) {
+    he_object *free_run = NULL;
+    size_t free_bytes = 0;
+
+    for (uint8_t *at = block_begin(block), *end = block_end(block); at < end;) {
+        he_object *object = (he_object *)at;
+        size_t size = object->size;
+
+        at += size;
+
+        bool alive = object->marked || (kind == GC_MINOR && object->old);
+
+        if (object->kind != OBJECT_FREE && alive) {
+            // a minor collection only counts the objects that are becoming old
+            if (object->marked && (kind == GC_MAJOR || !object->old)) {
+                heap->old_bytes += size;
+            }
+
+            if (object->marked) { heap->bytes_live += size; }
+
+            object->marked = 0;
+            object->old = 1;
+            free_run = NULL;
+            continue;
+        }
+
+        free_bytes += size;
+
+        if (free_run) {
+            free_run->size += size;
+        } else {
+            fill((uint8_t *)object, size);
+            free_run = object;
+        }
+    }
+
+    return free_bytes;
+}
+
+/** @brief Puts a swept block on the list its free space calls for */
+static void file_block(he_heap *heap, he_heap_block *block, size_t free_bytes) {
+    size_t capacity = block_end(block) - block_begin(block);
+
+    if (free_bytes == capacity) {
+        if (block->size != HE_HEAP_BLOCK_SIZE || heap->free_count * HE_HEAP_BLOCK_SIZE >=
+                                                     heap->nursery_size) {
+            release_block(heap, block);
+            return;
+        }
+
+        block->state = BLOCK_FREE;
+        block->next = heap->free_blocks;
+        heap->free_blocks = block;
+        ++heap->free_count;
+    } else if (block->size == HE_HEAP_BLOCK_SIZE && free_bytes >= capacity / 4) {
+        // a block with less free space than this would mostly be walked past
+        block->state = BLOCK_RECYCLABLE;
+        block->next = heap->recyclable;
+        heap->recyclable = block;
+    } else {
+        block->state = BLOCK_IN_USE;
+        block->next = NULL;
+    }
+}
+
+/** @brief Sweeps the blocks allocated from since the last collection */
+static void sweep_nursery(he_heap *heap) {
+    he_heap_block *block = heap->nursery;
+
+    heap->nursery = NULL;
+
+    while (block) {
+        he_heap_block *next = block->next;
+
+        file_block(heap, block, sweep_block(heap, block, GC_MINOR));
+        block = next;
+    }
+}
+
+/** @brief Sweeps every block that isn't empty, sorting them onto the lists again */
+static void sweep_all(he_heap *heap) {
+    heap->nursery = NULL;
+    heap->recyclable = NULL;
+    heap->old_bytes = 0;
+
+    // walked backwards so blocks can be released without skipping the ones after them
+    for (size_t i = heap->block_count; i-- != 0;) {
+        he_heap_block *block = heap->blocks[i];
+
+        if (block->state != BLOCK_FREE) {
+            file_block(heap, block, sweep_block(heap, block, GC_MAJOR));
+        }
+    }
+}
+
+void he_heap_collect(he_heap *heap, he_gc_kind kind, he_heap_roots_fn roots, void *data) {
+    assert(!heap->collecting && "collections can't be nested");
+
+    // every block has to be walkable, including the free space being allocated from
+    close_free_space(heap);
+
+    heap->collecting = true;
+    heap->collecting_kind = kind;
+
+    for (he_handle *handle = heap->handles; handle; handle = handle->next) {
+        he_heap_mark_values(heap, &handle->value, 1);
+    }
+
+    if (roots) { roots(heap, data); }
+
+    for (size_t i = 0; i < heap->remembered_count; ++i) {
+        he_object *object = heap->remembered[i];
+
+        // a major collection traces the old arrays anyway, if they're alive
+        if (kind == GC_MINOR) {
+            he_array *array = (he_array *)object->payload;
+
+            he_heap_mark_values(heap, array->items, array->length);
+        }
+
+        object->remembered = 0;
+    }
+
+    trace(heap);
+
+    // every new object that survived is old now, so no old object points at a new one
+    heap->remembered_count = 0;
+    heap->bytes_live = 0;
+
+    if (kind == GC_MAJOR) {
+        sweep_all(heap);
+    } else {
+        sweep_nursery(heap);
+    }
+
+    heap->nursery_bytes = 0;
+    heap->collecting = false;
+    heap->pending = false;
+
+    if (kind == GC_MAJOR) {
+        ++heap->major_collections;
+
+        heap->old_limit = (heap->old_bytes * 2 > HE_HEAP_INITIAL_OLD_LIMIT)
+                              ? heap->old_bytes * 2
+                              : HE_HEAP_INITIAL_OLD_LIMIT;
+    } else {
+        ++heap->minor_collections;
+    }
+
+    if (heap->old_bytes > heap->old_limit) { request_collection(heap, GC_MAJOR); }
+}
@@ -0,0 +1,93 @@
+#include "helium/instruction.h"
+
+bool he_opcode_has_operand(he_opcode op) {
+    switch (op) {
+        case OP_CALL:
+        case OP_LOAD_CONST:
+        case OP_LOAD_CONST_ADD:
+        case OP_LOAD_CONST_SUB:
+            return true;
+        default:
+            return he_opcode_is_jump(op);
+    }
+}
+
+bool he_opcode_is_valid(uint8_t byte) {
+    return byte < HE_OPCODE_COUNT;
+}
+
+bool he_opcode_is_jump(he_opcode op) {
+    switch (op) {
+        case OP_JMP:
+        case OP_JZ:
+        case OP_JNZ:
+        case OP_LT_JZ:
+        case OP_LT_JNZ:
+        case OP_GT_JZ:
+        case OP_GT_JNZ:
+            return true;
+        default:
+            return false;
+    }
+}
+
+#define OPCODE_NAME(op) [op] = #op
+
+static const char *const opcode_names[HE_DISPATCH_OPCODE_COUNT] = {
+    OPCODE_NAME(OP_RET),
+    OPCODE_NAME(OP_CALL),
+    OPCODE_NAME(OP_LOAD_CONST),
+    OPCODE_NAME(OP_ADD),
+    OPCODE_NAME(OP_SUB),
+    OPCODE_NAME(OP_MUL),
+    OPCODE_NAME(OP_DIV),
+    OPCODE_NAME(OP_MOD),
+    OPCODE_NAME(OP_GT),
+    OPCODE_NAME(OP_LT),
+    OPCODE_NAME(OP_GTEQ),
+    OPCODE_NAME(OP_LTEQ),
+    OPCODE_NAME(OP_EQ),
+    OPCODE_NAME(OP_NOT),
+    OPCODE_NAME(OP_NEGATE),
+    OPCODE_NAME(OP_JMP),
+    OPCODE_NAME(OP_JZ),
+    OPCODE_NAME(OP_JNZ),
+    OPCODE_NAME(OP_POP),
+    OPCODE_NAME(OP_DUP),
+    OPCODE_NAME(OP_HALT),
+    OPCODE_NAME(OP_LOAD_CONST_ADD),
+    OPCODE_NAME(OP_LOAD_CONST_SUB),
+    OPCODE_NAME(OP_LT_JZ),
+    OPCODE_NAME(OP_LT_JNZ),
+    OPCODE_NAME(OP_GT_JZ),
+    OPCODE_NAME(OP_GT_JNZ),
+    OPCODE_NAME(OP_EQ_NOT),
+    OPCODE_NAME(OP_ADD_INT),
+    OPCODE_NAME(OP_ADD_FLOAT),
+    OPCODE_NAME(OP_SUB_INT),
+    OPCODE_NAME(OP_SUB_FLOAT),
+    OPCODE_NAME(OP_MUL_INT),
+    OPCODE_NAME(OP_MUL_FLOAT),
+    OPCODE_NAME(OP_GT_INT),
+    OPCODE_NAME(OP_GT_FLOAT),
+    OPCODE_NAME(OP_LT_INT),
+    OPCODE_NAME(OP_LT_FLOAT),
+    OPCODE_NAME(OP_GTEQ_INT),
+    OPCODE_NAME(OP_GTEQ_FLOAT),
+    OPCODE_NAME(OP_LTEQ_INT),
+    OPCODE_NAME(OP_LTEQ_FLOAT),
+    OPCODE_NAME(OP_LOAD_CONST_ADD_INT),
+    OPCODE_NAME(OP_LOAD_CONST_SUB_INT),
+    OPCODE_NAME(OP_LT_JZ_INT),
+    OPCODE_NAME(OP_LT_JNZ_INT),
+    OPCODE_NAME(OP_GT_JZ_INT),
+    OPCODE_NAME(OP_GT_JNZ_INT),
+};
+
+#undef OPCODE_NAME
+
+const char *he_opcode_name(he_opcode op) {
+    if (op >= HE_DISPATCH_OPCODE_COUNT) { return "OP_UNKNOWN"; }
+
+    return opcode_names[op];
+}
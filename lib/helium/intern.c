@@ -0,0 +1,146 @@
+#include "helium/intern.h"
+#include "helium/memory.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FNV_OFFSET_BASIS 0xCBF29CE484222325ULL
+#define FNV_PRIME 0x100000001B3ULL
+
+/** @brief The table's capacity the first time anything is interned, always a power of 2 */
+#define INITIAL_CAPACITY 64
+
+/** @brief Open addressed set of interned strings, NULL slots are empty */
+static struct {
+    pthread_mutex_t lock;
+    he_string **slots;
+    size_t capacity;
+    size_t count;
+} table = {PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0};
+
+uint64_t he_string_hash(const char *chars, size_t length) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (uint8_t)chars[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+/** @brief Finds where a string with these characters is, or where it would go */
+static he_string **find_slot(he_string **slots, size_t capacity, const char *chars,
+                             size_t length, uint64_t hash) {
+    size_t mask = capacity - 1;
+
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        he_string *str = slots[i];
+
+        if (!str) { return &slots[i]; }
+
+        if (str->hash == hash && str->length == length && memcmp(str->chars, chars, length) == 0) {
+            return &slots[i];
+        }
+    }
+}
+
+/** @brief Doubles the table's capacity, or allocates it if it's empty */
+static void grow(void) {
+    size_t capacity = (table.capacity == 0) ? INITIAL_CAPACITY : table.capacity * 2;
+    he_string **slots = he_alloc(sizeof(he_string *), capacity);
+
+    memset(slots, 0, capacity * sizeof(he_string *));
+
+    for (size_t i = 0; i < table.capacity; ++i) {
+        he_string *str = table.slots[i];
+
+        if (str) { *find_slot(slots, capacity, str->chars, str->length, str->hash) = str; }
+    }
+
+    he_free_array(table.slots);
+
+    table.slots = slots;
+    table.capacity = capacity;
+}
+
+const char *he_intern(const char *chars, size_t length) {
+    uint64_t hash = he_string_hash(chars, length);
+
+    pthread_mutex_lock(&table.lock);
+
+    // kept under 3/4 full so probes stay short and always find an empty slot
+    if ((table.count + 1) * 4 > table.capacity * 3) { grow(); }
+
+    he_string **slot = find_slot(table.slots, table.capacity, chars, length, hash);
+
+    if (!*slot) {
+        he_string *str = malloc(sizeof(he_string) + length + 1);
+
+        he_memory_count(sizeof(he_string) + length + 1);
+
+        if (!str) {
+            fprintf(stderr, "he_intern: unable to allocate memory!\n");
+            exit(-1);
+        }
+
+        str->hash = hash;
+        str->length = length;
+        str->interned = true;
+        memcpy(str->chars, chars, length);
+        str->chars[length] = '\0';
+
+        *slot = str;
+        ++table.count;
+    }
+
+    const char *interned = (*slot)->chars;
+
+    pthread_mutex_unlock(&table.lock);
+
+    return interned;
+}
+
+const char *he_intern_find(const char *chars, size_t length) {
+    uint64_t hash = he_string_hash(chars, length);
+    const char *interned = NULL;
+
+    pthread_mutex_lock(&table.lock);
+
+    if (table.capacity != 0) {
+        he_string *str = *find_slot(table.slots, table.capacity, chars, length, hash);
+
+        if (str) { interned = str->chars; }
+    }
+
+    pthread_mutex_unlock(&table.lock);
+
+    return interned;
+}
+
+size_t he_intern_count(void) {
+    pthread_mutex_lock(&table.lock);
+
+    size_t count = table.count;
+
+    pthread_mutex_unlock(&table.lock);
+
+    return count;
+}
+
+void he_intern_clear(void) {
+    pthread_mutex_lock(&table.lock);
+
+    for (size_t i = 0; i < table.capacity; ++i) {
+        free(table.slots[i]);
+    }
+
+    he_free_array(table.slots);
+
+    table.slots = NULL;
+    table.capacity = 0;
+    table.count = 0;
+
+    pthread_mutex_unlock(&table.lock);
+}
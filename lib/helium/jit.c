@@ -0,0 +1,763 @@
+#include "helium/jit.h"
+#include "helium/code.h"
+#include "helium/instruction.h"
+#include "helium/memory.h"
+#include "helium/value.h"
+#include "helium/vm.h"
+#include "jit_runtime.h"
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(HE_JIT) && defined(__x86_64__) && defined(__linux__)
+#define HE_JIT_X86_64 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define HE_JIT_X86_64 0
+#endif
+
+bool he_jit_supported(void) {
+    return HE_JIT_X86_64;
+}
+
+#if HE_JIT_X86_64
+
+bool he_jit_buffer_init(he_jit_buffer *buffer, size_t capacity) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t size = (capacity + page - 1) / page * page;
+
+    buffer->memory = NULL;
+    buffer->size = 0;
+    buffer->capacity = 0;
+    buffer->executable = false;
+
+    // mapped writable only, he_jit_buffer_seal swaps that for executable
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (memory == MAP_FAILED) { return false; }
+
+    buffer->memory = memory;
+    buffer->capacity = size;
+
+    return true;
+}
+
+bool he_jit_buffer_seal(he_jit_buffer *buffer) {
+    if (mprotect(buffer->memory, buffer->capacity, PROT_READ | PROT_EXEC) != 0) { return false; }
+
+    buffer->executable = true;
+
+    return true;
+}
+
+void he_jit_buffer_destroy(he_jit_buffer *buffer) {
+    if (buffer->memory) { munmap(buffer->memory, buffer->capacity); }
+
+    buffer->memory = NULL;
+    buffer->size = 0;
+    buffer->capacity = 0;
+    buffer->executable = false;
+}
+
+#else
+
+bool he_jit_buffer_init(he_jit_buffer *buffer, size_t capacity) {
+    (void)capacity;
+
+    buffer->memory = NULL;
+    buffer->size = 0;
+    buffer->capacity = 0;
+    buffer->executable = false;
+
+    return false;
+}
+
+bool he_jit_buffer_seal(he_jit_buffer *buffer) {
+    (void)buffer;
+
+    return false;
+}
+
+void he_jit_buffer_destroy(he_jit_buffer *buffer) {
+    buffer->memory = NULL;
+    buffer->size = 0;
+    buffer->capacity = 0;
+    buffer->executable = false;
+}
+
+#endif
+
+void he_jit_code_init(he_jit_code *jit) {
+    jit->buffer.memory = NULL;
+    jit->buffer.size = 0;
+    jit->buffer.capacity = 0;
+    jit->buffer.executable = false;
+    jit->entries = NULL;
+    jit->code = NULL;
+    jit->error = NULL;
+}
+
+void he_jit_code_destroy(he_jit_code *jit) {
+    he_jit_buffer_destroy(&jit->buffer);
+    he_free_array(jit->entries);
+
+    jit->entries = NULL;
+    jit->code = NULL;
+    jit->error = NULL;
+}
+
+#if HE_JIT_X86_64
+
+/** @brief The most bytes any instruction's template can take up */
+#define MAX_OP_BYTES 256
+
+/** @brief The bytes the prologue and epilogue take up, rounded up */
+#define FRAME_BYTES 128
+
+typedef enum reg {
+    RAX = 0,
+    RCX = 1,
+    RDX = 2,
+    RBX = 3,
+    RSP = 4,
+    RBP = 5,
+    RSI = 6,
+    RDI = 7,
+    R12 = 12,
+    R13 = 13,
+    R14 = 14,
+    R15 = 15,
+} reg;
+
+// what compiled code keeps in callee-saved registers between instructions
+#define SP RBX
+#define FRAME R12
+#define RSP_REG R13
+#define LIMIT R14
+#define VM R15
+#define ENTRIES RBP
+
+typedef enum cond {
+    CC_O = 0x0,
+    CC_E = 0x4,
+    CC_NE = 0x5,
+    CC_L = 0xc,
+    CC_GE = 0xd,
+    CC_LE = 0xe,
+    CC_G = 0xf,
+} cond;
+
+/** @brief A jump to an instruction that hasn't been emitted yet */
+typedef struct fixup {
+    /** @brief Where the jump's rel32 is */
+    size_t at;
+
+    /** @brief The instruction it jumps to */
+    size_t target;
+} fixup;
+
+typedef struct emitter {
+    uint8_t *out;
+    size_t size;
+
+    /** @brief Where each instruction's template starts, `code->size + 1` long */
+    size_t *starts;
+
+    fixup *fixups;
+    size_t fixup_count;
+    size_t fixup_capacity;
+
+    /** @brief Where the epilogue starts */
+    size_t epilogue;
+
+    /** @brief The index of the instruction being emitted */
+    size_t index;
+} emitter;
+
+#define VALUE_SIZE ((int32_t)sizeof(he_value))
+
+#ifndef HE_NAN_BOXING
+#define TAG_OFFSET ((int32_t)offsetof(he_value, type))
+#define PAYLOAD_OFFSET ((int32_t)offsetof(he_value, as))
+#endif
+
+static void emit_byte(emitter *e, uint8_t byte) {
+    e->out[e->size++] = byte;
+}
+
+static void emit_u32(emitter *e, uint32_t word) {
+    memcpy(e->out + e->size, &word, sizeof(word));
+    e->size += sizeof(word);
+}
+
+static void emit_u64(emitter *e, uint64_t word) {
+    memcpy(e->out + e->size, &word, sizeof(word));
+    e->size += sizeof(word);
+}
+
+static void emit_rex(emitter *e, bool wide, int reg_field, int base) {
+    uint8_t rex = 0x40 | (wide ? 0x08 : 0) | ((reg_field & 8) ? 0x04 : 0) | ((base & 8) ? 1 : 0);
+
+    if (rex != 0x40) { emit_byte(e, rex); }
+}
+
+/**
+ * @brief Emits an instruction with a [base + disp32] operand
+ * @param opcode One or two opcode bytes, the first in the low byte
+ * @param reg_field The register operand or opcode extension
+ */
+static void emit_mem(emitter *e, bool wide, uint16_t opcode, int reg_field, int base,
+                     int32_t disp) {
+    emit_rex(e, wide, reg_field, base);
+    emit_byte(e, opcode & 0xff);
+    if (opcode >> 8) { emit_byte(e, opcode >> 8); }
+
+    emit_byte(e, 0x80 | (reg_field & 7) << 3 | (base & 7));
+    if ((base & 7) == RSP) { emit_byte(e, 0x24); }
+    emit_u32(e, (uint32_t)disp);
+}
+
+/** @brief Emits an instruction with two register operands */
+static void emit_regs(emitter *e, bool wide, uint16_t opcode, int reg_field, int rm) {
+    emit_rex(e, wide, reg_field, rm);
+    emit_byte(e, opcode & 0xff);
+    if (opcode >> 8) { emit_byte(e, opcode >> 8); }
+
+    emit_byte(e, 0xc0 | (reg_field & 7) << 3 | (rm & 7));
+}
+
+// mov dst, [base + disp]
+static void emit_load(emitter *e, int dst, int base, int32_t disp) {
+    emit_mem(e, true, 0x8b, dst, base, disp);
+}
+
+// mov [base + disp], src
+static void emit_store(emitter *e, int base, int32_t disp, int src) {
+    emit_mem(e, true, 0x89, src, base, disp);
+}
+
+// mov dst, src
+static void emit_move(emitter *e, int dst, int src) {
+    emit_regs(e, true, 0x89, src, dst);
+}
+
+// mov dst, imm64
+static void emit_move_imm(emitter *e, int dst, uint64_t imm) {
+    emit_rex(e, true, 0, dst);
+    emit_byte(e, 0xb8 | (dst & 7));
+    emit_u64(e, imm);
+}
+
+// add dst, imm32 or sub dst, imm32
+static void emit_add_imm(emitter *e, int dst, int32_t imm) {
+    emit_regs(e, true, 0x81, imm < 0 ? 5 : 0, dst);
+    emit_u32(e, (uint32_t)(imm < 0 ? -imm : imm));
+}
+
+/**
+ * @brief Emits a call to a runtime function
+ *
+ * Every runtime function can fail, so the stack pointers and the instruction's index are
+ * stored in the VM first, leaving it where the instruction failed if one does.
+ */
+static void emit_call(emitter *e, const void *function) {
+    emit_store(e, VM, offsetof(he_vm, stack.sp), SP);
+    emit_store(e, VM, offsetof(he_vm, ret_addrs.sp), RSP_REG);
+    emit_move_imm(e, RAX, e->index);
+    emit_store(e, VM, offsetof(he_vm, pc), RAX);
+
+    emit_move_imm(e, RAX, (uint64_t)(uintptr_t)function);
+    emit_byte(e, 0xff);
+    emit_byte(e, 0xd0);
+}
+
+// calls a runtime function taking the VM and the stack pointer
+static void emit_call_runtime(emitter *e, const void *function) {
+    emit_move(e, RDI, VM);
+    emit_move(e, RSI, SP);
+    emit_call(e, function);
+}
+
+/** @brief Emits a jump past code that isn't emitted yet, returning where to patch it */
+static size_t emit_jcc_forward(emitter *e, cond cc) {
+    emit_byte(e, 0x0f);
+    emit_byte(e, 0x80 | cc);
+    emit_u32(e, 0);
+
+    return e->size - 4;
+}
+
+static size_t emit_jmp_forward(emitter *e) {
+    emit_byte(e, 0xe9);
+    emit_u32(e, 0);
+
+    return e->size - 4;
+}
+
+/** @brief Points a forward jump at the current position */
+static void patch_here(emitter *e, size_t at) {
+    uint32_t rel = (uint32_t)(e->size - (at + 4));
+
+    memcpy(e->out + at, &rel, sizeof(rel));
+}
+
+static void add_fixup(emitter *e, size_t at, size_t target) {
+    if (e->fixup_count == e->fixup_capacity) {
+        e->fixups = he_grow_array(e->fixups, sizeof(fixup), &e->fixup_capacity);
+    }
+
+    e->fixups[e->fixup_count++] = (fixup){at, target};
+}
+
+/** @brief Emits a jump to an instruction, @p cc is -1 for an unconditional one */
+static void emit_jump_to(emitter *e, int cc, size_t target) {
+    add_fixup(e, cc < 0 ? emit_jmp_forward(e) : emit_jcc_forward(e, (cond)cc), target);
+}
+
+/**
+ * @brief Loads everything the templates keep in registers from the frame and jumps to
+ * the instruction it asks for, then emits the epilogue OP_HALT jumps back to
+ */
+static void emit_frame(emitter *e) {
+    static const int saved[] = {RBX, RBP, R12, R13, R14, R15};
+
+    for (size_t i = 0; i < sizeof(saved) / sizeof(saved[0]); ++i) {
+        emit_rex(e, false, 0, saved[i]);
+        emit_byte(e, 0x50 | (saved[i] & 7));
+    }
+
+    // six pushes and the return address leave the stack 8 bytes off the alignment calls need
+    emit_add_imm(e, RSP, -8);
+
+    emit_move(e, FRAME, RDI);
+    emit_load(e, VM, FRAME, offsetof(he_jit_frame, vm));
+    emit_load(e, SP, FRAME, offsetof(he_jit_frame, sp));
+    emit_load(e, RSP_REG, FRAME, offsetof(he_jit_frame, rsp));
+    emit_load(e, ENTRIES, FRAME, offsetof(he_jit_frame, entries));
+    emit_load(e, LIMIT, VM, offsetof(he_vm, stack.limit));
+    emit_mem(e, false, 0xff, 4, FRAME, offsetof(he_jit_frame, target));
+
+    e->epilogue = e->size;
+    emit_store(e, FRAME, offsetof(he_jit_frame, sp), SP);
+    emit_store(e, FRAME, offsetof(he_jit_frame, rsp), RSP_REG);
+    emit_add_imm(e, RSP, 8);
+
+    for (size_t i = sizeof(saved) / sizeof(saved[0]); i-- > 0;) {
+        emit_rex(e, false, 0, saved[i]);
+        emit_byte(e, 0x58 | (saved[i] & 7));
+    }
+
+    emit_byte(e, 0xc3);
+}
+
+/** @brief Makes room for one more value on the data stack */
+static void emit_reserve(emitter *e) {
+    // cmp rbx, r14
+    emit_regs(e, true, 0x39, LIMIT, SP);
+    size_t fits = emit_jcc_forward(e, CC_NE);
+
+    emit_call_runtime(e, (const void *)he_jit_rt_reserve);
+    emit_move(e, SP, RAX);
+    emit_load(e, LIMIT, VM, offsetof(he_vm, stack.limit));
+
+    patch_here(e, fits);
+}
+
+/** @brief How a binary instruction is done inline when both operands are integers */
+typedef enum inline_kind {
+    INLINE_NONE,
+    INLINE_ADD,
+    INLINE_SUB,
+    INLINE_MUL,
+    INLINE_COMPARE,
+} inline_kind;
+
+#ifndef HE_NAN_BOXING
+// cmp dword [base + disp], imm32, only the tagged layout has a tag to check inline
+static void emit_cmp_tag(emitter *e, int base, int32_t disp, uint32_t tag) {
+    emit_mem(e, false, 0x81, 7, base, disp);
+    emit_u32(e, tag);
+}
+#endif
+
+/**
+ * @brief Emits a binary instruction. Integers are handled inline in the tagged layout,
+ * anything else (and any overflow) goes through the runtime function
+ */
+static void emit_binary(emitter *e, const void *function, inline_kind kind, cond cc) {
+#ifndef HE_NAN_BOXING
+    const int32_t lhs = -2 * VALUE_SIZE;
+    const int32_t rhs = -VALUE_SIZE;
+    const int32_t tag = TAG_OFFSET;
+    const int32_t payload = PAYLOAD_OFFSET;
+    size_t slow[3];
+    size_t slow_count = 0;
+    size_t done = 0;
+
+    if (kind != INLINE_NONE) {
+        emit_cmp_tag(e, SP, lhs + tag, TYPE_INT);
+        slow[slow_count++] = emit_jcc_forward(e, CC_NE);
+        emit_cmp_tag(e, SP, rhs + tag, TYPE_INT);
+        slow[slow_count++] = emit_jcc_forward(e, CC_NE);
+        emit_load(e, RAX, SP, lhs + payload);
+
+        if (kind == INLINE_COMPARE) {
+            // xor ecx, ecx, then cmp rax, [rhs] and setcc cl
+            emit_regs(e, false, 0x31, RCX, RCX);
+            emit_mem(e, true, 0x3b, RAX, SP, rhs + payload);
+            emit_byte(e, 0x0f);
+            emit_byte(e, 0x90 | cc);
+            emit_byte(e, 0xc1);
+            emit_mem(e, false, 0xc7, 0, SP, lhs + tag);
+            emit_u32(e, TYPE_BOOL);
+            emit_store(e, SP, lhs + payload, RCX);
+        } else {
+            static const uint16_t opcodes[] = {
+                [INLINE_ADD] = 0x03,
+                [INLINE_SUB] = 0x2b,
+                [INLINE_MUL] = 0xaf0f,
+            };
+
+            // overflowing results are promoted to floats by the runtime function
+            emit_mem(e, true, opcodes[kind], RAX, SP, rhs + payload);
+            slow[slow_count++] = emit_jcc_forward(e, CC_O);
+            emit_store(e, SP, lhs + payload, RAX);
+        }
+
+        done = emit_jmp_forward(e);
+
+        for (size_t i = 0; i < slow_count; ++i) { patch_here(e, slow[i]); }
+    }
+#else
+    (void)kind;
+    (void)cc;
+#endif
+
+    emit_call_runtime(e, function);
+
+#ifndef HE_NAN_BOXING
+    if (kind != INLINE_NONE) { patch_here(e, done); }
+#endif
+
+    emit_add_imm(e, SP, -VALUE_SIZE);
+}
+
+/** @brief Emits OP_LOAD_CONST_ADD or OP_LOAD_CONST_SUB */
+static void emit_binary_const(emitter *e, const void *function, const he_value *constant,
+                              bool subtract) {
+#ifndef HE_NAN_BOXING
+    const int32_t top = -VALUE_SIZE;
+    size_t slow[2];
+    size_t done = 0;
+    bool inline_int = he_val_is_int(constant);
+
+    if (inline_int) {
+        emit_cmp_tag(e, SP, top + TAG_OFFSET, TYPE_INT);
+        slow[0] = emit_jcc_forward(e, CC_NE);
+        emit_load(e, RAX, SP, top + PAYLOAD_OFFSET);
+        emit_move_imm(e, RCX, (uint64_t)he_val_as_int(constant));
+        // add rax, rcx or sub rax, rcx
+        emit_regs(e, true, subtract ? 0x29 : 0x01, RCX, RAX);
+        slow[1] = emit_jcc_forward(e, CC_O);
+        emit_store(e, SP, top + PAYLOAD_OFFSET, RAX);
+        done = emit_jmp_forward(e);
+
+        patch_here(e, slow[0]);
+        patch_here(e, slow[1]);
+    }
+#else
+    (void)subtract;
+#endif
+
+    emit_move(e, RDI, VM);
+    emit_move(e, RSI, SP);
+    emit_move_imm(e, RDX, (uint64_t)(uintptr_t)constant);
+    emit_call(e, function);
+
+#ifndef HE_NAN_BOXING
+    if (inline_int) { patch_here(e, done); }
+#endif
+}
+
+/**
+ * @brief Jumps to @p target if the value on top of the stack is @p when, leaving it there
+ *
+ * Non-bools go through the runtime function, which raises the interpreter's error.
+ */
+static void emit_branch(emitter *e, bool when, size_t target) {
+#ifndef HE_NAN_BOXING
+    emit_cmp_tag(e, SP, -VALUE_SIZE + TAG_OFFSET, TYPE_BOOL);
+    size_t slow = emit_jcc_forward(e, CC_NE);
+
+    // cmp byte [rbx + payload], 0
+    emit_mem(e, false, 0x80, 7, SP, -VALUE_SIZE + PAYLOAD_OFFSET);
+    emit_byte(e, 0);
+    size_t done = emit_jmp_forward(e);
+
+    patch_here(e, slow);
+#endif
+
+    emit_call_runtime(e, (const void *)he_jit_rt_truth);
+    // test al, al
+    emit_byte(e, 0x84);
+    emit_byte(e, 0xc0);
+
+#ifndef HE_NAN_BOXING
+    patch_here(e, done);
+#endif
+
+    emit_jump_to(e, when ? CC_NE : CC_E, target);
+}
+
+/** @brief Stores a constant in the free slot above the stack and pushes it */
+static void emit_push_constant(emitter *e, const he_value *value) {
+    uint64_t words[sizeof(he_value) / sizeof(uint64_t)];
+
+    memcpy(words, value, sizeof(words));
+    emit_reserve(e);
+
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); ++i) {
+        emit_move_imm(e, RAX, words[i]);
+        emit_store(e, SP, (int32_t)(i * sizeof(uint64_t)), RAX);
+    }
+
+    emit_add_imm(e, SP, VALUE_SIZE);
+}
+
+static void emit_dup(emitter *e) {
+    emit_reserve(e);
+
+    for (int32_t i = 0; i < VALUE_SIZE; i += 8) {
+        emit_load(e, RAX, SP, i - VALUE_SIZE);
+        emit_store(e, SP, i, RAX);
+    }
+
+    emit_add_imm(e, SP, VALUE_SIZE);
+}
+
+static void emit_call_op(emitter *e, const he_op_call *call) {
+    // cmp r13, [r15 + ret_addrs.limit]
+    emit_mem(e, true, 0x3b, RSP_REG, VM, offsetof(he_vm, ret_addrs.limit));
+    size_t fits = emit_jcc_forward(e, CC_NE);
+
+    emit_move(e, RDI, VM);
+    emit_move(e, RSI, RSP_REG);
+    emit_call(e, (const void *)he_jit_rt_reserve_return);
+    emit_move(e, RSP_REG, RAX);
+
+    patch_here(e, fits);
+
+    emit_move_imm(e, RAX, call->return_address);
+    emit_store(e, RSP_REG, 0, RAX);
+    emit_add_imm(e, RSP_REG, sizeof(size_t));
+    emit_jump_to(e, -1, call->address);
+}
+
+static void emit_ret(emitter *e) {
+    // cmp r13, [r15 + ret_addrs.base]
+    emit_mem(e, true, 0x3b, RSP_REG, VM, offsetof(he_vm, ret_addrs.base));
+    size_t fits = emit_jcc_forward(e, CC_NE);
+
+    emit_move(e, RDI, VM);
+    emit_call(e, (const void *)he_jit_rt_return_underflow);
+
+    patch_here(e, fits);
+
+    emit_add_imm(e, RSP_REG, -(int32_t)sizeof(size_t));
+    emit_load(e, RAX, RSP_REG, 0);
+    // jmp [rbp + rax * 8]
+    emit_byte(e, 0xff);
+    emit_byte(e, 0x64);
+    emit_byte(e, 0xc5);
+    emit_byte(e, 0x00);
+}
+
+static void emit_halt(emitter *e, size_t index) {
+    emit_move_imm(e, RAX, index);
+    emit_store(e, FRAME, offsetof(he_jit_frame, exit), RAX);
+
+    emit_byte(e, 0xe9);
+    emit_u32(e, (uint32_t)(e->epilogue - (e->size + 4)));
+}
+
+/** @brief Emits one instruction's template, false if there isn't one for it */
+static bool emit_op(emitter *e, const he_op *op, size_t index) {
+    switch (op->op) {
+        case OP_RET:
+            emit_ret(e);
+            break;
+        case OP_CALL:
+            emit_call_op(e, &op->op_object.call);
+            break;
+        case OP_LOAD_CONST:
+            emit_push_constant(e, &op->op_object.push.val);
+            break;
+        case OP_ADD:
+            emit_binary(e, (const void *)he_jit_rt_add, INLINE_ADD, 0);
+            break;
+        case OP_SUB:
+            emit_binary(e, (const void *)he_jit_rt_sub, INLINE_SUB, 0);
+            break;
+        case OP_MUL:
+            emit_binary(e, (const void *)he_jit_rt_mul, INLINE_MUL, 0);
+            break;
+        case OP_DIV:
+            emit_binary(e, (const void *)he_jit_rt_div, INLINE_NONE, 0);
+            break;
+        case OP_MOD:
+            emit_binary(e, (const void *)he_jit_rt_mod, INLINE_NONE, 0);
+            break;
+        case OP_GT:
+            emit_binary(e, (const void *)he_jit_rt_gt, INLINE_COMPARE, CC_G);
+            break;
+        case OP_LT:
+            emit_binary(e, (const void *)he_jit_rt_lt, INLINE_COMPARE, CC_L);
+            break;
+        case OP_GTEQ:
+            emit_binary(e, (const void *)he_jit_rt_gteq, INLINE_COMPARE, CC_GE);
+            break;
+        case OP_LTEQ:
+            emit_binary(e, (const void *)he_jit_rt_lteq, INLINE_COMPARE, CC_LE);
+            break;
+        case OP_EQ:
+            emit_binary(e, (const void *)he_jit_rt_eq, INLINE_NONE, 0);
+            break;
+        case OP_NOT:
+            emit_call_runtime(e, (const void *)he_jit_rt_not);
+            break;
+        case OP_NEGATE:
+            emit_call_runtime(e, (const void *)he_jit_rt_negate);
+            break;
+        case OP_JMP:
+            emit_jump_to(e, -1, op->op_object.jmp.address);
+            break;
+        case OP_JZ:
+            emit_branch(e, true, op->op_object.jmp.address);
+            break;
+        case OP_JNZ:
+            emit_branch(e, false, op->op_object.jmp.address);
+            break;
+        case OP_POP:
+            emit_add_imm(e, SP, -VALUE_SIZE);
+            break;
+        case OP_DUP:
+            emit_dup(e);
+            break;
+        case OP_HALT:
+            emit_halt(e, index);
+            break;
+        case OP_LOAD_CONST_ADD:
+            emit_binary_const(e, (const void *)he_jit_rt_add_const, &op->op_object.push.val,
+                              false);
+            break;
+        case OP_LOAD_CONST_SUB:
+            emit_binary_const(e, (const void *)he_jit_rt_sub_const, &op->op_object.push.val,
+                              true);
+            break;
+        case OP_LT_JZ:
+        case OP_LT_JNZ:
+            emit_binary(e, (const void *)he_jit_rt_lt, INLINE_COMPARE, CC_L);
+            emit_branch(e, op->op == OP_LT_JZ, op->op_object.jmp.address);
+            break;
+        case OP_GT_JZ:
+        case OP_GT_JNZ:
+            emit_binary(e, (const void *)he_jit_rt_gt, INLINE_COMPARE, CC_G);
+            emit_branch(e, op->op == OP_GT_JZ, op->op_object.jmp.address);
+            break;
+        case OP_EQ_NOT:
+            emit_binary(e, (const void *)he_jit_rt_eq, INLINE_NONE, 0);
+            emit_call_runtime(e, (const void *)he_jit_rt_not);
+            break;
+        default:
+            return false;
+    }
+
+    return true;
+}
+
+bool he_jit_compile(he_jit_code *jit, const he_code *code) {
+    he_jit_code_destroy(jit);
+    jit->code = code;
+
+    if (!code->ops) {
+        jit->error = "he_jit_compile: code hasn't been decoded";
+        return false;
+    }
+
+    size_t count = code->size + 1;
+
+    if (!he_jit_buffer_init(&jit->buffer, FRAME_BYTES + count * MAX_OP_BYTES)) {
+        jit->error = "he_jit_compile: unable to map memory for machine code";
+        return false;
+    }
+
+    emitter e = {jit->buffer.memory, 0, he_alloc(sizeof(size_t), count), NULL, 0, 0, 0, 0};
+
+    emit_frame(&e);
+
+    for (size_t i = 0; i < count; ++i) {
+        e.starts[i] = e.size;
+        e.index = i;
+
+        if (!emit_op(&e, &code->ops[i], i)) {
+            jit->error = "he_jit_compile: instruction has no machine code template";
+            break;
+        }
+
+        assert(e.size - e.starts[i] <= MAX_OP_BYTES && "instruction template is too big");
+    }
+
+    if (!jit->error) {
+        for (size_t i = 0; i < e.fixup_count; ++i) {
+            const fixup *f = &e.fixups[i];
+            uint32_t rel = (uint32_t)(e.starts[f->target] - (f->at + 4));
+
+            memcpy(e.out + f->at, &rel, sizeof(rel));
+        }
+
+        jit->buffer.size = e.size;
+
+        if (!he_jit_buffer_seal(&jit->buffer)) {
+            jit->error = "he_jit_compile: unable to make machine code executable";
+        }
+    }
+
+    if (!jit->error) {
+        jit->entries = he_alloc(sizeof(void *), count);
+
+        for (size_t i = 0; i < count; ++i) { jit->entries[i] = jit->buffer.memory + e.starts[i]; }
+    } else {
+        he_jit_buffer_destroy(&jit->buffer);
+    }
+
+    he_free_array(e.starts);
+    he_free_array(e.fixups);
+
+    return jit->error == NULL;
+}
+
+void he_jit_enter(const he_jit_code *jit, he_jit_frame *frame) {
+    void (*enter)(he_jit_frame *) = (void (*)(he_jit_frame *))(uintptr_t)jit->buffer.memory;
+
+    enter(frame);
+}
+
+#else
+
+bool he_jit_compile(he_jit_code *jit, const he_code *code) {
+    he_jit_code_destroy(jit);
+    jit->code = code;
+    jit->error = "he_jit_compile: the JIT isn't supported on this platform";
+
+    return false;
+}
+
+void he_jit_enter(const he_jit_code *jit, he_jit_frame *frame) {
+    (void)jit;
+    (void)frame;
+
+    assert(false && "entered machine code on a platform without a JIT");
+}
+
+#endif
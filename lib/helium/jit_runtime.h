@@ -0,0 +1,73 @@
+/*
+ * What code compiled by jit.c calls back into, implemented by vm.c next to the
+ * interpreters so both raise the same errors the same way. Nothing outside the library
+ * uses this.
+ */
+#ifndef HE_JIT_RUNTIME_H
+#define HE_JIT_RUNTIME_H
+
+#include "helium/vm.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/** @brief The state compiled code is entered with and hands back when it reaches an OP_HALT */
+typedef struct he_jit_frame {
+    /** @brief The VM being run */
+    he_vm *vm;
+
+    /** @brief The data stack pointer */
+    he_value *sp;
+
+    /** @brief The return stack pointer, holding instruction indices */
+    size_t *rsp;
+
+    /** @brief Where each instruction's machine code starts */
+    const void *const *entries;
+
+    /** @brief The machine code to start at */
+    const void *target;
+
+    /** @brief The index of the OP_HALT execution stopped at */
+    size_t exit;
+} he_jit_frame;
+
+/**
+ * @brief Runs compiled code until it reaches an OP_HALT
+ * @param jit The compiled code
+ * @param frame Where to start, updated with where it stopped
+ */
+void he_jit_enter(const he_jit_code *jit, he_jit_frame *frame);
+
+// binary instructions on the two values below @p sp, leaving the result below the other
+void he_jit_rt_add(he_vm *vm, he_value *sp);
+void he_jit_rt_sub(he_vm *vm, he_value *sp);
+void he_jit_rt_mul(he_vm *vm, he_value *sp);
+void he_jit_rt_div(he_vm *vm, he_value *sp);
+void he_jit_rt_mod(he_vm *vm, he_value *sp);
+void he_jit_rt_gt(he_vm *vm, he_value *sp);
+void he_jit_rt_lt(he_vm *vm, he_value *sp);
+void he_jit_rt_gteq(he_vm *vm, he_value *sp);
+void he_jit_rt_lteq(he_vm *vm, he_value *sp);
+void he_jit_rt_eq(he_vm *vm, he_value *sp);
+
+// unary instructions on the value below @p sp
+void he_jit_rt_not(he_vm *vm, he_value *sp);
+void he_jit_rt_negate(he_vm *vm, he_value *sp);
+
+// OP_LOAD_CONST_ADD and OP_LOAD_CONST_SUB on the value below @p sp
+void he_jit_rt_add_const(he_vm *vm, he_value *sp, const he_value *constant);
+void he_jit_rt_sub_const(he_vm *vm, he_value *sp, const he_value *constant);
+
+/** @brief Reads the value below @p sp as a jump condition */
+bool he_jit_rt_truth(he_vm *vm, he_value *sp);
+
+/** @brief Grows the data stack so a value fits at @p sp, returning where @p sp moved to */
+he_value *he_jit_rt_reserve(he_vm *vm, he_value *sp);
+
+/** @brief Grows the return stack so an address fits at @p rsp, returning where it moved to */
+size_t *he_jit_rt_reserve_return(he_vm *vm, size_t *rsp);
+
+/** @brief Fails because of an OP_RET with nothing on the return stack */
+_Noreturn void he_jit_rt_return_underflow(he_vm *vm);
+
+#endif
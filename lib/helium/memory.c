@@ -1,7 +1,10 @@
 #include "helium/memory.h"
 #include <assert.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 static size_t expand_capacity(size_t current) {
     if (current == 0) { return 8; }
@@ -9,14 +12,35 @@ static size_t expand_capacity(size_t current) {
     return current * 2;
 }
 
+// relaxed is enough, nothing is ordered by these and they're only ever added to
+static atomic_size_t allocation_count;
+static atomic_size_t allocated_bytes;
+
+he_memory_stats he_memory_stats_get(void) {
+    he_memory_stats stats;
+
+    stats.allocations = atomic_load_explicit(&allocation_count, memory_order_relaxed);
+    stats.bytes = atomic_load_explicit(&allocated_bytes, memory_order_relaxed);
+
+    return stats;
+}
+
+void he_memory_count(size_t bytes) {
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&allocated_bytes, bytes, memory_order_relaxed);
+}
+
 void *he_alloc(size_t sizeof_type, size_t length) {
     assert(length != 0 && "attempting to allocate array of 0 length");
 
+    he_memory_count(sizeof_type * length);
+
     return malloc(sizeof_type * length);
 }
 
 void *he_grow_array(void *array_ptr, size_t type_size, size_t *current_length) {
     *current_length = expand_capacity(*current_length);
+    he_memory_count(type_size * (*current_length));
 
     void *ptr = realloc(array_ptr, type_size * (*current_length));
 
@@ -28,8 +52,269 @@ void *he_grow_array(void *array_ptr, size_t type_size, size_t *current_length) {
     return ptr;
 }
 
+void *he_resize_array(void *array_ptr, size_t type_size, size_t length) {
+    assert(length != 0 && "attempting to resize array to 0 length");
+
+    he_memory_count(type_size * length);
+
+    void *ptr = realloc(array_ptr, type_size * length);
+
+    if (!ptr) {
+        fprintf(stderr, "he_resize_array: unable to allocate memory!\n");
+        exit(-1);
+    }
+
+    return ptr;
+}
+
 void he_free_array(void *array) {
     // logic?
 
     free(array);
 }
+
+/** @brief Every allocation is aligned to this, it's enough for any type */
+#define ALIGNMENT (_Alignof(max_align_t))
+
+static size_t align_up(size_t size) {
+    return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+struct he_arena_block {
+    /** @brief The block that was being allocated from before this one */
+    he_arena_block *next;
+
+    /** @brief The bytes in `data` */
+    size_t size;
+
+    /** @brief The bytes at the start of `data` that are handed out */
+    size_t used;
+
+    /** @brief The start of the latest allocation, it can be resized in place */
+    size_t last;
+
+    max_align_t data[];
+};
+
+static he_arena_block *new_block(he_arena *arena, size_t size) {
+    he_arena_block *block = malloc(sizeof(he_arena_block) + size);
+
+    he_memory_count(sizeof(he_arena_block) + size);
+
+    if (!block) {
+        fprintf(stderr, "he_arena_alloc: unable to allocate memory!\n");
+        exit(-1);
+    }
+
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    block->last = 0;
+
+    arena->bytes_reserved += size;
+    ++arena->blocks;
+
+    return block;
+}
+
+void he_arena_init(he_arena *arena, size_t block_size) {
+    arena->head = NULL;
+    arena->block_size = align_up((block_size == 0) ? HE_ARENA_BLOCK_SIZE : block_size);
+    arena->allocations = 0;
+    arena->bytes_used = 0;
+    arena->peak_bytes_used = 0;
+    arena->bytes_reserved = 0;
+    arena->blocks = 0;
+}
+
+void he_arena_destroy(he_arena *arena) {
+    he_arena_block *block = arena->head;
+
+    while (block) {
+        he_arena_block *next = block->next;
+
+        free(block);
+        block = next;
+    }
+
+    he_arena_init(arena, arena->block_size);
+}
+
+void he_arena_reset(he_arena *arena) {
+    he_arena_block *keep = NULL;
+    he_arena_block *block = arena->head;
+
+    arena->bytes_reserved = 0;
+    arena->blocks = 0;
+
+    // the first normal sized block is kept so the next round of allocations is free
+    while (block) {
+        he_arena_block *next = block->next;
+
+        if (!keep && block->size == arena->block_size) {
+            keep = block;
+        } else {
+            free(block);
+        }
+
+        block = next;
+    }
+
+    arena->head = keep;
+    arena->bytes_used = 0;
+
+    if (keep) {
+        keep->next = NULL;
+        keep->used = 0;
+        keep->last = 0;
+
+        arena->bytes_reserved = keep->size;
+        arena->blocks = 1;
+    }
+}
+
+void *he_arena_alloc(he_arena *arena, size_t size) {
+    he_arena_block *block = arena->head;
+
+    size = align_up((size == 0) ? 1 : size);
+
+    if (!block || block->size - block->used < size) {
+        if (size > arena->block_size / 4) {
+            // big allocations get their own block behind the current one, so the space
+            // left in the current one isn't thrown away
+            block = new_block(arena, size);
+
+            if (arena->head) {
+                block->next = arena->head->next;
+                arena->head->next = block;
+            } else {
+                arena->head = block;
+            }
+        } else {
+            block = new_block(arena, arena->block_size);
+            block->next = arena->head;
+            arena->head = block;
+        }
+    }
+
+    void *ptr = (uint8_t *)block->data + block->used;
+
+    block->last = block->used;
+    block->used += size;
+
+    ++arena->allocations;
+    arena->bytes_used += size;
+
+    if (arena->bytes_used > arena->peak_bytes_used) { arena->peak_bytes_used = arena->bytes_used; }
+
+    return ptr;
+}
+
+void *he_arena_realloc(he_arena *arena, void *ptr, size_t old_size, size_t new_size) {
+    he_arena_block *block = arena->head;
+
+    if (!ptr) { return he_arena_alloc(arena, new_size); }
+
+    old_size = align_up(old_size);
+    new_size = align_up((new_size == 0) ? 1 : new_size);
+
+    // the latest allocation in the current block can grow or shrink where it is
+    if (block && ptr == (uint8_t *)block->data + block->last &&
+        block->last + old_size == block->used && block->size - block->last >= new_size) {
+        block->used = block->last + new_size;
+        arena->bytes_used = arena->bytes_used - old_size + new_size;
+
+        if (arena->bytes_used > arena->peak_bytes_used) {
+            arena->peak_bytes_used = arena->bytes_used;
+        }
+
+        return ptr;
+    }
+
+    if (new_size <= old_size) { return ptr; }
+
+    void *moved = he_arena_alloc(arena, new_size);
+
+    memcpy(moved, ptr, old_size);
+
+    return moved;
+}
+
+/** @brief The header of a pool's block, the objects come after it */
+typedef struct pool_block {
+    struct pool_block *next;
+    max_align_t objects[];
+} pool_block;
+
+void he_pool_init(he_pool *pool, size_t object_size, size_t objects_per_block, he_arena *arena) {
+    assert(objects_per_block != 0 && "a pool's blocks must hold at least one object");
+
+    // every object has to be able to hold the free list's link
+    if (object_size < sizeof(void *)) { object_size = sizeof(void *); }
+
+    pool->object_size = align_up(object_size);
+    pool->objects_per_block = objects_per_block;
+    pool->arena = arena;
+    pool->free_list = NULL;
+    pool->blocks = NULL;
+    pool->in_use = 0;
+    pool->capacity = 0;
+}
+
+void he_pool_destroy(he_pool *pool) {
+    pool_block *block = pool->blocks;
+
+    while (block && !pool->arena) {
+        pool_block *next = block->next;
+
+        free(block);
+        block = next;
+    }
+
+    he_pool_init(pool, pool->object_size, pool->objects_per_block, pool->arena);
+}
+
+void *he_pool_alloc(he_pool *pool) {
+    if (!pool->free_list) {
+        size_t size = sizeof(pool_block) + pool->object_size * pool->objects_per_block;
+        pool_block *block = pool->arena ? he_arena_alloc(pool->arena, size) : malloc(size);
+
+        if (!pool->arena) { he_memory_count(size); }
+
+        if (!block) {
+            fprintf(stderr, "he_pool_alloc: unable to allocate memory!\n");
+            exit(-1);
+        }
+
+        block->next = pool->blocks;
+        pool->blocks = block;
+        pool->capacity += pool->objects_per_block;
+
+        // thread the new objects onto the free list, first one on top
+        uint8_t *objects = (uint8_t *)block->objects;
+
+        for (size_t i = pool->objects_per_block; i-- != 0;) {
+            void *object = objects + i * pool->object_size;
+
+            *(void **)object = pool->free_list;
+            pool->free_list = object;
+        }
+    }
+
+    void *object = pool->free_list;
+
+    pool->free_list = *(void **)object;
+    ++pool->in_use;
+
+    return object;
+}
+
+void he_pool_free(he_pool *pool, void *object) {
+    if (!object) { return; }
+
+    assert(pool->in_use != 0 && "freeing more objects than the pool handed out");
+
+    *(void **)object = pool->free_list;
+    pool->free_list = object;
+    --pool->in_use;
+}
@@ -1,38 +1,212 @@
 #include "helium/module.h"
 #include "helium/instruction.h"
 #include "helium/memory.h"
+#include <stdatomic.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/** @brief The last id given to a module */
+static atomic_uint_fast64_t last_module_id;
 
 void he_module_init(he_module *mod) {
-    he_vector_init(&mod->ops, sizeof(uint8_t));
-    he_vector_init(&mod->pool, sizeof(he_value));
+    he_module_init_arena(mod, NULL);
+}
+
+void he_module_init_arena(he_module *mod, he_arena *arena) {
+    he_vector_init_arena(&mod->ops, sizeof(uint8_t), arena);
+    he_vector_init_arena(&mod->pool, sizeof(he_value), arena);
+
+    mod->arena = arena;
+    mod->mapping = NULL;
+    mod->mapping_size = 0;
+    mod->id = atomic_fetch_add_explicit(&last_module_id, 1, memory_order_relaxed) + 1;
+    mod->generation = 0;
+    mod->verified = false;
+    mod->functions = NULL;
+    mod->function_count = 0;
+    memset(&mod->bounds, 0, sizeof(mod->bounds));
+}
+
+/** @brief Forgets what he_module_verify found, the bytecode is about to change */
+static void clear_verification(he_module *mod) {
+    if (!mod->arena) { he_free_array(mod->functions); }
+
+    mod->verified = false;
+    mod->functions = NULL;
+    mod->function_count = 0;
+    memset(&mod->bounds, 0, sizeof(mod->bounds));
+}
+
+/** @brief Checks whether a module's bytecode is being used straight out of its file mapping */
+static bool ops_are_mapped(const he_module *mod) {
+    const uint8_t *begin = mod->mapping;
+
+    return begin && mod->ops.array >= begin && mod->ops.array < begin + mod->mapping_size;
 }
 
 void he_module_destroy(he_module *mod) {
+    // mapped bytecode belongs to the mapping, not the vector
+    if (ops_are_mapped(mod)) { mod->ops.array = NULL; }
+
     he_vector_destroy(&mod->ops);
     he_vector_destroy(&mod->pool);
 
-    he_module_init(mod);
+    if (mod->mapping) { munmap(mod->mapping, mod->mapping_size); }
+
+    if (!mod->arena) { he_free_array(mod->functions); }
+
+    he_module_init_arena(mod, mod->arena);
+}
+
+void he_module_clear_ops(he_module *mod) {
+    if (ops_are_mapped(mod)) { mod->ops.array = NULL; }
+
+    he_vector_destroy(&mod->ops);
+    clear_verification(mod);
+    ++mod->generation;
+}
+
+const he_function_bounds *he_module_function_bounds(const he_module *mod, size_t offset) {
+    size_t count = mod->verified ? mod->function_count : 0;
+    size_t low = 0;
+    size_t high = count;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+
+        if (mod->functions[mid].offset < offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low < count && mod->functions[low].offset == offset) { return &mod->functions[low]; }
+
+    return NULL;
 }
 
 void he_module_write_byte(he_module *mod, uint8_t byte) {
+    assert(!ops_are_mapped(mod) && "attempting to write to mapped bytecode, clear it first");
+
     he_vector_push_val(&mod->ops, byte);
+    ++mod->generation;
+
+    if (mod->verified) { clear_verification(mod); }
 }
 
-void he_module_write_int(he_module *mod, size_t bytes) {
-    // type punning in C is great. this is completely UB of course,
-    // but as the consumer will be reading the same number of bytes
-    // as another size_t elsewhere, it works
-    uint8_t *as_bytes = (uint8_t *)(&bytes);
+void he_module_write_int(he_module *mod, size_t num) {
+    do {
+        uint8_t byte = num & 0x7F;
+        num >>= 7;
+
+        he_module_write_byte(mod, (num != 0) ? (byte | 0x80) : byte);
+    } while (num != 0);
+}
 
-    for (unsigned int i = 0; i < sizeof(size_t); ++i) {
-        he_module_write_byte(mod, as_bytes[i]);
+size_t he_module_int_size(size_t num) {
+    size_t size = 1;
+
+    while (num >>= 7) {
+        ++size;
     }
+
+    return size;
 }
 
-void he_module_add_constant(he_module *mod, he_value val) {
-    uint64_t addr = mod->pool.size;
+bool he_module_read_int(const uint8_t *bytes, size_t size, size_t *offset, size_t *num) {
+    size_t result = 0;
+    size_t pos = *offset;
+
+    for (unsigned int shift = 0; pos < size; shift += 7) {
+        uint8_t byte = bytes[pos++];
+        size_t bits = byte & 0x7F;
+
+        // anything that doesn't fit in a size_t can't be an address or an index
+        if (shift >= sizeof(size_t) * 8 || (bits << shift) >> shift != bits) { return false; }
+
+        result |= bits << shift;
+
+        if ((byte & 0x80) == 0) {
+            *offset = pos;
+            *num = result;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool has_target(uint8_t op) {
+    return op == OP_CALL || he_opcode_is_jump((he_opcode)op);
+}
+
+void he_module_write_ops(he_module *mod, const he_module_op *ops, size_t count) {
+    size_t *offsets = he_alloc(sizeof(size_t), count + 1);
+    size_t *sizes = he_alloc(sizeof(size_t), count + 1);
+    bool changed = true;
+
+    for (size_t i = 0; i < count; ++i) {
+        // jumps start out as small as possible and only ever grow, so this settles
+        if (has_target(ops[i].op)) {
+            assert(ops[i].operand <= count && "jump target is past the end of the code");
+            sizes[i] = 2;
+        } else if (he_opcode_has_operand((he_opcode)ops[i].op)) {
+            sizes[i] = 1 + he_module_int_size(ops[i].operand);
+        } else {
+            sizes[i] = 1;
+        }
+    }
+
+    while (changed) {
+        size_t offset = mod->ops.size;
+
+        changed = false;
+
+        for (size_t i = 0; i < count; ++i) {
+            offsets[i] = offset;
+            offset += sizes[i];
+        }
+
+        offsets[count] = offset;
+
+        for (size_t i = 0; i < count; ++i) {
+            if (!has_target(ops[i].op)) { continue; }
+
+            size_t size = 1 + he_module_int_size(offsets[ops[i].operand]);
+
+            if (size > sizes[i]) {
+                sizes[i] = size;
+                changed = true;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        he_module_write_byte(mod, ops[i].op);
+
+        if (has_target(ops[i].op)) {
+            he_module_write_int(mod, offsets[ops[i].operand]);
+        } else if (he_opcode_has_operand((he_opcode)ops[i].op)) {
+            he_module_write_int(mod, ops[i].operand);
+        }
+    }
+
+    he_free_array(offsets);
+    he_free_array(sizes);
+}
+
+size_t he_module_push_constant(he_module *mod, he_value val) {
     he_vector_push_val(&mod->pool, val);
+    ++mod->generation;
+
+    return mod->pool.size - 1;
+}
+
+void he_module_add_constant(he_module *mod, he_value val) {
+    size_t addr = he_module_push_constant(mod, val);
 
     he_module_write_byte(mod, OP_LOAD_CONST);
     he_module_write_int(mod, addr);
@@ -0,0 +1,306 @@
+#include "helium/module_file.h"
+#include "helium/memory.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define OFFSET_VERSION 8
+#define OFFSET_FLAGS 12
+#define OFFSET_CODE 16
+#define OFFSET_CODE_SIZE 24
+#define OFFSET_POOL 32
+#define OFFSET_POOL_COUNT 40
+#define OFFSET_STRINGS 48
+#define OFFSET_STRINGS_SIZE 56
+#define OFFSET_CODE_CRC 64
+#define OFFSET_POOL_CRC 68
+#define OFFSET_STRINGS_CRC 72
+#define OFFSET_HEADER_CRC 76
+
+static uint32_t crc32(const uint8_t *bytes, size_t size) {
+    // the reflected 0xEDB88320 polynomial, a nibble at a time
+    static const uint32_t table[16] = {
+        0x00000000,
+        0x1DB71064,
+        0x3B6E20C8,
+        0x26D930AC,
+        0x76DC4190,
+        0x6B6B51F4,
+        0x4DB26158,
+        0x5005713C,
+        0xEDB88320,
+        0xF00F9344,
+        0xD6D6A3E8,
+        0xCB61B38C,
+        0x9B64C2B0,
+        0x86D3D2D4,
+        0xA00AE278,
+        0xBDBDF21C,
+    };
+
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= bytes[i];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+
+    return ~crc;
+}
+
+static void put_u32(uint8_t *bytes, uint32_t num) {
+    for (int i = 0; i < 4; ++i) {
+        bytes[i] = (uint8_t)(num >> (8 * i));
+    }
+}
+
+static void put_u64(uint8_t *bytes, uint64_t num) {
+    for (int i = 0; i < 8; ++i) {
+        bytes[i] = (uint8_t)(num >> (8 * i));
+    }
+}
+
+static uint32_t get_u32(const uint8_t *bytes) {
+    uint32_t num = 0;
+
+    for (int i = 3; i >= 0; --i) {
+        num = (num << 8) | bytes[i];
+    }
+
+    return num;
+}
+
+static uint64_t get_u64(const uint8_t *bytes) {
+    uint64_t num = 0;
+
+    for (int i = 7; i >= 0; --i) {
+        num = (num << 8) | bytes[i];
+    }
+
+    return num;
+}
+
+static size_t align8(size_t num) {
+    return (num + 7) & ~(size_t)7;
+}
+
+/** @brief Encodes the constant pool, collecting the strings it refers to */
+static bool encode_pool(const he_module *mod, uint8_t *pool, he_vector *strings) {
+    for (size_t i = 0; i < mod->pool.size; ++i) {
+        const he_value *val = he_vector_at(&mod->pool, i);
+        uint8_t *entry = pool + i * HE_FILE_CONST_SIZE;
+        uint64_t payload = 0;
+
+        memset(entry, 0, HE_FILE_CONST_SIZE);
+
+        switch (he_val_type(val)) {
+            case TYPE_BOOL:
+                entry[0] = HE_FILE_CONST_BOOL;
+                payload = he_val_as_bool(val);
+                break;
+            case TYPE_INT:
+                entry[0] = HE_FILE_CONST_INT;
+                payload = (uint64_t)he_val_as_int(val);
+                break;
+            case TYPE_FLOAT: {
+                double num = he_val_as_float(val);
+
+                entry[0] = HE_FILE_CONST_FLOAT;
+                memcpy(&payload, &num, sizeof(double));
+                break;
+            }
+            case TYPE_STRING: {
+                const char *str = he_val_as_string(val);
+                size_t length = he_val_string_length(val);
+
+                entry[0] = HE_FILE_CONST_STRING;
+                payload = strings->size;
+
+                for (size_t j = 0; j <= length; ++j) {
+                    he_vector_push(strings, (void *)&str[j]);
+                }
+                break;
+            }
+            default:
+                return false;
+        }
+
+        put_u64(entry + 8, payload);
+    }
+
+    return true;
+}
+
+bool he_module_save(const he_module *mod, const char *path) {
+    uint8_t header[HE_FILE_HEADER_SIZE];
+    he_vector strings;
+    size_t pool_size = mod->pool.size * HE_FILE_CONST_SIZE;
+    uint8_t *pool = he_alloc(1, pool_size + 1);
+    bool ok = false;
+
+    he_vector_init(&strings, sizeof(char));
+
+    if (!encode_pool(mod, pool, &strings)) { goto done; }
+
+    size_t code_offset = HE_FILE_HEADER_SIZE;
+    size_t pool_offset = align8(code_offset + mod->ops.size);
+    size_t strings_offset = pool_offset + pool_size;
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, HE_FILE_MAGIC, 8);
+    put_u32(header + OFFSET_VERSION, HE_FILE_VERSION);
+    put_u32(header + OFFSET_FLAGS, 0);
+    put_u64(header + OFFSET_CODE, code_offset);
+    put_u64(header + OFFSET_CODE_SIZE, mod->ops.size);
+    put_u64(header + OFFSET_POOL, pool_offset);
+    put_u64(header + OFFSET_POOL_COUNT, mod->pool.size);
+    put_u64(header + OFFSET_STRINGS, strings_offset);
+    put_u64(header + OFFSET_STRINGS_SIZE, strings.size);
+    put_u32(header + OFFSET_CODE_CRC, crc32(mod->ops.array, mod->ops.size));
+    put_u32(header + OFFSET_POOL_CRC, crc32(pool, pool_size));
+    put_u32(header + OFFSET_STRINGS_CRC, crc32(strings.array, strings.size));
+    put_u32(header + OFFSET_HEADER_CRC, crc32(header, OFFSET_HEADER_CRC));
+
+    FILE *file = fopen(path, "wb");
+
+    if (!file) { goto done; }
+
+    static const uint8_t padding[8] = {0};
+
+    ok = fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+         fwrite(mod->ops.array, 1, mod->ops.size, file) == mod->ops.size &&
+         fwrite(padding, 1, pool_offset - code_offset - mod->ops.size, file) ==
+             pool_offset - code_offset - mod->ops.size &&
+         fwrite(pool, 1, pool_size, file) == pool_size &&
+         fwrite(strings.array, 1, strings.size, file) == strings.size;
+
+    ok = (fclose(file) == 0) && ok;
+
+done:
+    he_free_array(pool);
+    he_vector_destroy(&strings);
+
+    return ok;
+}
+
+/** @brief Checks that a section lies inside the file and matches its checksum */
+static bool check_section(const uint8_t *file, size_t file_size, uint64_t offset, uint64_t size,
+                          uint32_t crc) {
+    if (offset > file_size || size > file_size - offset) { return false; }
+
+    return crc32(file + offset, size) == crc;
+}
+
+static bool decode_pool(he_module *mod, const uint8_t *pool, size_t count, const char *strings,
+                        size_t strings_size) {
+    // a table that doesn't end in a NUL could let a string run off the end of it
+    if (strings_size != 0 && strings[strings_size - 1] != '\0') { return false; }
+
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t *entry = pool + i * HE_FILE_CONST_SIZE;
+        uint64_t payload = get_u64(entry + 8);
+        he_value val;
+
+        switch (entry[0]) {
+            case HE_FILE_CONST_BOOL:
+                val = he_val_from_bool(payload != 0);
+                break;
+            case HE_FILE_CONST_INT:
+                val = he_val_from_int((int64_t)payload);
+                break;
+            case HE_FILE_CONST_FLOAT: {
+                double num;
+
+                memcpy(&num, &payload, sizeof(double));
+                val = he_val_from_float(num);
+                break;
+            }
+            case HE_FILE_CONST_STRING:
+                if (payload >= strings_size) { return false; }
+
+                val = he_val_from_string(strings + payload);
+                break;
+            default:
+                return false;
+        }
+
+        he_module_push_constant(mod, val);
+    }
+
+    return true;
+}
+
+/** @brief Checks a mapped file and points a module at it */
+static bool load_mapping(he_module *mod, const uint8_t *file, size_t size) {
+    if (size < HE_FILE_HEADER_SIZE || memcmp(file, HE_FILE_MAGIC, 8) != 0) { return false; }
+    if (crc32(file, OFFSET_HEADER_CRC) != get_u32(file + OFFSET_HEADER_CRC)) { return false; }
+    if (get_u32(file + OFFSET_VERSION) > HE_FILE_VERSION) { return false; }
+
+    uint64_t code = get_u64(file + OFFSET_CODE);
+    uint64_t code_size = get_u64(file + OFFSET_CODE_SIZE);
+    uint64_t pool = get_u64(file + OFFSET_POOL);
+    uint64_t pool_count = get_u64(file + OFFSET_POOL_COUNT);
+    uint64_t strings = get_u64(file + OFFSET_STRINGS);
+    uint64_t strings_size = get_u64(file + OFFSET_STRINGS_SIZE);
+
+    if (pool_count > size / HE_FILE_CONST_SIZE) { return false; }
+
+    uint64_t pool_size = pool_count * HE_FILE_CONST_SIZE;
+
+    if (!check_section(file, size, code, code_size, get_u32(file + OFFSET_CODE_CRC)) ||
+        !check_section(file, size, pool, pool_size, get_u32(file + OFFSET_POOL_CRC)) ||
+        !check_section(file, size, strings, strings_size, get_u32(file + OFFSET_STRINGS_CRC))) {
+        return false;
+    }
+
+    if (!decode_pool(mod, file + pool, pool_count, (const char *)file + strings, strings_size)) {
+        return false;
+    }
+
+    // the vector is never grown, he_module_write_byte refuses to touch mapped bytecode.
+    // empty code is left NULL so it can't be mistaken for a pointer to free
+    if (code_size == 0) { return true; }
+
+    mod->ops.array = (uint8_t *)file + code;
+    mod->ops.size = code_size;
+    mod->ops.capacity = code_size;
+    ++mod->generation;
+
+    return true;
+}
+
+bool he_module_load_mapped(he_module *mod, const char *path) {
+    struct stat info;
+    int fd = open(path, O_RDONLY);
+
+    he_module_init(mod);
+
+    if (fd < 0) { return false; }
+
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = (size_t)info.st_size;
+    void *file = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // the mapping keeps the file alive on its own
+    close(fd);
+
+    if (file == MAP_FAILED) { return false; }
+
+    mod->mapping = file;
+    mod->mapping_size = size;
+
+    if (!load_mapping(mod, file, size)) {
+        he_module_destroy(mod);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,151 @@
+#include "helium/ngram.h"
+#include "helium/memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_CAPACITY 64
+
+void he_ngram_table_init(he_ngram_table *table, size_t n) {
+    assert(n != 0 && n <= HE_NGRAM_MAX && "n-gram length out of range");
+
+    table->entries = he_alloc(sizeof(he_ngram), INITIAL_CAPACITY);
+    table->capacity = INITIAL_CAPACITY;
+    table->size = 0;
+    table->n = n;
+
+    memset(table->entries, 0, sizeof(he_ngram) * INITIAL_CAPACITY);
+}
+
+void he_ngram_table_destroy(he_ngram_table *table) {
+    he_free_array(table->entries);
+
+    table->entries = NULL;
+    table->capacity = 0;
+    table->size = 0;
+}
+
+uint32_t he_ngram_key(const he_opcode *ops, size_t n) {
+    uint32_t key = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        key = (key << 8) | ops[i];
+    }
+
+    return key;
+}
+
+he_opcode he_ngram_opcode(const he_ngram_table *table, uint32_t key, size_t i) {
+    return (he_opcode)((key >> (8 * (table->n - 1 - i))) & 0xFF);
+}
+
+static size_t hash_key(uint32_t key) {
+    // fibonacci hashing, the keys are small and clustered so they need mixing
+    return (size_t)((key * UINT64_C(11400714819323198485)) >> 32);
+}
+
+static he_ngram *find_slot(he_ngram *entries, size_t capacity, uint32_t key) {
+    size_t mask = capacity - 1;
+
+    for (size_t i = hash_key(key) & mask;; i = (i + 1) & mask) {
+        if (entries[i].count == 0 || entries[i].key == key) { return &entries[i]; }
+    }
+}
+
+static void grow(he_ngram_table *table) {
+    size_t capacity = table->capacity * 2;
+    he_ngram *entries = he_alloc(sizeof(he_ngram), capacity);
+
+    memset(entries, 0, sizeof(he_ngram) * capacity);
+
+    for (size_t i = 0; i < table->capacity; ++i) {
+        if (table->entries[i].count != 0) {
+            *find_slot(entries, capacity, table->entries[i].key) = table->entries[i];
+        }
+    }
+
+    he_free_array(table->entries);
+
+    table->entries = entries;
+    table->capacity = capacity;
+}
+
+void he_ngram_table_add(he_ngram_table *table, uint32_t key) {
+    // stay under half full so probes stay short
+    if ((table->size + 1) * 2 > table->capacity) { grow(table); }
+
+    he_ngram *slot = find_slot(table->entries, table->capacity, key);
+
+    if (slot->count == 0) {
+        slot->key = key;
+        ++table->size;
+    }
+
+    ++slot->count;
+}
+
+size_t he_ngram_table_count(const he_ngram_table *table, uint32_t key) {
+    return find_slot(table->entries, table->capacity, key)->count;
+}
+
+static int compare_counts(const void *lhs, const void *rhs) {
+    const he_ngram *a = lhs;
+    const he_ngram *b = rhs;
+
+    if (a->count != b->count) { return (a->count < b->count) ? 1 : -1; }
+
+    // ties are broken by key so the order doesn't depend on the hash table's layout
+    return (a->key > b->key) - (a->key < b->key);
+}
+
+size_t he_ngram_table_top(const he_ngram_table *table, he_ngram *out, size_t max) {
+    if (table->size == 0 || max == 0) { return 0; }
+
+    he_ngram *sorted = he_alloc(sizeof(he_ngram), table->size);
+    size_t n = 0;
+
+    for (size_t i = 0; i < table->capacity; ++i) {
+        if (table->entries[i].count != 0) { sorted[n++] = table->entries[i]; }
+    }
+
+    qsort(sorted, n, sizeof(he_ngram), compare_counts);
+
+    if (n > max) { n = max; }
+
+    memcpy(out, sorted, sizeof(he_ngram) * n);
+    he_free_array(sorted);
+
+    return n;
+}
+
+he_interpret_flag he_vm_profile_ngrams(he_vm *vm, const he_module *mod, he_ngram_table *table,
+                                       size_t max_steps) {
+    // the stepper trusts the bytecode, so make sure it decodes before stepping through it
+    he_vm_use(vm, mod);
+
+    if (!he_code_is_current(&vm->code, mod)) {
+        vm->error = "he_vm_profile_ngrams: module bytecode is malformed";
+        fprintf(stderr, "helium: %s\n", vm->error);
+        return INTERPRET_FAILURE;
+    }
+
+    uint32_t mask = (table->n == 4) ? UINT32_MAX : ((UINT32_C(1) << (8 * table->n)) - 1);
+    uint32_t window = 0;
+    size_t seen = 0;
+
+    for (size_t steps = 0; max_steps == 0 || steps < max_steps; ++steps) {
+        if (vm->pc >= mod->ops.size) { break; }
+
+        uint8_t op = mod->ops.array[vm->pc];
+
+        if (op == OP_HALT) { break; }
+
+        window = ((window << 8) | op) & mask;
+
+        if (++seen >= table->n) { he_ngram_table_add(table, window); }
+
+        if (he_vm_execute_instruction(vm, false) == INTERPRET_FAILURE) { return INTERPRET_FAILURE; }
+    }
+
+    return INTERPRET_SUCCESS;
+}
@@ -0,0 +1,287 @@
+#include "helium/optimize.h"
+#include "helium/code.h"
+#include "helium/fusion.h"
+#include "helium/instruction.h"
+#include "helium/memory.h"
+#include "helium/vm.h"
+#include <string.h>
+
+/** @brief An instruction that's easy to edit, jumps refer to instructions instead of bytes */
+typedef struct opt_instr {
+    he_opcode op;
+
+    /** @brief Constant index, or the index of the instruction a jump or call goes to */
+    size_t operand;
+
+    /** @brief Whether anything other than the previous instruction can continue here */
+    bool target;
+
+    /** @brief Whether the instruction is being deleted */
+    bool removed;
+} opt_instr;
+
+typedef struct optimizer {
+    he_module *mod;
+    opt_instr *code;
+    size_t size;
+} optimizer;
+
+static bool has_target(he_opcode op) {
+    return op == OP_CALL || he_opcode_is_jump(op);
+}
+
+/** @brief Fills in the editable form of the module, the sentinel OP_HALT included */
+static bool load(optimizer *opt, he_module *mod) {
+    he_code code;
+
+    he_code_init(&code);
+
+    if (!he_code_translate(&code, mod)) { return false; }
+
+    opt->mod = mod;
+    opt->size = code.size;
+    opt->code = he_alloc(sizeof(opt_instr), code.size + 1);
+
+    for (size_t i = 0; i <= code.size; ++i) {
+        const he_op *op = &code.ops[i];
+        opt_instr *instr = &opt->code[i];
+
+        instr->op = op->op;
+        instr->operand = 0;
+        instr->removed = false;
+
+        if (op->op == OP_CALL) {
+            instr->operand = op->op_object.call.address;
+        } else if (he_opcode_is_jump(op->op)) {
+            instr->operand = op->op_object.jmp.address;
+        } else if (he_opcode_has_operand(op->op)) {
+            // constant indices aren't kept by the decoder, only the values
+            size_t offset = code.offsets[i] + 1;
+
+            he_module_read_int(mod->ops.array, mod->ops.size, &offset, &instr->operand);
+        }
+    }
+
+    he_code_destroy(&code);
+
+    return true;
+}
+
+static void find_targets(optimizer *opt) {
+    for (size_t i = 0; i <= opt->size; ++i) {
+        opt->code[i].target = false;
+    }
+
+    for (size_t i = 0; i < opt->size; ++i) {
+        const opt_instr *instr = &opt->code[i];
+
+        if (has_target(instr->op)) { opt->code[instr->operand].target = true; }
+
+        // returns come back to the instruction after a call
+        if (instr->op == OP_CALL) { opt->code[i + 1].target = true; }
+    }
+}
+
+/** @brief Deletes removed instructions, pointing jumps at whatever came after them */
+static void compact(optimizer *opt) {
+    size_t *remap = he_alloc(sizeof(size_t), opt->size + 1);
+    size_t next = 0;
+
+    // the sentinel is never removed, so every removed instruction has a live one after it
+    for (size_t i = 0; i <= opt->size; ++i) {
+        remap[i] = next;
+
+        if (!opt->code[i].removed) { ++next; }
+    }
+
+    next = 0;
+
+    for (size_t i = 0; i <= opt->size; ++i) {
+        if (opt->code[i].removed) { continue; }
+
+        opt_instr instr = opt->code[i];
+
+        if (has_target(instr.op)) { instr.operand = remap[instr.operand]; }
+
+        opt->code[next++] = instr;
+    }
+
+    opt->size = next - 1;
+
+    he_free_array(remap);
+}
+
+static bool values_identical(const he_value *lhs, const he_value *rhs) {
+    if (he_val_type(lhs) != he_val_type(rhs)) { return false; }
+
+    switch (he_val_type(lhs)) {
+        case TYPE_BOOL:
+            return he_val_as_bool(lhs) == he_val_as_bool(rhs);
+        case TYPE_INT:
+            return he_val_as_int(lhs) == he_val_as_int(rhs);
+        case TYPE_FLOAT: {
+            // compared by bits, so -0.0 and 0.0 stay apart and NaN matches itself
+            double a = he_val_as_float(lhs);
+            double b = he_val_as_float(rhs);
+
+            return memcmp(&a, &b, sizeof(double)) == 0;
+        }
+        case TYPE_STRING:
+            return he_string_equal(he_val_as_string(lhs), he_val_as_string(rhs));
+        case TYPE_OBJECT:
+            return he_val_as_object(lhs) == he_val_as_object(rhs);
+        default:
+            return false;
+    }
+}
+
+/** @brief Gets the pool index of a constant, adding it to the pool if it isn't already there */
+static size_t intern_constant(optimizer *opt, he_value val) {
+    he_vector *pool = &opt->mod->pool;
+
+    for (size_t i = 0; i < pool->size; ++i) {
+        if (values_identical(he_vector_at(pool, i), &val)) { return i; }
+    }
+
+    return he_module_push_constant(opt->mod, val);
+}
+
+static he_value constant(const optimizer *opt, const opt_instr *instr) {
+    return *(const he_value *)he_vector_at(&opt->mod->pool, instr->operand);
+}
+
+static bool is_binary(he_opcode op) {
+    return op >= OP_ADD && op <= OP_EQ;
+}
+
+static bool is_unary(he_opcode op) {
+    return op == OP_NOT || op == OP_NEGATE;
+}
+
+/** @brief `k1; k2; op` becomes the result, and `k; op` for unary ops */
+static bool fold(optimizer *opt, size_t i) {
+    opt_instr *code = opt->code;
+
+    if (code[i].op != OP_LOAD_CONST || code[i + 1].target) { return false; }
+
+    he_value result = constant(opt, &code[i]);
+
+    if (is_unary(code[i + 1].op)) {
+        if (!he_vm_evaluate(code[i + 1].op, &result, result)) { return false; }
+
+        code[i].operand = intern_constant(opt, result);
+        code[i + 1].removed = true;
+
+        return true;
+    }
+
+    if (i + 2 > opt->size || code[i + 1].op != OP_LOAD_CONST || code[i + 2].target ||
+        !is_binary(code[i + 2].op)) {
+        return false;
+    }
+
+    if (!he_vm_evaluate(code[i + 2].op, &result, constant(opt, &code[i + 1]))) { return false; }
+
+    code[i].operand = intern_constant(opt, result);
+    code[i + 1].removed = true;
+    code[i + 2].removed = true;
+
+    return true;
+}
+
+/** @brief `k; OP_POP` and `OP_DUP; OP_POP` do nothing */
+static bool remove_push_pop(optimizer *opt, size_t i) {
+    opt_instr *code = opt->code;
+
+    if (code[i].op != OP_LOAD_CONST && code[i].op != OP_DUP) { return false; }
+    if (code[i + 1].op != OP_POP || code[i + 1].target) { return false; }
+
+    // if something jumped to the push it lands on whatever follows the pop instead
+    code[i].removed = true;
+    code[i + 1].removed = true;
+
+    return true;
+}
+
+/**
+ * @brief `OP_NOT; OP_JZ` becomes `OP_JNZ` and the other way around. The jump leaves
+ * its condition on the stack, so this is only done when both ways pop it right away
+ */
+static bool invert_branch(optimizer *opt, size_t i) {
+    opt_instr *code = opt->code;
+    opt_instr *jump = &code[i + 1];
+
+    if (code[i].op != OP_NOT || jump->target) { return false; }
+    if (jump->op != OP_JZ && jump->op != OP_JNZ) { return false; }
+    if (code[i + 2].op != OP_POP || code[jump->operand].op != OP_POP) { return false; }
+
+    jump->op = (jump->op == OP_JZ) ? OP_JNZ : OP_JZ;
+    code[i].removed = true;
+
+    return true;
+}
+
+static bool run_pass(optimizer *opt, he_opt_level level) {
+    bool changed = false;
+
+    find_targets(opt);
+
+    // each instruction is only touched by one rewrite per pass, the next pass sees
+    // the result of it. the sentinel means looking one past an instruction is safe
+    for (size_t i = 0; i < opt->size; ++i) {
+        if (opt->code[i].removed) { continue; }
+
+        bool rewrote = (level >= OPT_FOLD && fold(opt, i)) || remove_push_pop(opt, i) ||
+                       (i + 2 <= opt->size && invert_branch(opt, i));
+
+        if (rewrote) {
+            changed = true;
+
+            while (i + 1 < opt->size && opt->code[i + 1].removed) {
+                ++i;
+            }
+        }
+    }
+
+    if (changed) { compact(opt); }
+
+    return changed;
+}
+
+/** @brief Writes the editable form back out as the module's bytecode */
+static void store(optimizer *opt) {
+    he_module_op *ops = he_alloc(sizeof(he_module_op), opt->size + 1);
+
+    // the sentinel isn't written, jumps to it go to the end of the module
+    for (size_t i = 0; i < opt->size; ++i) {
+        ops[i].op = opt->code[i].op;
+        ops[i].operand = opt->code[i].operand;
+    }
+
+    he_module_clear_ops(opt->mod);
+    he_module_write_ops(opt->mod, ops, opt->size);
+
+    he_free_array(ops);
+}
+
+bool he_module_optimize(he_module *mod, he_opt_level level) {
+    optimizer opt;
+
+    if (!load(&opt, mod)) { return false; }
+
+    bool changed = false;
+
+    while (level != OPT_NONE && run_pass(&opt, level)) {
+        changed = true;
+    }
+
+    if (changed) { store(&opt); }
+
+    he_free_array(opt.code);
+
+    if (level >= OPT_FUSE) {
+        return he_module_fuse(mod, he_fusion_rules, he_fusion_rule_count, NULL);
+    }
+
+    return true;
+}
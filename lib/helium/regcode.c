@@ -0,0 +1,379 @@
+#include "helium/regcode.h"
+#include "helium/analysis.h"
+#include "helium/memory.h"
+#include <string.h>
+
+/** @brief What the translator knows about a stack slot that may not be in its register yet */
+typedef enum slot_kind {
+    /** @brief The slot's value is in the slot's own register */
+    SLOT_IN_REGISTER = 0,
+
+    /** @brief The slot is a constant that hasn't been loaded yet */
+    SLOT_CONSTANT,
+
+    /** @brief The slot is a copy of a lower register that hasn't been made yet */
+    SLOT_COPY,
+} slot_kind;
+
+typedef struct slot {
+    slot_kind kind;
+    int32_t reg;
+    he_value k;
+} slot;
+
+/** @brief State shared between the analysis and emission passes */
+typedef struct translator {
+    const he_code *code;
+
+    /** @brief Depths, frames and register ranges of the stack code */
+    he_stack_analysis a;
+
+    /** @brief Symbolic stack, indexed by register - `slot_base` */
+    slot *slots;
+    int32_t slot_base;
+
+    /** @brief Instruction index each stack instruction's translation starts at */
+    size_t *start;
+
+    he_reg_op *ops;
+    size_t *offsets;
+    size_t size;
+    size_t capacity;
+} translator;
+
+static he_reg_op *emit(translator *t, he_reg_opcode op, size_t from) {
+    if (t->size == t->capacity) {
+        size_t capacity = t->capacity;
+
+        t->ops = he_grow_array(t->ops, sizeof(he_reg_op), &capacity);
+        t->offsets = he_grow_array(t->offsets, sizeof(size_t), &t->capacity);
+    }
+
+    he_reg_op *reg_op = &t->ops[t->size];
+
+    memset(reg_op, 0, sizeof(he_reg_op));
+    reg_op->op = op;
+
+    t->offsets[t->size++] = t->code->offsets[from];
+
+    return reg_op;
+}
+
+static slot *slot_at(translator *t, int32_t reg) {
+    return &t->slots[reg - t->slot_base];
+}
+
+/** @brief Makes sure a slot's value is actually in its register */
+static void materialize(translator *t, int32_t reg, size_t from) {
+    slot *s = slot_at(t, reg);
+
+    if (s->kind == SLOT_CONSTANT) {
+        he_reg_op *op = emit(t, REG_LOADK, from);
+        op->a = reg;
+        op->k = s->k;
+    } else if (s->kind == SLOT_COPY) {
+        he_reg_op *op = emit(t, REG_MOVE, from);
+        op->a = reg;
+        op->b = s->reg;
+    }
+
+    s->kind = SLOT_IN_REGISTER;
+}
+
+/** @brief Materializes every slot, used wherever control flow can join or leave */
+static void materialize_all(translator *t, int32_t low, int32_t depth, size_t from) {
+    for (int32_t reg = low; reg < depth; ++reg) {
+        materialize(t, reg, from);
+    }
+}
+
+/** @brief Gets the register a slot's value can be read from, materializing constants */
+static int32_t source_register(translator *t, int32_t reg, size_t from) {
+    slot *s = slot_at(t, reg);
+
+    if (s->kind == SLOT_COPY) { return s->reg; }
+
+    materialize(t, reg, from);
+
+    return reg;
+}
+
+static he_reg_opcode register_form(he_opcode op) {
+    return (he_reg_opcode)(REG_ADD + (op - OP_ADD));
+}
+
+static he_reg_opcode constant_form(he_opcode op) {
+    return (he_reg_opcode)(REG_ADDK + (op - OP_ADD));
+}
+
+/**
+ * @brief Checks whether an op can take its operands the other way around. Reversing an
+ * ordered comparison would also work, but its errors would name the reversed op
+ */
+static bool is_commutative(he_opcode op) {
+    return op == OP_ADD || op == OP_MUL || op == OP_EQ;
+}
+
+static void emit_binary(translator *t, he_opcode op, int32_t depth, size_t from) {
+    int32_t lhs = depth - 2;
+    int32_t rhs = depth - 1;
+    slot *l = slot_at(t, lhs);
+    slot *r = slot_at(t, rhs);
+
+    if (l->kind == SLOT_CONSTANT && r->kind != SLOT_CONSTANT && is_commutative(op)) {
+        // k op r is the same as r op k, which saves loading k into a register
+        int32_t source = source_register(t, rhs, from);
+        he_reg_op *reg_op = emit(t, constant_form(op), from);
+
+        reg_op->a = lhs;
+        reg_op->b = source;
+        reg_op->k = l->k;
+    } else if (r->kind == SLOT_CONSTANT) {
+        he_value k = r->k;
+        int32_t source = source_register(t, lhs, from);
+        he_reg_op *reg_op = emit(t, constant_form(op), from);
+
+        reg_op->a = lhs;
+        reg_op->b = source;
+        reg_op->k = k;
+    } else {
+        int32_t right = source_register(t, rhs, from);
+        int32_t left = source_register(t, lhs, from);
+        he_reg_op *reg_op = emit(t, register_form(op), from);
+
+        reg_op->a = lhs;
+        reg_op->b = left;
+        reg_op->c = right;
+    }
+
+    slot_at(t, lhs)->kind = SLOT_IN_REGISTER;
+}
+
+static void emit_unary(translator *t, he_reg_opcode op, int32_t depth, size_t from) {
+    int32_t source = source_register(t, depth - 1, from);
+    he_reg_op *reg_op = emit(t, op, from);
+
+    reg_op->a = depth - 1;
+    reg_op->b = source;
+
+    slot_at(t, depth - 1)->kind = SLOT_IN_REGISTER;
+}
+
+/** @brief Emits the conditional jump of OP_JZ, OP_JNZ or one of the fused compare-and-jumps */
+static void emit_branch(translator *t, const he_op *op, int32_t low, int32_t depth, size_t from) {
+    bool if_true = op->op == OP_JZ || op->op == OP_LT_JZ || op->op == OP_GT_JZ;
+
+    materialize_all(t, low, depth, from);
+
+    he_reg_op *reg_op = emit(t, if_true ? REG_JZ : REG_JNZ, from);
+    reg_op->a = depth - 1;
+    reg_op->target = op->op_object.jmp.address;
+}
+
+static void emit_all(translator *t) {
+    const he_code *code = t->code;
+    bool falls_through = false;
+
+    for (size_t i = 0; i <= code->size; ++i) {
+        const he_op *op = &code->ops[i];
+        int32_t depth = t->a.depth[i];
+
+        if (depth == HE_DEPTH_UNKNOWN) {
+            t->start[i] = t->size;
+            falls_through = false;
+            continue;
+        }
+
+        int32_t low = t->a.low[t->a.owner[i]];
+
+        if (!falls_through || t->a.label[i]) {
+            // everything arriving from elsewhere has every slot in its register
+            if (falls_through) { materialize_all(t, low, depth, i); }
+
+            for (int32_t reg = low; reg < depth; ++reg) {
+                slot_at(t, reg)->kind = SLOT_IN_REGISTER;
+            }
+        }
+
+        t->start[i] = t->size;
+        falls_through = true;
+
+        switch (op->op) {
+            case OP_LOAD_CONST: {
+                slot *s = slot_at(t, depth);
+                s->kind = SLOT_CONSTANT;
+                s->k = op->op_object.push.val;
+                break;
+            }
+            case OP_DUP: {
+                slot *top = slot_at(t, depth - 1);
+                slot *s = slot_at(t, depth);
+
+                *s = *top;
+
+                if (top->kind == SLOT_IN_REGISTER) {
+                    s->kind = SLOT_COPY;
+                    s->reg = depth - 1;
+                }
+                break;
+            }
+            case OP_POP:
+                break;
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:
+            case OP_MOD:
+            case OP_GT:
+            case OP_LT:
+            case OP_GTEQ:
+            case OP_LTEQ:
+            case OP_EQ:
+                emit_binary(t, op->op, depth, i);
+                break;
+            case OP_NOT:
+                emit_unary(t, REG_NOT, depth, i);
+                break;
+            case OP_NEGATE:
+                emit_unary(t, REG_NEGATE, depth, i);
+                break;
+            case OP_JMP:
+                materialize_all(t, low, depth, i);
+                emit(t, REG_JMP, i)->target = op->op_object.jmp.address;
+                falls_through = false;
+                break;
+            case OP_JZ:
+            case OP_JNZ:
+                emit_branch(t, op, low, depth, i);
+                break;
+            case OP_LOAD_CONST_ADD:
+            case OP_LOAD_CONST_SUB: {
+                slot *s = slot_at(t, depth);
+                s->kind = SLOT_CONSTANT;
+                s->k = op->op_object.push.val;
+
+                emit_binary(t, (op->op == OP_LOAD_CONST_ADD) ? OP_ADD : OP_SUB, depth + 1, i);
+                break;
+            }
+            case OP_LT_JZ:
+            case OP_LT_JNZ:
+            case OP_GT_JZ:
+            case OP_GT_JNZ: {
+                bool lt = op->op == OP_LT_JZ || op->op == OP_LT_JNZ;
+
+                emit_binary(t, lt ? OP_LT : OP_GT, depth, i);
+                emit_branch(t, op, low, depth - 1, i);
+                break;
+            }
+            case OP_EQ_NOT:
+                emit_binary(t, OP_EQ, depth, i);
+                emit_unary(t, REG_NOT, depth - 1, i);
+                break;
+            case OP_CALL: {
+                size_t callee = op->op_object.call.address;
+
+                materialize_all(t, low, depth, i);
+
+                he_reg_op *reg_op = emit(t, REG_CALL, i);
+                reg_op->a = depth;
+                reg_op->b = depth + t->a.low[callee];
+                reg_op->c = depth + t->a.high[callee];
+                reg_op->target = callee;
+
+                // a call to a function that never returns doesn't fall through
+                falls_through = t->a.depth[i + 1] != HE_DEPTH_UNKNOWN;
+                break;
+            }
+            case OP_RET:
+                materialize_all(t, low, depth, i);
+                emit(t, REG_RET, i);
+                falls_through = false;
+                break;
+            case OP_HALT:
+                materialize_all(t, low, depth, i);
+                emit(t, REG_HALT, i)->a = depth;
+                falls_through = false;
+                break;
+            default:
+                // the analysis only reaches the opcodes above
+                break;
+        }
+    }
+
+    for (size_t i = 0; i < t->size; ++i) {
+        he_reg_op *reg_op = &t->ops[i];
+
+        if (reg_op->op == REG_JMP || reg_op->op == REG_JZ || reg_op->op == REG_JNZ ||
+            reg_op->op == REG_CALL) {
+            reg_op->target = t->start[reg_op->target];
+        }
+    }
+}
+
+void he_reg_code_init(he_reg_code *reg) {
+    reg->ops = NULL;
+    reg->size = 0;
+    reg->offsets = NULL;
+    reg->code = NULL;
+    reg->entry = 0;
+    reg->entry_op = 0;
+    reg->entry_low = 0;
+    reg->entry_high = 0;
+    reg->threaded = false;
+}
+
+void he_reg_code_destroy(he_reg_code *reg) {
+    he_free_array(reg->ops);
+    he_free_array(reg->offsets);
+
+    he_reg_code_init(reg);
+}
+
+bool he_reg_code_translate(he_reg_code *reg, const he_code *code, size_t entry) {
+    size_t count = code->size + 1;
+    size_t entry_index = he_code_index_of(code, entry);
+    translator t;
+    bool ok = false;
+
+    he_reg_code_destroy(reg);
+
+    reg->code = code;
+    reg->entry = entry;
+
+    if (entry_index >= count) { return false; }
+
+    memset(&t, 0, sizeof(t));
+    t.code = code;
+    t.start = he_alloc(sizeof(size_t), count);
+
+    if (he_stack_analysis_run(&t.a, code, entry_index)) {
+        int32_t low = 0;
+        int32_t high = 0;
+
+        for (size_t i = 0; i < count; ++i) {
+            if (t.a.low[i] < low) { low = t.a.low[i]; }
+            if (t.a.high[i] > high) { high = t.a.high[i]; }
+        }
+
+        // one extra slot above the highest register, DUP and LOAD_CONST write there
+        t.slot_base = low;
+        t.slots = he_alloc(sizeof(slot), (size_t)(high - low) + 2);
+
+        emit_all(&t);
+
+        reg->ops = t.ops;
+        reg->offsets = t.offsets;
+        reg->size = t.size;
+        reg->entry_op = t.start[entry_index];
+        reg->entry_low = t.a.low[entry_index];
+        reg->entry_high = t.a.high[entry_index];
+
+        he_free_array(t.slots);
+        ok = true;
+    }
+
+    he_stack_analysis_destroy(&t.a);
+    he_free_array(t.start);
+
+    return ok;
+}
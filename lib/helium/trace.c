@@ -0,0 +1,95 @@
+#include "helium/trace.h"
+#include "helium/instruction.h"
+#include "helium/memory.h"
+#include <inttypes.h>
+
+void he_trace_init(he_trace *trace, size_t size) {
+    trace->entries = NULL;
+    trace->mask = 0;
+    trace->count = 0;
+
+    if (size == 0) { return; }
+
+    size_t capacity = 1;
+
+    while (capacity < size) {
+        capacity <<= 1;
+    }
+
+    trace->entries = he_alloc(sizeof(he_trace_entry), capacity);
+    trace->mask = capacity - 1;
+}
+
+void he_trace_destroy(he_trace *trace) {
+    he_free_array(trace->entries);
+
+    trace->entries = NULL;
+    trace->mask = 0;
+    trace->count = 0;
+}
+
+void he_trace_clear(he_trace *trace) {
+    trace->count = 0;
+}
+
+/** @brief How many of the last @p count instructions a trace still holds */
+static size_t he_trace_held(const he_trace *trace, size_t count) {
+    if (!trace->entries) { return 0; }
+
+    if (count > trace->mask + 1) { count = trace->mask + 1; }
+
+    return trace->count < count ? (size_t)trace->count : count;
+}
+
+size_t he_trace_last(const he_trace *trace, he_trace_entry *entries, size_t count) {
+    count = he_trace_held(trace, count);
+
+    uint64_t first = trace->count - count;
+
+    for (size_t i = 0; i < count; ++i) {
+        entries[i] = trace->entries[(first + i) & trace->mask];
+    }
+
+    return count;
+}
+
+/** @brief Writes the top of the stack for he_trace_print */
+static int print_top(const he_trace_entry *entry, FILE *file) {
+    if (entry->depth == 0) { return fprintf(file, "empty"); }
+
+    const he_value *top = &entry->top;
+
+    switch (he_val_type(top)) {
+        case TYPE_BOOL:
+            return fprintf(file, "bool: %s", he_val_as_bool(top) ? "true" : "false");
+        case TYPE_INT:
+            return fprintf(file, "integer: %" PRId64, he_val_as_int(top));
+        case TYPE_FLOAT:
+            return fprintf(file, "fp: %g", he_val_as_float(top));
+        case TYPE_STRING:
+            // the string may be gone by now, so only its address is safe to show
+            return fprintf(file, "string: %p", (const void *)he_val_as_string(top));
+        case TYPE_OBJECT:
+            return fprintf(file, "object: %p", he_val_as_object(top));
+    }
+
+    return 0;
+}
+
+bool he_trace_print(const he_trace *trace, size_t count, FILE *file) {
+    count = he_trace_held(trace, count);
+
+    // each line starts with the instruction's number in the whole run
+    for (uint64_t i = trace->count - count; i != trace->count; ++i) {
+        const he_trace_entry *entry = &trace->entries[i & trace->mask];
+        const char *name = he_opcode_name((he_opcode)entry->opcode);
+
+        if (fprintf(file, "%12" PRIu64 " %08zx %-24s %6" PRIu32 " ", i, entry->pc, name,
+                    entry->depth) < 0 ||
+            print_top(entry, file) < 0 || fputc('\n', file) == EOF) {
+            return false;
+        }
+    }
+
+    return true;
+}
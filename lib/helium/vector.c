@@ -5,7 +5,17 @@
 #include <string.h>
 
 void he_vector_resize(he_vector *vec) {
-    void *ptr = he_grow_array(vec->array, vec->type_size, &vec->capacity);
+    void *ptr;
+
+    if (vec->arena) {
+        size_t old_capacity = vec->capacity;
+
+        vec->capacity = (old_capacity == 0) ? 8 : old_capacity * 2;
+        ptr = he_arena_realloc(vec->arena, vec->array, old_capacity * vec->type_size,
+                               vec->capacity * vec->type_size);
+    } else {
+        ptr = he_grow_array(vec->array, vec->type_size, &vec->capacity);
+    }
 
     if (!ptr) {
         fprintf(stderr, "he_vector_resize: Unable to expand array!\n");
@@ -16,10 +26,15 @@ void he_vector_resize(he_vector *vec) {
 }
 
 void he_vector_init(he_vector *vec, size_t type_size) {
+    he_vector_init_arena(vec, type_size, NULL);
+}
+
+void he_vector_init_arena(he_vector *vec, size_t type_size, struct he_arena *arena) {
     vec->array = NULL;
     vec->capacity = 0;
     vec->size = 0;
     vec->type_size = type_size;
+    vec->arena = arena;
 }
 
 void he_vector_init_prealloc(he_vector *vec, size_t type_size, size_t capacity) {
@@ -37,9 +52,9 @@ void he_vector_init_prealloc(he_vector *vec, size_t type_size, size_t capacity)
 }
 
 void he_vector_destroy(he_vector *vec) {
-    he_free_array(vec->array);
+    if (!vec->arena) { he_free_array(vec->array); }
 
-    he_vector_init(vec, vec->type_size);
+    he_vector_init_arena(vec, vec->type_size, vec->arena);
 }
 
 void he_vector_pop(he_vector *vec, void *dest) {
@@ -0,0 +1,212 @@
+#include "helium/verify.h"
+#include "helium/analysis.h"
+#include "helium/code.h"
+#include "helium/memory.h"
+#include <string.h>
+
+/** @brief The calls one function makes, and what's been worked out about it so far */
+typedef struct function_state {
+    /** @brief 0 if not visited yet, 1 while its callees are being visited, 2 once done */
+    int state;
+
+    /** @brief Where the function is on the depth first search's stack while it's there */
+    size_t position;
+
+    /** @brief The next call site to look at, an index into the call site array */
+    size_t next_call;
+
+    /** @brief One past the function's last call site */
+    size_t calls_end;
+
+    /** @brief Whether the function can reach a call cycle */
+    bool unbounded;
+
+    /** @brief The lowest slot it or anything it calls touches, relative to its frame */
+    int64_t lowest;
+
+    /** @brief One past the highest slot it or anything it calls touches */
+    int64_t highest;
+
+    /** @brief The most return addresses it and its callees push */
+    int64_t returns;
+} function_state;
+
+static void start_function(function_state *fns, const he_stack_analysis *a, size_t *stack,
+                           size_t *stack_size, size_t fn) {
+    fns[fn].state = 1;
+    fns[fn].position = *stack_size;
+    fns[fn].unbounded = false;
+    fns[fn].lowest = a->low[fn];
+    fns[fn].highest = a->high[fn];
+    fns[fn].returns = 0;
+
+    stack[(*stack_size)++] = fn;
+}
+
+/**
+ * @brief Works out how much of each stack every function reachable from the entry point
+ * uses, following calls depth first. A function that can reach a call cycle has no bound
+ */
+static void bound_calls(he_module *mod, const he_stack_analysis *a) {
+    const he_code *code = a->code;
+    size_t count = code->size + 1;
+    function_state *fns = he_alloc(sizeof(function_state), count);
+    size_t *first_call = he_alloc(sizeof(size_t), count + 1);
+    size_t *sites = NULL;
+    size_t *stack = he_alloc(sizeof(size_t), count);
+    size_t stack_size = 0;
+    size_t function_count = 0;
+
+    // group the reachable call sites by the function they're in
+    for (size_t i = 0; i <= count; ++i) {
+        first_call[i] = 0;
+    }
+
+    for (size_t i = 0; i < code->size; ++i) {
+        if (code->ops[i].op == OP_CALL && a->depth[i] != HE_DEPTH_UNKNOWN) {
+            ++first_call[a->owner[i] + 1];
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        first_call[i + 1] += first_call[i];
+        fns[i].state = 0;
+        fns[i].next_call = first_call[i];
+    }
+
+    sites = he_alloc(sizeof(size_t), first_call[count] + 1);
+
+    for (size_t i = 0; i < code->size; ++i) {
+        if (code->ops[i].op == OP_CALL && a->depth[i] != HE_DEPTH_UNKNOWN) {
+            sites[fns[a->owner[i]].next_call++] = i;
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        fns[i].calls_end = fns[i].next_call;
+        fns[i].next_call = first_call[i];
+    }
+
+    // every reachable function is reachable through calls from the entry point
+    start_function(fns, a, stack, &stack_size, 0);
+
+    while (stack_size != 0) {
+        function_state *fn = &fns[stack[stack_size - 1]];
+
+        if (fn->next_call == fn->calls_end) {
+            fn->state = 2;
+            ++function_count;
+            --stack_size;
+            continue;
+        }
+
+        size_t site = sites[fn->next_call];
+        size_t callee = code->ops[site].op_object.call.address;
+        function_state *callee_fn = &fns[callee];
+
+        if (callee_fn->state == 0) {
+            // come back to this call once the callee is done
+            start_function(fns, a, stack, &stack_size, callee);
+            continue;
+        }
+
+        ++fn->next_call;
+
+        if (callee_fn->state == 1) {
+            // everything from the callee up to here is part of a cycle
+            for (size_t i = callee_fn->position; i < stack_size; ++i) {
+                fns[stack[i]].unbounded = true;
+            }
+
+            continue;
+        }
+
+        int64_t depth = a->depth[site];
+
+        if (callee_fn->unbounded) { fn->unbounded = true; }
+        if (depth + callee_fn->lowest < fn->lowest) { fn->lowest = depth + callee_fn->lowest; }
+        if (depth + callee_fn->highest > fn->highest) { fn->highest = depth + callee_fn->highest; }
+        if (callee_fn->returns + 1 > fn->returns) { fn->returns = callee_fn->returns + 1; }
+    }
+
+    if (mod->arena) {
+        mod->functions = he_arena_alloc(mod->arena, sizeof(he_function_bounds) * function_count);
+    } else {
+        mod->functions = he_alloc(sizeof(he_function_bounds), function_count);
+    }
+
+    mod->function_count = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        const function_state *fn = &fns[i];
+
+        if (fn->state != 2) { continue; }
+
+        he_function_bounds *bounds = &mod->functions[mod->function_count++];
+        bounds->offset = code->offsets[i];
+        bounds->recursive = fn->unbounded;
+        bounds->stack_inputs = 0;
+        bounds->max_stack_depth = 0;
+        bounds->max_return_depth = 0;
+
+        if (!fn->unbounded) {
+            bounds->stack_inputs = (fn->lowest < 0) ? (size_t)-fn->lowest : 0;
+            bounds->max_stack_depth = (size_t)fn->highest;
+            bounds->max_return_depth = (size_t)fn->returns;
+        }
+    }
+
+    // the entry point is always the first function
+    mod->bounds = mod->functions[0];
+
+    he_free_array(fns);
+    he_free_array(first_call);
+    he_free_array(sites);
+    he_free_array(stack);
+}
+
+static bool reject(he_verify_error *error, const char *message, size_t offset) {
+    if (error) {
+        error->message = message;
+        error->offset = offset;
+    }
+
+    return false;
+}
+
+bool he_module_verify(he_module *mod, he_verify_error *error) {
+    he_code code;
+    he_stack_analysis analysis;
+
+    if (!mod->arena) { he_free_array(mod->functions); }
+
+    mod->verified = false;
+    mod->functions = NULL;
+    mod->function_count = 0;
+    memset(&mod->bounds, 0, sizeof(mod->bounds));
+
+    he_code_init(&code);
+
+    if (!he_code_translate(&code, mod)) {
+        return reject(error, code.error, code.error_offset);
+    }
+
+    if (!he_stack_analysis_run(&analysis, &code, 0)) {
+        size_t offset = code.offsets[analysis.error_index];
+        const char *message = analysis.error;
+
+        he_stack_analysis_destroy(&analysis);
+        he_code_destroy(&code);
+
+        return reject(error, message, offset);
+    }
+
+    // recursion doesn't make the code unsafe, only unbounded, so the module still passes
+    bound_calls(mod, &analysis);
+    mod->verified = true;
+
+    he_stack_analysis_destroy(&analysis);
+    he_code_destroy(&code);
+
+    return true;
+}
@@ -1,260 +1,589 @@
 #include "helium/vm.h"
+#include "helium/code.h"
 #include "helium/instruction.h"
+#include "helium/jit.h"
 #include "helium/memory.h"
+#include "helium/regcode.h"
 #include "helium/value.h"
+#include "jit_runtime.h"
 #include <setjmp.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-jmp_buf jump_buffer;
+#ifdef HE_PROFILE
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
 
-static void he_stack_init(he_stack *stack) {
-    he_vector_init(&stack->vec, sizeof(he_value));
+#define HE_PROFILE_UNIT "cycles"
 
-    stack->top = NULL;
+/** @brief Reads the clock he_vm_stats::time is measured with */
+static inline uint64_t he_profile_clock(void) {
+    return __rdtsc();
 }
+#else
+#include <time.h>
 
-static void he_stack_destroy(he_stack *stack) {
-    he_vector_destroy(&stack->vec);
+#define HE_PROFILE_UNIT "ns"
 
-    // return back to "no capacity" state
-    he_stack_init(stack);
+static inline uint64_t he_profile_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+#endif
+#endif
+
+/**
+ * @brief Reports an error on a VM, aborting whatever it was running
+ *
+ * Every VM has its own error environment, so VMs on different threads can fail
+ * independently of each other.
+ *
+ * @param vm The VM that hit the error
+ * @param message A static string describing the error
+ */
+_Noreturn static void he_vm_fail(he_vm *vm, const char *message) {
+    vm->error = message;
+
+    longjmp(vm->error_env, -1);
+}
+
+static void he_stack_overflow(he_vm *vm) {
+    he_vm_fail(vm, "stack overflow");
 }
 
-static void he_return_stack_init(he_return_stack *stack) {
-    he_vector_init(&stack->vec, sizeof(size_t));
+/** @brief Resizes a stack's array, from @p arena if there is one and the heap otherwise */
+static void *he_stack_realloc(he_arena *arena, void *array, size_t type_size,
+                              size_t old_length, size_t length) {
+    if (arena) {
+        return he_arena_realloc(arena, array, old_length * type_size, length * type_size);
+    }
 
-    stack->top = NULL;
+    return he_resize_array(array, type_size, length);
 }
 
-static void he_return_stack_destroy(he_return_stack *stack) {
-    he_vector_destroy(&stack->vec);
+static void he_stack_init(he_stack *stack, size_t max_size, he_arena *arena) {
+    size_t size = (max_size < HE_INITIAL_STACK_SIZE) ? max_size : HE_INITIAL_STACK_SIZE;
 
-    // set it back to the "no capacity" state
-    he_return_stack_init(stack);
+    stack->base = he_stack_realloc(arena, NULL, sizeof(he_value), 0, size);
+    stack->sp = stack->base;
+    stack->limit = stack->base + size;
+    stack->max_size = max_size;
 }
 
-static void he_stack_push(he_stack *stack, he_value val) {
-    he_vector_push_val(&stack->vec, val);
+/** @brief Reallocates a stack to hold exactly @p size values, keeping the ones on it */
+static void he_stack_resize(he_stack *stack, size_t size, he_arena *arena) {
+    size_t used = stack->sp - stack->base;
+    size_t old_size = stack->limit - stack->base;
+
+    assert(size >= used && "resizing would drop values off the stack");
 
-    stack->top = he_vector_last(&stack->vec);
+    stack->base = he_stack_realloc(arena, stack->base, sizeof(he_value), old_size, size);
+    stack->sp = stack->base + used;
+    stack->limit = stack->base + size;
 }
 
-static void he_return_stack_push(he_return_stack *stack, size_t pc) {
-    he_vector_push_val(&stack->vec, pc);
+/** @brief Picks how big a stack grows to so it has room for @p count more entries */
+static size_t he_grown_size(size_t size, size_t used, size_t count, size_t max_size) {
+    size_t grown = (size * 2 > used + count) ? size * 2 : used + count;
 
-    stack->top = he_vector_last(&stack->vec);
+    return (grown > max_size) ? max_size : grown;
 }
 
-static he_value he_stack_pop(he_stack *stack) {
-    he_value val;
+/**
+ * @brief Grows the data stack until @p count more values fit above @p sp, which the
+ * interpreter loops keep in a local
+ *
+ * Fails with a stack overflow if that would take it past its maximum size.
+ *
+ * @return Where @p sp is in the grown stack
+ */
+static he_value *he_stack_reserve(he_vm *vm, he_value *sp, size_t count) {
+    he_stack *stack = &vm->stack;
+    size_t used = sp - stack->base;
+    size_t size = stack->limit - stack->base;
+
+    if (size - used >= count) { return sp; }
+    if (stack->max_size - used < count) { he_stack_overflow(vm); }
+
+    stack->sp = sp;
+    he_stack_resize(stack, he_grown_size(size, used, count, stack->max_size), vm->arena);
+
+    return stack->sp;
+}
 
-    he_vector_pop(&stack->vec, &val);
+static void he_stack_destroy(he_stack *stack, he_arena *arena) {
+    if (!arena) { he_free_array(stack->base); }
 
-    return val;
+    stack->base = NULL;
+    stack->sp = NULL;
+    stack->limit = NULL;
+    stack->max_size = 0;
 }
 
-static size_t he_return_stack_pop(he_return_stack *stack) {
-    size_t val;
+static void he_return_stack_init(he_return_stack *stack, size_t max_size, he_arena *arena) {
+    size_t size =
+        (max_size < HE_INITIAL_RETURN_STACK_SIZE) ? max_size : HE_INITIAL_RETURN_STACK_SIZE;
+
+    stack->base = he_stack_realloc(arena, NULL, sizeof(size_t), 0, size);
+    stack->sp = stack->base;
+    stack->limit = stack->base + size;
+    stack->max_size = max_size;
+}
+
+/** @brief Reallocates a return stack to hold exactly @p size addresses, keeping the ones on it */
+static void he_return_stack_resize(he_return_stack *stack, size_t size, he_arena *arena) {
+    size_t used = stack->sp - stack->base;
+    size_t old_size = stack->limit - stack->base;
 
-    he_vector_pop(&stack->vec, &val);
+    assert(size >= used && "resizing would drop addresses off the return stack");
 
-    return val;
+    stack->base = he_stack_realloc(arena, stack->base, sizeof(size_t), old_size, size);
+    stack->sp = stack->base + used;
+    stack->limit = stack->base + size;
 }
 
-static size_t read_address(he_vm *vm) {
-    const he_module *mod = vm->mod;
+/**
+ * @brief Grows the return stack until @p count more addresses fit above @p rsp
+ * @return Where @p rsp is in the grown stack
+ */
+static size_t *he_return_stack_reserve(he_vm *vm, size_t *rsp, size_t count) {
+    he_return_stack *stack = &vm->ret_addrs;
+    size_t used = rsp - stack->base;
+    size_t size = stack->limit - stack->base;
 
-    // reads the byte array as a size_t array
-    // and returns the first, effectively
-    // reading the next 8 bytes (or 4 or however many it is) as a size_t
-    size_t *next_nativewidth_int = he_vector_at(&mod->ops, vm->pc);
+    if (size - used >= count) { return rsp; }
+    if (stack->max_size - used < count) { he_stack_overflow(vm); }
 
-    // so the bytes won't get read as bytecode
-    vm->pc += sizeof(size_t);
+    stack->sp = rsp;
+    he_return_stack_resize(stack, he_grown_size(size, used, count, stack->max_size), vm->arena);
 
-    return *next_nativewidth_int;
+    return stack->sp;
 }
 
-static he_value *he_stack_peek(he_stack *stack) {
-    return stack->top;
+static void he_return_stack_destroy(he_return_stack *stack, he_arena *arena) {
+    if (!arena) { he_free_array(stack->base); }
+
+    stack->base = NULL;
+    stack->sp = NULL;
+    stack->limit = NULL;
+    stack->max_size = 0;
 }
 
-#define IS_TYPE(expr)                                                                              \
-    assert(expr == TYPE_BOOL || expr == TYPE_INT || expr == TYPE_FLOAT || expr == TYPE_STRING ||   \
-           expr == TYPE_OBJECT && "type is not a valid value!")
+static void he_stack_push(he_vm *vm, he_value val) {
+    he_stack *stack = &vm->stack;
 
-static void he_val_add(he_value *top, he_value second) {
-    IS_TYPE(top->type);
+    if (stack->sp == stack->limit) { stack->sp = he_stack_reserve(vm, stack->sp, 1); }
 
-    if (top->type != second.type) {
-        // can't add two mismatched types, at least not at this level
-        fputs("he_val_add: types mismatched!", stderr);
-        longjmp(jump_buffer, -1);
-    }
+    *stack->sp++ = val;
+}
 
-    switch (top->type) {
-        case TYPE_INT:
-            top->as.integer = he_val_as_int(top) + he_val_as_int(&second);
-            break;
-        case TYPE_FLOAT:
-            top->as.floating = he_val_as_float(top) + he_val_as_float(&second);
-            break;
-        default:
-            fputs("he_val_add: unable to + type!", stderr);
-            longjmp(jump_buffer, -1);
+static void he_return_stack_push(he_vm *vm, size_t pc) {
+    he_return_stack *stack = &vm->ret_addrs;
+
+    if (stack->sp == stack->limit) { stack->sp = he_return_stack_reserve(vm, stack->sp, 1); }
+
+    *stack->sp++ = pc;
+}
+
+static he_value he_stack_pop(he_stack *stack) {
+    assert(stack->sp != stack->base && "attempting to pop from empty stack");
+
+    return *--stack->sp;
+}
+
+static size_t he_return_stack_pop(he_return_stack *stack) {
+    assert(stack->sp != stack->base && "attempting to return with an empty return stack");
+
+    return *--stack->sp;
+}
+
+static size_t read_address(he_vm *vm) {
+    const he_module *mod = vm->mod;
+    size_t operand;
+
+    // moves the pc past the operand so it won't get read as bytecode
+    if (!he_module_read_int(mod->ops.array, mod->ops.size, &vm->pc, &operand)) {
+        he_vm_fail(vm, "read_address: operand runs past the end of the module");
     }
+
+    return operand;
 }
 
-#define ARITHMETIC_OP(op_name, op)                                                                 \
+static he_value *he_stack_peek(he_stack *stack) {
+    assert(stack->sp != stack->base && "attempting to peek empty stack");
+
+    return stack->sp - 1;
+}
+
+#define IS_TYPE(val)                                                                               \
+    assert((he_val_type(val) == TYPE_BOOL || he_val_type(val) == TYPE_INT ||                       \
+               he_val_type(val) == TYPE_FLOAT || he_val_type(val) == TYPE_STRING ||                \
+               he_val_type(val) == TYPE_OBJECT) &&                                                 \
+           "type is not a valid value!")
+
+// integer results that overflow what a he_value can hold are promoted to floats,
+// he_val_from_int takes care of the values that fit in an int64_t but not in a he_value
+#define INTEGER_OP(builtin, op)                                                                    \
     do {                                                                                           \
-        IS_TYPE(top->type);                                                                        \
+        int64_t lhs = he_val_as_int(top);                                                          \
+        int64_t rhs = he_val_as_int(&second);                                                      \
+        int64_t result;                                                                            \
                                                                                                    \
-        if (top->type != second.type) {                                                            \
-            fputs("he_val_" #op_name ": types mismatched!\n", stderr);                             \
-            longjmp(jump_buffer, -1);                                                              \
+        if (builtin(lhs, rhs, &result)) {                                                          \
+            *top = he_val_from_float((double)lhs op (double)rhs);                                  \
+        } else {                                                                                   \
+            *top = he_val_from_int(result);                                                        \
         }                                                                                          \
+    } while (false)
+
+#define ARITHMETIC_OP(op_name, builtin, op)                                                        \
+    do {                                                                                           \
+        IS_TYPE(top);                                                                              \
                                                                                                    \
-        switch (top->type) {                                                                       \
+        if (he_val_type(top) != he_val_type(&second)) {                                            \
+            he_vm_fail(vm, "he_val_" #op_name ": types mismatched");                               \
+        }                                                                                          \
+                                                                                                   \
+        switch (he_val_type(top)) {                                                                \
             case TYPE_INT:                                                                         \
-                top->as.integer = he_val_as_int(top) op he_val_as_int(&second);                    \
+                INTEGER_OP(builtin, op);                                                           \
                 break;                                                                             \
             case TYPE_FLOAT:                                                                       \
-                top->as.floating = he_val_as_float(top) op he_val_as_float(&second);               \
+                *top = he_val_from_float(he_val_as_float(top) op he_val_as_float(&second));        \
                 break;                                                                             \
             default:                                                                               \
-                fputs("he_val_" #op_name ": unable to " #op " type!", stderr);                     \
-                longjmp(jump_buffer, -1);                                                          \
+                he_vm_fail(vm, "he_val_" #op_name ": unable to " #op " type");                     \
         }                                                                                          \
     } while (false)
 
-static void he_val_sub(he_value *top, he_value second) {
-    ARITHMETIC_OP(sub, -);
+#define COMPARISON_OP(op_name, op)                                                                 \
+    do {                                                                                           \
+        IS_TYPE(top);                                                                              \
+                                                                                                   \
+        if (he_val_type(top) != he_val_type(&second)) {                                            \
+            he_vm_fail(vm, "he_val_" #op_name ": types mismatched");                               \
+        }                                                                                          \
+                                                                                                   \
+        switch (he_val_type(top)) {                                                                \
+            case TYPE_INT:                                                                         \
+                *top = he_val_from_bool(he_val_as_int(top) op he_val_as_int(&second));             \
+                break;                                                                             \
+            case TYPE_FLOAT:                                                                       \
+                *top = he_val_from_bool(he_val_as_float(top) op he_val_as_float(&second));         \
+                break;                                                                             \
+            default:                                                                               \
+                he_vm_fail(vm, "he_val_" #op_name ": unable to " #op " type");                     \
+        }                                                                                          \
+    } while (false)
+
+static void he_val_add(he_vm *vm, he_value *top, he_value second) {
+    ARITHMETIC_OP(add, __builtin_add_overflow, +);
 }
 
-static void he_val_mul(he_value *top, he_value second) {
-    ARITHMETIC_OP(mul, *);
+static void he_val_sub(he_vm *vm, he_value *top, he_value second) {
+    ARITHMETIC_OP(sub, __builtin_sub_overflow, -);
 }
 
-static void he_val_div(he_value *top, he_value second) {
-    ARITHMETIC_OP(div, /);
+static void he_val_mul(he_vm *vm, he_value *top, he_value second) {
+    ARITHMETIC_OP(mul, __builtin_mul_overflow, *);
 }
 
-static void he_val_mod(he_value *top, he_value second) {
-    IS_TYPE(top->type);
+static void he_val_div(he_vm *vm, he_value *top, he_value second) {
+    IS_TYPE(top);
 
-    if (top->type != second.type) {
+    if (he_val_type(top) != he_val_type(&second)) {
+        he_vm_fail(vm, "he_val_div: types mismatched");
+    }
+
+    switch (he_val_type(top)) {
+        case TYPE_INT: {
+            int64_t lhs = he_val_as_int(top);
+            int64_t rhs = he_val_as_int(&second);
+
+            if (rhs == 0) { he_vm_fail(vm, "he_val_div: division by zero"); }
+
+            // INT64_MIN / -1 is the only quotient that can overflow
+            if (rhs == -1 && lhs == INT64_MIN) {
+                *top = he_val_from_float(-(double)lhs);
+            } else {
+                *top = he_val_from_int(lhs / rhs);
+            }
+            break;
+        }
+        case TYPE_FLOAT:
+            *top = he_val_from_float(he_val_as_float(top) / he_val_as_float(&second));
+            break;
+        default:
+            he_vm_fail(vm, "he_val_div: unable to / type");
+    }
+}
+
+static void he_val_mod(he_vm *vm, he_value *top, he_value second) {
+    IS_TYPE(top);
+
+    if (he_val_type(top) != he_val_type(&second)) {
         // can't add two mismatched types, at least not at this level
-        fputs("he_val_mod: types mismatched!", stderr);
-        longjmp(jump_buffer, -1);
+        he_vm_fail(vm, "he_val_mod: types mismatched");
     }
 
-    if (top->type == TYPE_INT) {
-        top->as.integer = he_val_as_int(top) % he_val_as_int(&second);
+    if (he_val_is_int(top)) {
+        int64_t rhs = he_val_as_int(&second);
+
+        if (rhs == 0) { he_vm_fail(vm, "he_val_mod: division by zero"); }
+
+        // INT64_MIN % -1 traps on x86 even though the result is just 0
+        *top = he_val_from_int(rhs == -1 ? 0 : he_val_as_int(top) % rhs);
         return;
     }
 
-    fputs("he_val_mod: unable to %% type!", stderr);
-    longjmp(jump_buffer, -1);
+    he_vm_fail(vm, "he_val_mod: unable to % type");
 }
 
-static void he_val_gt(he_value *top, he_value second) {
-    ARITHMETIC_OP(gt, >);
+static void he_val_gt(he_vm *vm, he_value *top, he_value second) {
+    COMPARISON_OP(gt, >);
 }
 
-static void he_val_lt(he_value *top, he_value second) {
-    ARITHMETIC_OP(lt, <);
+static void he_val_lt(he_vm *vm, he_value *top, he_value second) {
+    COMPARISON_OP(lt, <);
 }
 
-static void he_val_gteq(he_value *top, he_value second) {
-    ARITHMETIC_OP(gteq, >=);
+static void he_val_gteq(he_vm *vm, he_value *top, he_value second) {
+    COMPARISON_OP(gteq, >=);
 }
 
-static void he_val_lteq(he_value *top, he_value second) {
-    ARITHMETIC_OP(lteq, <=);
+static void he_val_lteq(he_vm *vm, he_value *top, he_value second) {
+    COMPARISON_OP(lteq, <=);
 }
 
-static void he_val_eq(he_value *top, he_value second) {
-    IS_TYPE(top->type);
-    IS_TYPE(second.type);
+static void he_val_eq(he_vm *vm, he_value *top, he_value second) {
+    IS_TYPE(top);
+    IS_TYPE(&second);
 
-    if (top->type != second.type) {
-        top->type = TYPE_BOOL;
-        top->as.boolean = false;
+    if (he_val_type(top) != he_val_type(&second)) {
+        *top = he_val_from_bool(false);
         return;
     }
 
-    switch (top->type) {
+    switch (he_val_type(top)) {
         case TYPE_BOOL:
-            top->as.boolean = he_val_as_bool(top) == he_val_as_bool(&second);
+            *top = he_val_from_bool(he_val_as_bool(top) == he_val_as_bool(&second));
             break;
         case TYPE_INT:
-            top->as.boolean = he_val_as_int(top) == he_val_as_int(&second);
+            *top = he_val_from_bool(he_val_as_int(top) == he_val_as_int(&second));
             break;
         case TYPE_FLOAT:
-            top->as.boolean = he_val_as_float(top) == he_val_as_float(&second);
+            *top = he_val_from_bool(he_val_as_float(top) == he_val_as_float(&second));
             break;
-        case TYPE_STRING:
-            top->as.boolean = (strcmp(he_val_as_string(top), he_val_as_string(&second))) == 0;
+        case TYPE_STRING: {
+            bool equal = he_string_equal(he_val_as_string(top), he_val_as_string(&second));
+
+            *top = he_val_from_bool(equal);
             break;
+        }
         default:
-            fputs("he_val_eq: unable to == type!", stderr);
-            longjmp(jump_buffer, -1);
+            he_vm_fail(vm, "he_val_eq: unable to == type");
     }
-
-    top->type = TYPE_BOOL;
 }
 
-static void he_val_not(he_value *top) {
-    IS_TYPE(top->type);
+static void he_val_not(he_vm *vm, he_value *top) {
+    IS_TYPE(top);
 
     if (!he_val_is_bool(top)) {
-        fputs("he_val_not: unable to 'not' type!", stderr);
-        longjmp(jump_buffer, -1);
+        he_vm_fail(vm, "he_val_not: unable to 'not' type");
     }
 
-    top->as.boolean = !top->as.boolean;
+    *top = he_val_from_bool(!he_val_as_bool(top));
 }
 
-static void he_val_negate(he_value *top) {
-    IS_TYPE(top->type);
+static void he_val_negate(he_vm *vm, he_value *top) {
+    IS_TYPE(top);
 
-    switch (top->type) {
-        case TYPE_INT:
-            top->as.integer = -he_val_as_int(top);
+    switch (he_val_type(top)) {
+        case TYPE_INT: {
+            int64_t integer = he_val_as_int(top);
+
+            *top = (integer == INT64_MIN) ? he_val_from_float(-(double)integer)
+                                          : he_val_from_int(-integer);
             break;
+        }
         case TYPE_FLOAT:
-            top->as.floating = -he_val_as_float(top);
+            *top = he_val_from_float(-he_val_as_float(top));
             break;
         default:
-            fputs("he_val_add: unable to + type!", stderr);
-            longjmp(jump_buffer, -1);
+            he_vm_fail(vm, "he_val_negate: unable to negate type");
     }
 }
 
-static bool he_jmp_result(he_value *top) {
-    IS_TYPE(top->type);
+static bool he_jmp_result(he_vm *vm, he_value *top) {
+    IS_TYPE(top);
 
     if (!he_val_is_bool(top)) {
-        fputs("he_jmp_result: unable to jmp based on non-bool!", stderr);
-        longjmp(jump_buffer, -1);
+        he_vm_fail(vm, "he_jmp_result: unable to jmp based on non-bool");
+    }
+
+    return he_val_as_bool(top);
+}
+
+// what machine code from jit.c calls, the values are where the interpreter loops keep them
+#define JIT_BINARY(op_name)                                                                        \
+    void he_jit_rt_##op_name(he_vm *vm, he_value *sp) {                                            \
+        he_val_##op_name(vm, sp - 2, sp[-1]);                                                      \
+    }
+
+JIT_BINARY(add)
+JIT_BINARY(sub)
+JIT_BINARY(mul)
+JIT_BINARY(div)
+JIT_BINARY(mod)
+JIT_BINARY(gt)
+JIT_BINARY(lt)
+JIT_BINARY(gteq)
+JIT_BINARY(lteq)
+JIT_BINARY(eq)
+
+#undef JIT_BINARY
+
+void he_jit_rt_not(he_vm *vm, he_value *sp) {
+    he_val_not(vm, sp - 1);
+}
+
+void he_jit_rt_negate(he_vm *vm, he_value *sp) {
+    he_val_negate(vm, sp - 1);
+}
+
+void he_jit_rt_add_const(he_vm *vm, he_value *sp, const he_value *constant) {
+    he_val_add(vm, sp - 1, *constant);
+}
+
+void he_jit_rt_sub_const(he_vm *vm, he_value *sp, const he_value *constant) {
+    he_val_sub(vm, sp - 1, *constant);
+}
+
+bool he_jit_rt_truth(he_vm *vm, he_value *sp) {
+    return he_jmp_result(vm, sp - 1);
+}
+
+he_value *he_jit_rt_reserve(he_vm *vm, he_value *sp) {
+    return he_stack_reserve(vm, sp, 1);
+}
+
+size_t *he_jit_rt_reserve_return(he_vm *vm, size_t *rsp) {
+    return he_return_stack_reserve(vm, rsp, 1);
+}
+
+_Noreturn void he_jit_rt_return_underflow(he_vm *vm) {
+    he_vm_fail(vm, "he_vm_run: return stack underflow");
+}
+
+bool he_vm_evaluate(he_opcode op, he_value *top, he_value second) {
+    // only the error environment of this VM is ever touched
+    he_vm vm;
+    he_value result = *top;
+
+    vm.error = NULL;
+
+    if (setjmp(vm.error_env) == -1) { return false; }
+
+    switch (op) {
+        case OP_ADD:
+            he_val_add(&vm, &result, second);
+            break;
+        case OP_SUB:
+            he_val_sub(&vm, &result, second);
+            break;
+        case OP_MUL:
+            he_val_mul(&vm, &result, second);
+            break;
+        case OP_DIV:
+            he_val_div(&vm, &result, second);
+            break;
+        case OP_MOD:
+            he_val_mod(&vm, &result, second);
+            break;
+        case OP_GT:
+            he_val_gt(&vm, &result, second);
+            break;
+        case OP_LT:
+            he_val_lt(&vm, &result, second);
+            break;
+        case OP_GTEQ:
+            he_val_gteq(&vm, &result, second);
+            break;
+        case OP_LTEQ:
+            he_val_lteq(&vm, &result, second);
+            break;
+        case OP_EQ:
+            he_val_eq(&vm, &result, second);
+            break;
+        case OP_NOT:
+            he_val_not(&vm, &result);
+            break;
+        case OP_NEGATE:
+            he_val_negate(&vm, &result);
+            break;
+        default:
+            return false;
     }
 
-    return top->as.boolean;
+    *top = result;
+
+    return true;
+}
+
+he_vm_config he_vm_default_config(void) {
+    he_vm_config config;
+
+    config.stack_size = HE_DEFAULT_STACK_SIZE;
+    config.return_stack_size = HE_DEFAULT_RETURN_STACK_SIZE;
+    config.engine = ENGINE_STACK;
+    config.arena = NULL;
+    config.nursery_size = HE_DEFAULT_NURSERY_SIZE;
+    config.hot.loop_threshold = 0;
+    config.hot.call_threshold = 0;
+    config.hot.on_hot = NULL;
+    config.hot.data = NULL;
+    config.trace_size = 0;
+
+    return config;
 }
 
 void he_vm_init(he_vm *vm) {
-    he_stack_init(&vm->stack);
-    he_return_stack_init(&vm->ret_addrs);
+    he_vm_config config = he_vm_default_config();
+
+    he_vm_init_config(vm, &config);
+}
 
+void he_vm_init_config(he_vm *vm, const he_vm_config *config) {
+    he_stack_init(&vm->stack, config->stack_size, config->arena);
+    he_return_stack_init(&vm->ret_addrs, config->return_stack_size, config->arena);
+    he_code_init(&vm->code);
+    he_reg_code_init(&vm->reg_code);
+    he_jit_code_init(&vm->jit);
+    he_heap_init(&vm->heap, config->nursery_size);
+    he_trace_init(&vm->trace, config->trace_size);
+
+    vm->engine = config->engine;
+    vm->arena = config->arena;
+    vm->hot = config->hot;
     vm->pc = 0;
+    vm->indexed = false;
+
+    he_vm_stats_reset(vm);
     vm->mod = NULL;
+    vm->error = NULL;
 }
 
 void he_vm_destroy(he_vm *vm) {
-    he_stack_destroy(&vm->stack);
-    he_return_stack_destroy(&vm->ret_addrs);
+    he_stack_destroy(&vm->stack, vm->arena);
+    he_return_stack_destroy(&vm->ret_addrs, vm->arena);
+    he_code_destroy(&vm->code);
+    he_reg_code_destroy(&vm->reg_code);
+    he_jit_code_destroy(&vm->jit);
+    he_heap_destroy(&vm->heap);
+    he_trace_destroy(&vm->trace);
 
     vm->pc = 0;
     vm->mod = NULL;
@@ -263,17 +592,163 @@ void he_vm_destroy(he_vm *vm) {
 #define BINARY(op_name)                                                                            \
     do {                                                                                           \
         he_value second = he_stack_pop(&vm->stack);                                                \
-        he_val_##op_name(he_stack_peek(&vm->stack), second);                                       \
+        he_val_##op_name(vm, he_stack_peek(&vm->stack), second);                                   \
     } while (false)
 
 #define UNARY(op_name)                                                                             \
     do {                                                                                           \
-        he_val_##op_name(he_stack_peek(&vm->stack));                                               \
+        he_val_##op_name(vm, he_stack_peek(&vm->stack));                                           \
     } while (false)
 
+void he_vm_reset(he_vm *vm) {
+    vm->stack.sp = vm->stack.base;
+    vm->ret_addrs.sp = vm->ret_addrs.base;
+    vm->pc = 0;
+    vm->error = NULL;
+}
+
+/** @brief Marks the values a VM refers to, a he_heap_roots_fn */
+static void he_vm_mark_roots(he_heap *heap, void *data) {
+    he_vm *vm = data;
+
+    he_heap_mark_values(heap, vm->stack.base, vm->stack.sp - vm->stack.base);
+
+    if (vm->mod) {
+        const he_vector *pool = &vm->mod->pool;
+
+        he_heap_mark_values(heap, (const he_value *)pool->array, pool->size);
+    }
+}
+
+void he_vm_collect(he_vm *vm, he_gc_kind kind) {
+    he_heap_collect(&vm->heap, kind, he_vm_mark_roots, vm);
+}
+
+/** @brief Runs the collection the VM's heap asked for, if it asked for one */
+static void he_vm_collect_pending(he_vm *vm) {
+    if (vm->heap.pending) { he_vm_collect(vm, vm->heap.pending_kind); }
+}
+
+he_value he_vm_new_string(he_vm *vm, const char *chars, size_t length) {
+    he_vm_collect_pending(vm);
+
+    return he_heap_string(&vm->heap, chars, length);
+}
+
+he_value he_vm_new_array(he_vm *vm, size_t length) {
+    he_vm_collect_pending(vm);
+
+    return he_heap_array(&vm->heap, length);
+}
+
+he_value he_vm_new_data(he_vm *vm, size_t size) {
+    he_vm_collect_pending(vm);
+
+    return he_heap_data(&vm->heap, size);
+}
+
+/**
+ * @brief Resizes the VM's stacks to exactly what a verified module can use on top of
+ * what's already on them, leaving them alone if the module's use isn't bounded
+ */
+static void he_vm_fit_stacks(he_vm *vm, const he_module *mod) {
+    const he_function_bounds *bounds = &mod->bounds;
+
+    if (!mod->verified || bounds->recursive) { return; }
+
+    size_t values = vm->stack.sp - vm->stack.base;
+    size_t returns = vm->ret_addrs.sp - vm->ret_addrs.base;
+
+    // values the code pops have to be pushed before it runs, leave room for them too
+    if (values < bounds->stack_inputs) { values = bounds->stack_inputs; }
+
+    values += bounds->max_stack_depth;
+    returns += bounds->max_return_depth;
+
+    // past the maximum the checked loop runs instead and reports the overflow
+    if (values > vm->stack.max_size) { values = vm->stack.max_size; }
+    if (returns > vm->ret_addrs.max_size) { returns = vm->ret_addrs.max_size; }
+
+    // an empty allocation can't be told apart from a failed one
+    if (values == 0) { values = 1; }
+    if (returns == 0) { returns = 1; }
+
+    if (vm->stack.base + values != vm->stack.limit) {
+        he_stack_resize(&vm->stack, values, vm->arena);
+    }
+
+    if (vm->ret_addrs.base + returns != vm->ret_addrs.limit) {
+        he_return_stack_resize(&vm->ret_addrs, returns, vm->arena);
+    }
+}
+
 void he_vm_use(he_vm *vm, const he_module *mod) {
-    // may have more logic later
     vm->mod = mod;
+
+    he_vm_fit_stacks(vm, mod);
+
+    // decoding happens here so that he_vm_run doesn't have to. if the bytecode is
+    // malformed the code is left empty and he_vm_run will report the failure
+    he_code_translate(&vm->code, mod);
+    he_reg_code_destroy(&vm->reg_code);
+    he_jit_code_destroy(&vm->jit);
+}
+
+bool he_vm_push_values(he_vm *vm, const he_value *values, size_t count) {
+    he_stack *stack = &vm->stack;
+    size_t used = stack->sp - stack->base;
+    size_t size = stack->limit - stack->base;
+
+    if (stack->max_size - used < count) { return false; }
+
+    if (size - used < count) {
+        he_stack_resize(stack, he_grown_size(size, used, count, stack->max_size), vm->arena);
+    }
+
+    memcpy(stack->sp, values, count * sizeof(he_value));
+    stack->sp += count;
+
+    return true;
+}
+
+bool he_vm_push_returns(he_vm *vm, const size_t *offsets, size_t count) {
+    he_return_stack *stack = &vm->ret_addrs;
+    size_t used = stack->sp - stack->base;
+    size_t size = stack->limit - stack->base;
+
+    if (count == 0) { return true; }
+
+    if (stack->max_size - used < count) { return false; }
+
+    if (size - used < count) {
+        he_return_stack_resize(stack, he_grown_size(size, used, count, stack->max_size),
+                               vm->arena);
+    }
+
+    memcpy(stack->sp, offsets, count * sizeof(size_t));
+    stack->sp += count;
+
+    return true;
+}
+
+bool he_vm_stats_enabled(void) {
+#ifdef HE_PROFILE
+    return true;
+#else
+    return false;
+#endif
+}
+
+const char *he_vm_stats_unit(void) {
+#ifdef HE_PROFILE
+    return HE_PROFILE_UNIT;
+#else
+    return "ns";
+#endif
+}
+
+void he_vm_stats_reset(he_vm *vm) {
+    memset(&vm->stats, 0, sizeof(vm->stats));
 }
 
 he_interpret_flag he_vm_execute_instruction(he_vm *vm, bool has_setjmp_env) {
@@ -281,13 +756,23 @@ he_interpret_flag he_vm_execute_instruction(he_vm *vm, bool has_setjmp_env) {
 
     // if a jmp_buf environment doesnt exist, one is created
     if (!has_setjmp_env) {
-        if (setjmp(jump_buffer) == -1) {
-            fputs("helium: exiting with critical error", stderr);
+        if (setjmp(vm->error_env) == -1) {
+            fprintf(stderr, "helium: exiting with critical error: %s\n", vm->error);
             return INTERPRET_FAILURE;
         }
     }
 
-    uint8_t *instruction = he_vector_at(&vm->mod->ops, vm->pc++);
+#ifdef HE_PROFILE
+    uint64_t profile_start = he_profile_clock();
+#endif
+
+    uint8_t *instruction = he_vector_at(&vm->mod->ops, vm->pc);
+
+    if (vm->trace.entries) {
+        he_trace_record(&vm->trace, vm->pc, *instruction, vm->stack.base, vm->stack.sp);
+    }
+
+    ++vm->pc;
 
     switch (*instruction) {
         case OP_RET:
@@ -295,13 +780,13 @@ he_interpret_flag he_vm_execute_instruction(he_vm *vm, bool has_setjmp_env) {
             break;
         case OP_CALL: {
             size_t next_addr = read_address(vm);
-            he_return_stack_push(&vm->ret_addrs, vm->pc);
+            he_return_stack_push(vm, vm->pc);
             vm->pc = next_addr;
             break;
         }
         case OP_LOAD_CONST: {
             size_t const_addr = read_address(vm);
-            he_stack_push(&vm->stack, *(he_value *)he_vector_at(&vm->mod->pool, const_addr));
+            he_stack_push(vm, *(he_value *)he_vector_at(&vm->mod->pool, const_addr));
             break;
         }
         case OP_ADD:
@@ -344,45 +829,572 @@ he_interpret_flag he_vm_execute_instruction(he_vm *vm, bool has_setjmp_env) {
             vm->pc = read_address(vm);
             break;
         case OP_JZ: {
-            if (he_jmp_result(he_stack_peek(&vm->stack))) {
-                // next instructrion offset is a size_t integer
-                vm->pc = read_address(vm);
-            }
+            // the operand has to be consumed even if the jump isn't taken
+            size_t next_addr = read_address(vm);
+
+            if (he_jmp_result(vm, he_stack_peek(&vm->stack))) { vm->pc = next_addr; }
             break;
         }
         case OP_JNZ: {
-            if (!he_jmp_result(he_stack_peek(&vm->stack))) {
-                // next instructrion offset is a size_t integer
-                vm->pc = read_address(vm);
-            }
+            size_t next_addr = read_address(vm);
+
+            if (!he_jmp_result(vm, he_stack_peek(&vm->stack))) { vm->pc = next_addr; }
             break;
         }
         case OP_POP:
             he_stack_pop(&vm->stack);
             break;
+        case OP_DUP:
+            he_stack_push(vm, *he_stack_peek(&vm->stack));
+            break;
+        case OP_HALT:
+            // stay on the halt so that stepping again doesn't run past it
+            --vm->pc;
+            break;
+        case OP_LOAD_CONST_ADD: {
+            size_t const_addr = read_address(vm);
+            he_value *constant = he_vector_at(&vm->mod->pool, const_addr);
+            he_val_add(vm, he_stack_peek(&vm->stack), *constant);
+            break;
+        }
+        case OP_LOAD_CONST_SUB: {
+            size_t const_addr = read_address(vm);
+            he_value *constant = he_vector_at(&vm->mod->pool, const_addr);
+            he_val_sub(vm, he_stack_peek(&vm->stack), *constant);
+            break;
+        }
+        case OP_LT_JZ: {
+            size_t next_addr = read_address(vm);
+            BINARY(lt);
+
+            if (he_jmp_result(vm, he_stack_peek(&vm->stack))) { vm->pc = next_addr; }
+            break;
+        }
+        case OP_LT_JNZ: {
+            size_t next_addr = read_address(vm);
+            BINARY(lt);
+
+            if (!he_jmp_result(vm, he_stack_peek(&vm->stack))) { vm->pc = next_addr; }
+            break;
+        }
+        case OP_GT_JZ: {
+            size_t next_addr = read_address(vm);
+            BINARY(gt);
+
+            if (he_jmp_result(vm, he_stack_peek(&vm->stack))) { vm->pc = next_addr; }
+            break;
+        }
+        case OP_GT_JNZ: {
+            size_t next_addr = read_address(vm);
+            BINARY(gt);
+
+            if (!he_jmp_result(vm, he_stack_peek(&vm->stack))) { vm->pc = next_addr; }
+            break;
+        }
+        case OP_EQ_NOT:
+            BINARY(eq);
+            UNARY(not );
+            break;
         default:
-            fprintf(stderr, "he_vm_run: got unknown instruction! value: %hhx\n", *instruction);
-            longjmp(jump_buffer, -1);
+            he_vm_fail(vm, "he_vm_execute_instruction: got unknown instruction");
     }
 
+#ifdef HE_PROFILE
+    ++vm->stats.counts[*instruction];
+    vm->stats.time[*instruction] += he_profile_clock() - profile_start;
+#endif
+
     return INTERPRET_SUCCESS;
 }
 
+#if defined(HE_THREADED_DISPATCH) && defined(__GNUC__)
+#define HE_USE_COMPUTED_GOTO 1
+#else
+#define HE_USE_COMPUTED_GOTO 0
+#endif
+
+/**
+ * @brief Rewrites the pc and every return address from a byte offset to an instruction
+ * index, the form the stack interpreter and machine code run on
+ * @return The index of the instruction to start at
+ */
+static size_t he_vm_to_indices(he_vm *vm, const he_code *code) {
+    he_return_stack *stack = &vm->ret_addrs;
+    size_t index = he_code_index_of(code, vm->pc);
+
+    if (index > code->size) {
+        he_vm_fail(vm, "he_vm_run: pc is not at the start of an instruction");
+    }
+
+    for (size_t *addr = stack->base; addr != stack->sp; ++addr) {
+        size_t at = he_code_index_of(code, *addr);
+
+        if (at > code->size) {
+            // put back the ones already rewritten, the VM is left as it was handed over
+            for (size_t *done = stack->base; done != addr; ++done) {
+                *done = code->offsets[*done];
+            }
+
+            he_vm_fail(vm, "he_vm_run: return address is not an instruction");
+        }
+
+        *addr = at;
+    }
+
+    vm->pc = index;
+    vm->indexed = true;
+
+    return index;
+}
+
+/** @brief Rewrites the pc and every return address from an instruction index to a byte offset */
+static void he_vm_to_offsets(he_vm *vm, const he_code *code) {
+    he_return_stack *stack = &vm->ret_addrs;
+
+    for (size_t *addr = stack->base; addr != stack->sp; ++addr) {
+        *addr = code->offsets[*addr];
+    }
+
+    vm->pc = code->offsets[vm->pc];
+    vm->indexed = false;
+}
+
+/**
+ * @brief Counts a backward jump or call reaching an instruction, telling `on_hot` when
+ * the count reaches @p threshold
+ */
+static void he_vm_count_hit(he_vm *vm, he_op *op, he_hot_kind kind, uint32_t threshold) {
+    if (op->hits == UINT32_MAX) { return; }
+
+    if (++op->hits == threshold && vm->hot.on_hot) {
+        vm->hot.on_hot(vm, kind, vm->code.offsets[op - vm->code.ops], vm->hot.data);
+    }
+}
+
+size_t he_vm_hot_spots(const he_vm *vm, he_hot_spot *spots, size_t capacity) {
+    size_t count = 0;
+
+    for (size_t i = 0; i < vm->code.size; ++i) {
+        if (vm->code.ops[i].hits == 0) { continue; }
+
+        if (count < capacity) {
+            spots[count].offset = vm->code.offsets[i];
+            spots[count].hits = vm->code.ops[i].hits;
+        }
+
+        ++count;
+    }
+
+    return count;
+}
+
+/**
+ * @brief How many times an instruction can be quickened and go back to its generic form
+ * before the stack interpreter stops quickening it, so sites that see mixed types settle
+ */
+#define QUICKEN_DEOPT_LIMIT 4
+
+#define HE_LOOP_NAME he_vm_run_code
+#define HE_LOOP_CHECKED 1
+#define HE_LOOP_TRACED 0
+#include "vm_loop.h"
+
+#define HE_LOOP_NAME he_vm_run_unchecked
+#define HE_LOOP_CHECKED 0
+#define HE_LOOP_TRACED 0
+#include "vm_loop.h"
+
+#define HE_LOOP_NAME he_vm_run_traced
+#define HE_LOOP_CHECKED 1
+#define HE_LOOP_TRACED 1
+#include "vm_loop.h"
+
+/**
+ * @brief Rewrites the register interpreter's frames into byte offset return addresses
+ *
+ * Every frame is a (return instruction, caller frame offset) pair, only the first half
+ * means anything to the stack interpreter.
+ */
+static void he_reg_frames_to_offsets(he_return_stack *stack, const he_reg_code *reg) {
+    size_t *out = stack->base;
+
+    for (size_t *frame = stack->base; frame != stack->sp; frame += 2) {
+        // the return instruction is the one after the REG_CALL, but constants can mean the
+        // stack instruction it came from isn't the one after the OP_CALL
+        size_t call = he_code_index_of(reg->code, reg->offsets[frame[0] - 1]);
+
+        *out++ = reg->code->offsets[call + 1];
+    }
+
+    stack->sp = out;
+}
+
+/**
+ * @brief The register interpreter loop, runs register code until it reaches a REG_HALT
+ *
+ * Registers are the stack slots above a frame pointer, so the stack means the same thing
+ * to both interpreters whenever this exits. Each frame's register range is checked
+ * against the stack once, when the frame is entered, instead of on every access.
+ *
+ * @param vm The VM to run, its return stack must be empty
+ * @param reg The register form of the VM's code, starting at the VM's pc
+ */
+static void he_vm_run_registers(he_vm *vm, he_reg_code *reg) {
+    he_reg_op *const ops = reg->ops;
+    const he_reg_op *ip = ops + reg->entry_op;
+    he_value *base = vm->stack.base;
+    he_value *limit = vm->stack.limit;
+    he_value *fp = vm->stack.sp;
+    size_t *ret_limit = vm->ret_addrs.limit;
+    size_t *rsp = vm->ret_addrs.sp;
+
+    assert(rsp == vm->ret_addrs.base && "register code can't start inside a call");
+
+    if (fp - base + reg->entry_low < 0) { he_vm_fail(vm, "he_vm_run: stack underflow"); }
+
+    if (limit - fp < reg->entry_high) {
+        fp = he_stack_reserve(vm, fp, (size_t)reg->entry_high);
+        base = vm->stack.base;
+        limit = vm->stack.limit;
+    }
+
+#define REG_BINARY(op_name)                                                                        \
+    do {                                                                                           \
+        he_value lhs = fp[ip->b];                                                                  \
+        he_val_##op_name(vm, &lhs, fp[ip->c]);                                                     \
+        fp[ip->a] = lhs;                                                                           \
+    } while (false)
+
+#define REG_BINARY_K(op_name)                                                                      \
+    do {                                                                                           \
+        he_value lhs = fp[ip->b];                                                                  \
+        he_val_##op_name(vm, &lhs, ip->k);                                                         \
+        fp[ip->a] = lhs;                                                                           \
+    } while (false)
+
+#if HE_USE_COMPUTED_GOTO
+    static const void *const dispatch_table[] = {
+        [REG_LOADK] = &&do_REG_LOADK,
+        [REG_MOVE] = &&do_REG_MOVE,
+        [REG_ADD] = &&do_REG_ADD,
+        [REG_SUB] = &&do_REG_SUB,
+        [REG_MUL] = &&do_REG_MUL,
+        [REG_DIV] = &&do_REG_DIV,
+        [REG_MOD] = &&do_REG_MOD,
+        [REG_GT] = &&do_REG_GT,
+        [REG_LT] = &&do_REG_LT,
+        [REG_GTEQ] = &&do_REG_GTEQ,
+        [REG_LTEQ] = &&do_REG_LTEQ,
+        [REG_EQ] = &&do_REG_EQ,
+        [REG_ADDK] = &&do_REG_ADDK,
+        [REG_SUBK] = &&do_REG_SUBK,
+        [REG_MULK] = &&do_REG_MULK,
+        [REG_DIVK] = &&do_REG_DIVK,
+        [REG_MODK] = &&do_REG_MODK,
+        [REG_GTK] = &&do_REG_GTK,
+        [REG_LTK] = &&do_REG_LTK,
+        [REG_GTEQK] = &&do_REG_GTEQK,
+        [REG_LTEQK] = &&do_REG_LTEQK,
+        [REG_EQK] = &&do_REG_EQK,
+        [REG_NOT] = &&do_REG_NOT,
+        [REG_NEGATE] = &&do_REG_NEGATE,
+        [REG_JMP] = &&do_REG_JMP,
+        [REG_JZ] = &&do_REG_JZ,
+        [REG_JNZ] = &&do_REG_JNZ,
+        [REG_CALL] = &&do_REG_CALL,
+        [REG_RET] = &&do_REG_RET,
+        [REG_HALT] = &&do_REG_HALT,
+    };
+
+    if (!reg->threaded) {
+        for (size_t i = 0; i < reg->size; ++i) {
+            ops[i].handler = dispatch_table[ops[i].op];
+        }
+
+        reg->threaded = true;
+    }
+
+#define TARGET(op) do_##op:
+#define DISPATCH() goto *ip->handler
+
+    DISPATCH();
+#else
+#define TARGET(op) case op:
+#define DISPATCH() goto dispatch
+
+dispatch:
+    switch (ip->op) {
+#endif
+#define NEXT()                                                                                     \
+    do {                                                                                           \
+        ++ip;                                                                                      \
+        DISPATCH();                                                                                \
+    } while (false)
+
+    TARGET(REG_LOADK) {
+        fp[ip->a] = ip->k;
+        NEXT();
+    }
+    TARGET(REG_MOVE) {
+        fp[ip->a] = fp[ip->b];
+        NEXT();
+    }
+    TARGET(REG_ADD) {
+        REG_BINARY(add);
+        NEXT();
+    }
+    TARGET(REG_SUB) {
+        REG_BINARY(sub);
+        NEXT();
+    }
+    TARGET(REG_MUL) {
+        REG_BINARY(mul);
+        NEXT();
+    }
+    TARGET(REG_DIV) {
+        REG_BINARY(div);
+        NEXT();
+    }
+    TARGET(REG_MOD) {
+        REG_BINARY(mod);
+        NEXT();
+    }
+    TARGET(REG_GT) {
+        REG_BINARY(gt);
+        NEXT();
+    }
+    TARGET(REG_LT) {
+        REG_BINARY(lt);
+        NEXT();
+    }
+    TARGET(REG_GTEQ) {
+        REG_BINARY(gteq);
+        NEXT();
+    }
+    TARGET(REG_LTEQ) {
+        REG_BINARY(lteq);
+        NEXT();
+    }
+    TARGET(REG_EQ) {
+        REG_BINARY(eq);
+        NEXT();
+    }
+    TARGET(REG_ADDK) {
+        REG_BINARY_K(add);
+        NEXT();
+    }
+    TARGET(REG_SUBK) {
+        REG_BINARY_K(sub);
+        NEXT();
+    }
+    TARGET(REG_MULK) {
+        REG_BINARY_K(mul);
+        NEXT();
+    }
+    TARGET(REG_DIVK) {
+        REG_BINARY_K(div);
+        NEXT();
+    }
+    TARGET(REG_MODK) {
+        REG_BINARY_K(mod);
+        NEXT();
+    }
+    TARGET(REG_GTK) {
+        REG_BINARY_K(gt);
+        NEXT();
+    }
+    TARGET(REG_LTK) {
+        REG_BINARY_K(lt);
+        NEXT();
+    }
+    TARGET(REG_GTEQK) {
+        REG_BINARY_K(gteq);
+        NEXT();
+    }
+    TARGET(REG_LTEQK) {
+        REG_BINARY_K(lteq);
+        NEXT();
+    }
+    TARGET(REG_EQK) {
+        REG_BINARY_K(eq);
+        NEXT();
+    }
+    TARGET(REG_NOT) {
+        fp[ip->a] = fp[ip->b];
+        he_val_not(vm, &fp[ip->a]);
+        NEXT();
+    }
+    TARGET(REG_NEGATE) {
+        fp[ip->a] = fp[ip->b];
+        he_val_negate(vm, &fp[ip->a]);
+        NEXT();
+    }
+    TARGET(REG_JMP) {
+        ip = ops + ip->target;
+        DISPATCH();
+    }
+    TARGET(REG_JZ) {
+        ip = he_jmp_result(vm, &fp[ip->a]) ? ops + ip->target : ip + 1;
+        DISPATCH();
+    }
+    TARGET(REG_JNZ) {
+        ip = !he_jmp_result(vm, &fp[ip->a]) ? ops + ip->target : ip + 1;
+        DISPATCH();
+    }
+    TARGET(REG_CALL) {
+        // growing moves the stacks, frames are offsets so only the locals need updating
+        if (ret_limit - rsp < 2) {
+            rsp = he_return_stack_reserve(vm, rsp, 2);
+            ret_limit = vm->ret_addrs.limit;
+        }
+
+        if (limit - fp < ip->c) {
+            fp = he_stack_reserve(vm, fp, (size_t)ip->c);
+            base = vm->stack.base;
+            limit = vm->stack.limit;
+        }
+
+        if (fp - base + ip->b < 0) he_vm_fail(vm, "he_vm_run: stack underflow");
+
+        *rsp++ = (size_t)(ip - ops) + 1;
+        *rsp++ = (size_t)(fp - base);
+        fp += ip->a;
+        ip = ops + ip->target;
+        DISPATCH();
+    }
+    TARGET(REG_RET) {
+        assert(rsp != vm->ret_addrs.base && "attempting to return with an empty return stack");
+        fp = base + *--rsp;
+        ip = ops + *--rsp;
+        DISPATCH();
+    }
+    TARGET(REG_HALT) {
+        goto done;
+    }
+#if !HE_USE_COMPUTED_GOTO
+        default:
+            assert(false && "unknown opcode in register code");
+            goto done;
+    }
+#endif
+
+done:
+    vm->stack.sp = fp + ip->a;
+    vm->ret_addrs.sp = rsp;
+    vm->pc = reg->offsets[ip - ops];
+
+    he_reg_frames_to_offsets(&vm->ret_addrs, reg);
+
+#undef REG_BINARY
+#undef REG_BINARY_K
+#undef TARGET
+#undef DISPATCH
+#undef NEXT
+}
+
+/**
+ * @brief Gets register code for running the VM's code from its pc, translating it if needed
+ * @return Whether the register interpreter can run it
+ */
+static bool he_vm_prepare_registers(he_vm *vm) {
+    he_reg_code *reg = &vm->reg_code;
+
+    // the register interpreter keeps two words per frame, so it can't pick up the stack
+    // interpreter's return addresses
+    if (vm->ret_addrs.sp != vm->ret_addrs.base) { return false; }
+
+    if (reg->code != &vm->code || reg->entry != vm->pc) {
+        he_reg_code_translate(reg, &vm->code, vm->pc);
+    }
+
+    return reg->size != 0;
+}
+
+/**
+ * @brief Gets machine code for the VM's code, compiling it the first time
+ * @return Whether there is machine code to run, a failed compile isn't retried until
+ * the code changes
+ */
+static bool he_vm_prepare_jit(he_vm *vm) {
+    he_jit_code *jit = &vm->jit;
+
+    if (jit->code != &vm->code) { he_jit_compile(jit, &vm->code); }
+
+    return jit->entries != NULL;
+}
+
+/**
+ * @brief Runs the VM's machine code from its pc until it reaches an OP_HALT
+ *
+ * Like the stack interpreter, the return stack holds instruction indices while the code
+ * runs, and errors longjmp out from inside the runtime functions the code calls.
+ */
+static void he_vm_run_jit(he_vm *vm, const he_jit_code *jit) {
+    const he_code *code = jit->code;
+    size_t index = he_vm_to_indices(vm, code);
+
+    he_jit_frame frame = {vm, vm->stack.sp, vm->ret_addrs.sp, jit->entries, jit->entries[index],
+                          0};
+
+    he_jit_enter(jit, &frame);
+
+    vm->stack.sp = frame.sp;
+    vm->ret_addrs.sp = frame.rsp;
+    vm->pc = frame.exit;
+
+    he_vm_to_offsets(vm, code);
+}
+
+/**
+ * @brief Checks whether a run can skip the stack checks: the module has been verified
+ * with a bound on its stack use, the run starts at the entry point, and the VM's stacks
+ * have room for everything the code can push
+ */
+static bool he_vm_fits_verified(const he_vm *vm, const he_module *mod) {
+    const he_function_bounds *bounds = &mod->bounds;
+
+    if (!mod->verified || bounds->recursive || vm->pc != 0) { return false; }
+
+    if (vm->ret_addrs.sp != vm->ret_addrs.base) { return false; }
+
+    return (size_t)(vm->stack.sp - vm->stack.base) >= bounds->stack_inputs &&
+           (size_t)(vm->stack.limit - vm->stack.sp) >= bounds->max_stack_depth &&
+           (size_t)(vm->ret_addrs.limit - vm->ret_addrs.sp) >= bounds->max_return_depth;
+}
+
 he_interpret_flag he_vm_run(he_vm *vm, const he_module *module) {
     vm->mod = module;
 
-    if (setjmp(jump_buffer) == -1) {
-        fputs("helium: exiting with critical error", stderr);
-        return INTERPRET_FAILURE;
+    if (!he_code_is_current(&vm->code, module)) {
+        he_reg_code_destroy(&vm->reg_code);
+        he_jit_code_destroy(&vm->jit);
+
+        if (!he_code_translate(&vm->code, module)) {
+            vm->error = "he_vm_run: module bytecode is malformed";
+            fprintf(stderr, "helium: %s\n", vm->error);
+            return INTERPRET_FAILURE;
+        }
     }
 
-    while (vm->pc != module->ops.size) {
-        he_interpret_flag res = he_vm_execute_instruction(vm, true);
+    if (setjmp(vm->error_env) == -1) {
+        // the stack interpreter and machine code store their state before anything that
+        // can fail, so the VM can be inspected where it stopped
+        if (vm->indexed) { he_vm_to_offsets(vm, &vm->code); }
 
-        if (res == INTERPRET_FAILURE) {
-            // if an instruction fails, we can't exactly run anymore now can we?
-            return res;
-        }
+        fprintf(stderr, "helium: exiting with critical error: %s\n", vm->error);
+        return INTERPRET_FAILURE;
+    }
+
+    if (vm->trace.entries) {
+        he_vm_run_traced(vm, &vm->code);
+    } else if (vm->engine == ENGINE_REGISTER && he_vm_prepare_registers(vm)) {
+        he_vm_run_registers(vm, &vm->reg_code);
+    } else if (vm->engine == ENGINE_JIT && he_vm_prepare_jit(vm)) {
+        he_vm_run_jit(vm, &vm->jit);
+    } else if (he_vm_fits_verified(vm, module)) {
+        he_vm_run_unchecked(vm, &vm->code);
+    } else {
+        he_vm_run_code(vm, &vm->code);
     }
 
     return INTERPRET_SUCCESS;
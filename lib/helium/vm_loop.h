@@ -0,0 +1,569 @@
+/*
+ * The body of the stack interpreter's loop, included by vm.c once for every variant
+ * of the loop. Before including it, define:
+ *
+ *  - HE_LOOP_NAME, the name of the function to define
+ *  - HE_LOOP_CHECKED, 1 to check every push against the end of its stack, 0 to leave
+ *    the checks out for code he_module_verify has proven can't overflow
+ *  - HE_LOOP_TRACED, 1 to record every instruction in `vm->trace` before it runs
+ *
+ * All three are undefined again at the end.
+ */
+
+/**
+ * @brief The main interpreter loop, runs decoded code until it reaches an OP_HALT
+ *
+ * Arithmetic and comparison instructions quicken themselves the first time they run:
+ * if both operands are integers or both are floats, the instruction's `quick` opcode is
+ * rewritten to a handler for just that type. Those handlers check the types again and
+ * send the instruction back to its generic handler if they don't match. Only the VM's
+ * decoded copy of the code is rewritten, never the module.
+ *
+ * With a threshold set in `vm->hot`, backward jumps and calls also count hits on the
+ * instruction they go to, see he_hot_config.
+ *
+ * The instruction and stack pointers are kept in locals and written back into @p vm
+ * before anything that can fail, and when the loop exits. Errors longjmp out of this
+ * function, so anything that needs to survive an error must live in the caller.
+ *
+ * @param vm The VM to run
+ * @param code The decoded form of the VM's module
+ */
+static void HE_LOOP_NAME(he_vm *vm, he_code *code) {
+    he_op *const ops = code->ops;
+    he_op *ip = ops + he_vm_to_indices(vm, code);
+
+    // the only check a push needs is against the limit, where the stack grows. code
+    // he_module_verify has bounded never reaches it, so the unchecked loop leaves it out
+    he_value *base = vm->stack.base;
+    he_value *limit = vm->stack.limit;
+    he_value *sp = vm->stack.sp;
+    size_t *ret_base = vm->ret_addrs.base;
+    size_t *ret_limit = vm->ret_addrs.limit;
+    size_t *rsp = vm->ret_addrs.sp;
+
+    // hot spots are only counted with a threshold set, which leaves a predictable branch
+    const uint32_t loop_threshold = vm->hot.loop_threshold;
+    const uint32_t call_threshold = vm->hot.call_threshold;
+
+#ifdef HE_PROFILE
+    // every dispatch charges the time since the one before to the instruction that ran
+    he_vm_stats *stats = &vm->stats;
+    he_opcode profiled = OP_HALT;
+    uint64_t profile_start = he_profile_clock();
+
+#define PROFILE()                                                                                  \
+    do {                                                                                           \
+        uint64_t now = he_profile_clock();                                                         \
+        stats->time[profiled] += now - profile_start;                                              \
+        profile_start = now;                                                                       \
+        profiled = ip->quick;                                                                      \
+        ++stats->counts[profiled];                                                                 \
+    } while (false)
+#else
+#define PROFILE() ((void)0)
+#endif
+
+#if HE_LOOP_TRACED
+    // the count is kept in a local so the entries' stores can't make it reload, and
+    // stored back every time so a run that fails keeps its trace
+    he_trace_entry *const trace_entries = vm->trace.entries;
+    const size_t trace_mask = vm->trace.mask;
+    const size_t *const offsets = code->offsets;
+    uint64_t traced = vm->trace.count;
+
+#define TRACE()                                                                                    \
+    do {                                                                                           \
+        he_trace_entry *entry = &trace_entries[traced & trace_mask];                               \
+        he_trace_fill(entry, offsets[ip - ops], ip->quick, base, sp);                              \
+        vm->trace.count = ++traced;                                                                \
+    } while (false)
+#else
+#define TRACE() ((void)0)
+#endif
+
+// stores the loop's state in the VM, for the failure branch in he_vm_run to pick up
+#define SAVE_STATE() (vm->stack.sp = sp, vm->ret_addrs.sp = rsp, vm->pc = (size_t)(ip - ops))
+
+#if HE_LOOP_CHECKED
+#define PUSH(val)                                                                                  \
+    do {                                                                                           \
+        if (sp == limit) {                                                                         \
+            SAVE_STATE();                                                                          \
+            sp = he_stack_reserve(vm, sp, 1);                                                      \
+            base = vm->stack.base;                                                                 \
+            limit = vm->stack.limit;                                                               \
+        }                                                                                          \
+        *sp++ = (val);                                                                             \
+    } while (false)
+
+#define PUSH_RETURN(addr)                                                                          \
+    do {                                                                                           \
+        if (rsp == ret_limit) {                                                                    \
+            SAVE_STATE();                                                                          \
+            rsp = he_return_stack_reserve(vm, rsp, 1);                                             \
+            ret_base = vm->ret_addrs.base;                                                         \
+            ret_limit = vm->ret_addrs.limit;                                                       \
+        }                                                                                          \
+        *rsp++ = (addr);                                                                           \
+    } while (false)
+#else
+#define PUSH(val) (assert(sp != limit && "verified code overflowed the stack"), *sp++ = (val))
+
+#define PUSH_RETURN(addr)                                                                          \
+    (assert(rsp != ret_limit && "verified code overflowed the return stack"), *rsp++ = (addr))
+#endif
+
+#define POP() (assert(sp != base && "attempting to pop from empty stack"), *--sp)
+
+#define PEEK() (assert(sp != base && "attempting to peek empty stack"), sp - 1)
+
+#define LOOP_BINARY(op_name)                                                                       \
+    do {                                                                                           \
+        SAVE_STATE();                                                                              \
+        he_value second = POP();                                                                   \
+        he_val_##op_name(vm, PEEK(), second);                                                      \
+    } while (false)
+
+#if HE_USE_COMPUTED_GOTO
+#define SET_QUICK(quick_op) (ip->quick = (quick_op), ip->handler = dispatch_table[ip->quick])
+#else
+#define SET_QUICK(quick_op) (ip->quick = (quick_op))
+#endif
+
+// rewrites the current instruction to the handler for its operands' type, if it has one
+#define QUICKEN(lhs, rhs, int_op, float_op)                                                        \
+    do {                                                                                           \
+        if (ip->deopts < QUICKEN_DEOPT_LIMIT) {                                                    \
+            if (he_val_is_int(lhs) && he_val_is_int(rhs)) {                                        \
+                SET_QUICK(int_op);                                                                 \
+            } else if (he_val_is_float(lhs) && he_val_is_float(rhs)) {                             \
+                SET_QUICK(float_op);                                                               \
+            }                                                                                      \
+        }                                                                                          \
+    } while (false)
+
+#define QUICKEN_INT(lhs, rhs, int_op)                                                              \
+    do {                                                                                           \
+        if (ip->deopts < QUICKEN_DEOPT_LIMIT && he_val_is_int(lhs) && he_val_is_int(rhs)) {        \
+            SET_QUICK(int_op);                                                                     \
+        }                                                                                          \
+    } while (false)
+
+// sends the current instruction back to its generic handler and runs it there, without
+// profiling or tracing it a second time
+#define DEOPTIMIZE()                                                                               \
+    do {                                                                                           \
+        ++ip->deopts;                                                                              \
+        SET_QUICK(ip->op);                                                                         \
+        REDISPATCH();                                                                              \
+    } while (false)
+
+#define GUARD(type)                                                                                \
+    do {                                                                                           \
+        if (!he_val_is_##type(sp - 2) || !he_val_is_##type(sp - 1)) { DEOPTIMIZE(); }            \
+    } while (false)
+
+// INTEGER_OP promotes overflowing results to floats, the same as the generic handlers
+#define INT_ARITHMETIC(builtin, op)                                                                \
+    do {                                                                                           \
+        GUARD(int);                                                                                \
+        he_value second = POP();                                                                   \
+        he_value *top = PEEK();                                                                    \
+        INTEGER_OP(builtin, op);                                                                   \
+    } while (false)
+
+#define FLOAT_ARITHMETIC(op)                                                                       \
+    do {                                                                                           \
+        GUARD(float);                                                                              \
+        he_value second = POP();                                                                   \
+        he_value *top = PEEK();                                                                    \
+        *top = he_val_from_float(he_val_as_float(top) op he_val_as_float(&second));                \
+    } while (false)
+
+#define TYPED_COMPARISON(type, op)                                                                 \
+    do {                                                                                           \
+        GUARD(type);                                                                               \
+        he_value second = POP();                                                                   \
+        he_value *top = PEEK();                                                                    \
+        *top = he_val_from_bool(he_val_as_##type(top) op he_val_as_##type(&second));               \
+    } while (false)
+
+#define QUICKEN_BINARY(int_op, float_op) QUICKEN(sp - 2, sp - 1, int_op, float_op)
+
+#if HE_USE_COMPUTED_GOTO
+    static const void *const dispatch_table[] = {
+        [OP_RET] = &&do_OP_RET,
+        [OP_CALL] = &&do_OP_CALL,
+        [OP_LOAD_CONST] = &&do_OP_LOAD_CONST,
+        [OP_ADD] = &&do_OP_ADD,
+        [OP_SUB] = &&do_OP_SUB,
+        [OP_MUL] = &&do_OP_MUL,
+        [OP_DIV] = &&do_OP_DIV,
+        [OP_MOD] = &&do_OP_MOD,
+        [OP_GT] = &&do_OP_GT,
+        [OP_LT] = &&do_OP_LT,
+        [OP_GTEQ] = &&do_OP_GTEQ,
+        [OP_LTEQ] = &&do_OP_LTEQ,
+        [OP_EQ] = &&do_OP_EQ,
+        [OP_NOT] = &&do_OP_NOT,
+        [OP_NEGATE] = &&do_OP_NEGATE,
+        [OP_JMP] = &&do_OP_JMP,
+        [OP_JZ] = &&do_OP_JZ,
+        [OP_JNZ] = &&do_OP_JNZ,
+        [OP_POP] = &&do_OP_POP,
+        [OP_DUP] = &&do_OP_DUP,
+        [OP_HALT] = &&do_OP_HALT,
+        [OP_LOAD_CONST_ADD] = &&do_OP_LOAD_CONST_ADD,
+        [OP_LOAD_CONST_SUB] = &&do_OP_LOAD_CONST_SUB,
+        [OP_LT_JZ] = &&do_OP_LT_JZ,
+        [OP_LT_JNZ] = &&do_OP_LT_JNZ,
+        [OP_GT_JZ] = &&do_OP_GT_JZ,
+        [OP_GT_JNZ] = &&do_OP_GT_JNZ,
+        [OP_EQ_NOT] = &&do_OP_EQ_NOT,
+        [OP_ADD_INT] = &&do_OP_ADD_INT,
+        [OP_ADD_FLOAT] = &&do_OP_ADD_FLOAT,
+        [OP_SUB_INT] = &&do_OP_SUB_INT,
+        [OP_SUB_FLOAT] = &&do_OP_SUB_FLOAT,
+        [OP_MUL_INT] = &&do_OP_MUL_INT,
+        [OP_MUL_FLOAT] = &&do_OP_MUL_FLOAT,
+        [OP_GT_INT] = &&do_OP_GT_INT,
+        [OP_GT_FLOAT] = &&do_OP_GT_FLOAT,
+        [OP_LT_INT] = &&do_OP_LT_INT,
+        [OP_LT_FLOAT] = &&do_OP_LT_FLOAT,
+        [OP_GTEQ_INT] = &&do_OP_GTEQ_INT,
+        [OP_GTEQ_FLOAT] = &&do_OP_GTEQ_FLOAT,
+        [OP_LTEQ_INT] = &&do_OP_LTEQ_INT,
+        [OP_LTEQ_FLOAT] = &&do_OP_LTEQ_FLOAT,
+        [OP_LOAD_CONST_ADD_INT] = &&do_OP_LOAD_CONST_ADD_INT,
+        [OP_LOAD_CONST_SUB_INT] = &&do_OP_LOAD_CONST_SUB_INT,
+        [OP_LT_JZ_INT] = &&do_OP_LT_JZ_INT,
+        [OP_LT_JNZ_INT] = &&do_OP_LT_JNZ_INT,
+        [OP_GT_JZ_INT] = &&do_OP_GT_JZ_INT,
+        [OP_GT_JNZ_INT] = &&do_OP_GT_JNZ_INT,
+    };
+
+    // the handler addresses only exist inside this function, so the code gets threaded
+    // here, and again whenever the other loop threaded it last
+    if (code->threaded != dispatch_table) {
+        for (size_t i = 0; i <= code->size; ++i) {
+            ops[i].handler = dispatch_table[ops[i].quick];
+        }
+
+        code->threaded = dispatch_table;
+    }
+
+#define TARGET(op) do_##op:
+#define DISPATCH()                                                                                 \
+    do {                                                                                           \
+        PROFILE();                                                                                 \
+        TRACE();                                                                                   \
+        goto *ip->handler;                                                                         \
+    } while (false)
+#define REDISPATCH() goto *ip->handler
+
+    DISPATCH();
+#else
+#define TARGET(op) case op:
+#define DISPATCH() goto dispatch
+#define REDISPATCH() goto dispatch_quick
+
+dispatch:
+    PROFILE();
+    TRACE();
+dispatch_quick:
+    switch (ip->quick) {
+#endif
+#define NEXT()                                                                                     \
+    do {                                                                                           \
+        ++ip;                                                                                      \
+        DISPATCH();                                                                                \
+    } while (false)
+
+// a backward jump is a loop's back-edge, which counts towards its target being hot
+#define JUMP(index)                                                                                \
+    do {                                                                                           \
+        he_op *target = ops + (index);                                                             \
+                                                                                                   \
+        if (loop_threshold && target <= ip) {                                                      \
+            he_vm_count_hit(vm, target, HOT_LOOP, loop_threshold);                                 \
+        }                                                                                          \
+                                                                                                   \
+        ip = target;                                                                               \
+        DISPATCH();                                                                                \
+    } while (false)
+
+#define BRANCH(condition)                                                                          \
+    do {                                                                                           \
+        if (condition) { JUMP(ip->op_object.jmp.address); }                                        \
+                                                                                                   \
+        NEXT();                                                                                    \
+    } while (false)
+
+    TARGET(OP_RET) {
+        assert(rsp != ret_base && "attempting to return with an empty return stack");
+        ip = ops + *--rsp;
+        DISPATCH();
+    }
+    TARGET(OP_CALL) {
+        PUSH_RETURN(ip->op_object.call.return_address);
+        ip = ops + ip->op_object.call.address;
+
+        if (call_threshold) { he_vm_count_hit(vm, ip, HOT_CALL, call_threshold); }
+
+        DISPATCH();
+    }
+    TARGET(OP_LOAD_CONST) {
+        PUSH(ip->op_object.push.val);
+        NEXT();
+    }
+    TARGET(OP_ADD) {
+        QUICKEN_BINARY(OP_ADD_INT, OP_ADD_FLOAT);
+        LOOP_BINARY(add);
+        NEXT();
+    }
+    TARGET(OP_SUB) {
+        QUICKEN_BINARY(OP_SUB_INT, OP_SUB_FLOAT);
+        LOOP_BINARY(sub);
+        NEXT();
+    }
+    TARGET(OP_MUL) {
+        QUICKEN_BINARY(OP_MUL_INT, OP_MUL_FLOAT);
+        LOOP_BINARY(mul);
+        NEXT();
+    }
+    TARGET(OP_DIV) {
+        LOOP_BINARY(div);
+        NEXT();
+    }
+    TARGET(OP_MOD) {
+        LOOP_BINARY(mod);
+        NEXT();
+    }
+    TARGET(OP_GT) {
+        QUICKEN_BINARY(OP_GT_INT, OP_GT_FLOAT);
+        LOOP_BINARY(gt);
+        NEXT();
+    }
+    TARGET(OP_LT) {
+        QUICKEN_BINARY(OP_LT_INT, OP_LT_FLOAT);
+        LOOP_BINARY(lt);
+        NEXT();
+    }
+    TARGET(OP_GTEQ) {
+        QUICKEN_BINARY(OP_GTEQ_INT, OP_GTEQ_FLOAT);
+        LOOP_BINARY(gteq);
+        NEXT();
+    }
+    TARGET(OP_LTEQ) {
+        QUICKEN_BINARY(OP_LTEQ_INT, OP_LTEQ_FLOAT);
+        LOOP_BINARY(lteq);
+        NEXT();
+    }
+    TARGET(OP_EQ) {
+        LOOP_BINARY(eq);
+        NEXT();
+    }
+    TARGET(OP_NOT) {
+        SAVE_STATE();
+        he_val_not(vm, PEEK());
+        NEXT();
+    }
+    TARGET(OP_NEGATE) {
+        SAVE_STATE();
+        he_val_negate(vm, PEEK());
+        NEXT();
+    }
+    TARGET(OP_JMP) {
+        JUMP(ip->op_object.jmp.address);
+    }
+    TARGET(OP_JZ) {
+        SAVE_STATE();
+        BRANCH(he_jmp_result(vm, PEEK()));
+    }
+    TARGET(OP_JNZ) {
+        SAVE_STATE();
+        BRANCH(!he_jmp_result(vm, PEEK()));
+    }
+    TARGET(OP_POP) {
+        (void)POP();
+        NEXT();
+    }
+    TARGET(OP_DUP) {
+        he_value top = *PEEK();
+        PUSH(top);
+        NEXT();
+    }
+    TARGET(OP_HALT) {
+        goto done;
+    }
+    TARGET(OP_LOAD_CONST_ADD) {
+        QUICKEN_INT(PEEK(), &ip->op_object.push.val, OP_LOAD_CONST_ADD_INT);
+        SAVE_STATE();
+        he_val_add(vm, PEEK(), ip->op_object.push.val);
+        NEXT();
+    }
+    TARGET(OP_LOAD_CONST_SUB) {
+        QUICKEN_INT(PEEK(), &ip->op_object.push.val, OP_LOAD_CONST_SUB_INT);
+        SAVE_STATE();
+        he_val_sub(vm, PEEK(), ip->op_object.push.val);
+        NEXT();
+    }
+    TARGET(OP_LT_JZ) {
+        QUICKEN_INT(sp - 2, sp - 1, OP_LT_JZ_INT);
+        LOOP_BINARY(lt);
+        BRANCH(he_jmp_result(vm, PEEK()));
+    }
+    TARGET(OP_LT_JNZ) {
+        QUICKEN_INT(sp - 2, sp - 1, OP_LT_JNZ_INT);
+        LOOP_BINARY(lt);
+        BRANCH(!he_jmp_result(vm, PEEK()));
+    }
+    TARGET(OP_GT_JZ) {
+        QUICKEN_INT(sp - 2, sp - 1, OP_GT_JZ_INT);
+        LOOP_BINARY(gt);
+        BRANCH(he_jmp_result(vm, PEEK()));
+    }
+    TARGET(OP_GT_JNZ) {
+        QUICKEN_INT(sp - 2, sp - 1, OP_GT_JNZ_INT);
+        LOOP_BINARY(gt);
+        BRANCH(!he_jmp_result(vm, PEEK()));
+    }
+    TARGET(OP_EQ_NOT) {
+        LOOP_BINARY(eq);
+        he_val_not(vm, PEEK());
+        NEXT();
+    }
+    TARGET(OP_ADD_INT) {
+        INT_ARITHMETIC(__builtin_add_overflow, +);
+        NEXT();
+    }
+    TARGET(OP_ADD_FLOAT) {
+        FLOAT_ARITHMETIC(+);
+        NEXT();
+    }
+    TARGET(OP_SUB_INT) {
+        INT_ARITHMETIC(__builtin_sub_overflow, -);
+        NEXT();
+    }
+    TARGET(OP_SUB_FLOAT) {
+        FLOAT_ARITHMETIC(-);
+        NEXT();
+    }
+    TARGET(OP_MUL_INT) {
+        INT_ARITHMETIC(__builtin_mul_overflow, *);
+        NEXT();
+    }
+    TARGET(OP_MUL_FLOAT) {
+        FLOAT_ARITHMETIC(*);
+        NEXT();
+    }
+    TARGET(OP_GT_INT) {
+        TYPED_COMPARISON(int, >);
+        NEXT();
+    }
+    TARGET(OP_GT_FLOAT) {
+        TYPED_COMPARISON(float, >);
+        NEXT();
+    }
+    TARGET(OP_LT_INT) {
+        TYPED_COMPARISON(int, <);
+        NEXT();
+    }
+    TARGET(OP_LT_FLOAT) {
+        TYPED_COMPARISON(float, <);
+        NEXT();
+    }
+    TARGET(OP_GTEQ_INT) {
+        TYPED_COMPARISON(int, >=);
+        NEXT();
+    }
+    TARGET(OP_GTEQ_FLOAT) {
+        TYPED_COMPARISON(float, >=);
+        NEXT();
+    }
+    TARGET(OP_LTEQ_INT) {
+        TYPED_COMPARISON(int, <=);
+        NEXT();
+    }
+    TARGET(OP_LTEQ_FLOAT) {
+        TYPED_COMPARISON(float, <=);
+        NEXT();
+    }
+    TARGET(OP_LOAD_CONST_ADD_INT) {
+        // the constant can't change, only the value on the stack needs checking
+        if (!he_val_is_int(PEEK())) { DEOPTIMIZE(); }
+
+        he_value second = ip->op_object.push.val;
+        he_value *top = PEEK();
+        INTEGER_OP(__builtin_add_overflow, +);
+        NEXT();
+    }
+    TARGET(OP_LOAD_CONST_SUB_INT) {
+        if (!he_val_is_int(PEEK())) { DEOPTIMIZE(); }
+
+        he_value second = ip->op_object.push.val;
+        he_value *top = PEEK();
+        INTEGER_OP(__builtin_sub_overflow, -);
+        NEXT();
+    }
+    TARGET(OP_LT_JZ_INT) {
+        TYPED_COMPARISON(int, <);
+        BRANCH(he_val_as_bool(PEEK()));
+    }
+    TARGET(OP_LT_JNZ_INT) {
+        TYPED_COMPARISON(int, <);
+        BRANCH(!he_val_as_bool(PEEK()));
+    }
+    TARGET(OP_GT_JZ_INT) {
+        TYPED_COMPARISON(int, >);
+        BRANCH(he_val_as_bool(PEEK()));
+    }
+    TARGET(OP_GT_JNZ_INT) {
+        TYPED_COMPARISON(int, >);
+        BRANCH(!he_val_as_bool(PEEK()));
+    }
+#if !HE_USE_COMPUTED_GOTO
+        default:
+            // the decoder rejects unknown opcodes, so this can't happen
+            assert(false && "unknown opcode in decoded code");
+            goto done;
+    }
+#endif
+
+done:
+#ifdef HE_PROFILE
+    stats->time[profiled] += he_profile_clock() - profile_start;
+#endif
+
+    SAVE_STATE();
+    he_vm_to_offsets(vm, code);
+
+#undef SAVE_STATE
+#undef PUSH
+#undef PUSH_RETURN
+#undef POP
+#undef PEEK
+#undef LOOP_BINARY
+#undef SET_QUICK
+#undef QUICKEN
+#undef QUICKEN_INT
+#undef DEOPTIMIZE
+#undef GUARD
+#undef INT_ARITHMETIC
+#undef FLOAT_ARITHMETIC
+#undef TYPED_COMPARISON
+#undef QUICKEN_BINARY
+#undef TARGET
+#undef DISPATCH
+#undef REDISPATCH
+#undef NEXT
+#undef JUMP
+#undef BRANCH
+#undef PROFILE
+#undef TRACE
+}
+
+#undef HE_LOOP_NAME
+#undef HE_LOOP_CHECKED
+#undef HE_LOOP_TRACED
@@ -0,0 +1,467 @@
+#include "helium_as.hh"
+#include "helium/instruction.h"
+#include "helium/intern.h"
+#include "helium/value.h"
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace {
+  constexpr auto NONE = std::numeric_limits<std::size_t>::max();
+
+  // forward jumps get an operand this wide, enough for a 32 GiB module
+  constexpr auto FIXUP_SIZE = std::size_t{5};
+
+  constexpr char to_lower(char c) { return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c; }
+
+  constexpr bool is_identifier_start(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '.';
+  }
+
+  constexpr bool is_identifier(char c) { return is_identifier_start(c) || (c >= '0' && c <= '9'); }
+
+  std::uint64_t hash(std::string_view name, bool fold_case) {
+    auto h = std::uint64_t{14695981039346656037ull};
+
+    for (auto c : name) {
+      h = (h ^ static_cast<unsigned char>(fold_case ? to_lower(c) : c)) * 1099511628211ull;
+    }
+
+    return h;
+  }
+
+  /** @brief Finds opcodes by mnemonic, ignoring case */
+  class mnemonic_table {
+    static constexpr auto SIZE = std::size_t{128};
+    static constexpr auto EMPTY = std::uint8_t{0xFF};
+
+    std::array<std::uint8_t, SIZE> m_slots;
+
+    static std::string_view mnemonic(std::uint8_t op) {
+      // every name starts with OP_
+      return std::string_view(he_opcode_name(static_cast<he_opcode>(op))).substr(3);
+    }
+
+  public:
+    mnemonic_table() {
+      m_slots.fill(EMPTY);
+
+      for (auto op = std::uint8_t{0}; op < HE_OPCODE_COUNT; ++op) {
+        auto slot = hash(mnemonic(op), true) % SIZE;
+
+        while (m_slots[slot] != EMPTY) {
+          slot = (slot + 1) % SIZE;
+        }
+
+        m_slots[slot] = op;
+      }
+    }
+
+    /** @brief The opcode called @p name, or EMPTY if there's none */
+    [[nodiscard]] std::uint8_t find(std::string_view name) const {
+      for (auto slot = hash(name, true) % SIZE; m_slots[slot] != EMPTY; slot = (slot + 1) % SIZE) {
+        auto candidate = mnemonic(m_slots[slot]);
+
+        if (candidate.size() != name.size()) { continue; }
+
+        auto same = true;
+
+        for (std::size_t i = 0; i < name.size() && same; ++i) {
+          same = to_lower(name[i]) == to_lower(candidate[i]);
+        }
+
+        if (same) { return m_slots[slot]; }
+      }
+
+      return EMPTY;
+    }
+
+    [[nodiscard]] static bool found(std::uint8_t op) { return op != EMPTY; }
+  };
+
+  struct label {
+    /** @brief The label's name, pointing into the source */
+    std::string_view name;
+
+    /** @brief Where the label was defined, NONE until it is */
+    std::size_t address;
+
+    /** @brief The first operand waiting for the label's address, NONE if there are none */
+    std::size_t fixups;
+
+    /** @brief The line the label was first used on */
+    std::size_t line;
+  };
+
+  /** @brief An operand waiting for its label's address */
+  struct fixup {
+    /** @brief The byte offset of the operand */
+    std::size_t offset;
+
+    /** @brief The next operand waiting for the same label, NONE at the end */
+    std::size_t next;
+  };
+
+  /** @brief The labels of a source, in an open addressing hash table */
+  class label_table {
+    std::vector<label> m_labels;
+    std::vector<std::uint32_t> m_slots; // index into m_labels plus one, 0 when empty
+
+    void grow() {
+      m_slots.assign(m_slots.empty() ? 64 : m_slots.size() * 2, 0);
+      auto mask = m_slots.size() - 1;
+
+      for (std::size_t i = 0; i < m_labels.size(); ++i) {
+        auto slot = hash(m_labels[i].name, false) & mask;
+
+        while (m_slots[slot] != 0) {
+          slot = (slot + 1) & mask;
+        }
+
+        m_slots[slot] = static_cast<std::uint32_t>(i + 1);
+      }
+    }
+
+  public:
+    [[nodiscard]] const std::vector<label> &labels() const { return m_labels; }
+
+    /** @brief Finds the label called @p name, adding it if it isn't there yet */
+    label &get(std::string_view name, std::size_t line) {
+      // keep the table at most half full
+      if (2 * (m_labels.size() + 1) > m_slots.size()) { grow(); }
+
+      auto mask = m_slots.size() - 1;
+      auto slot = hash(name, false) & mask;
+
+      while (m_slots[slot] != 0) {
+        auto &found = m_labels[m_slots[slot] - 1];
+
+        if (found.name == name) { return found; }
+
+        slot = (slot + 1) & mask;
+      }
+
+      m_labels.push_back({name, NONE, NONE, line});
+      m_slots[slot] = static_cast<std::uint32_t>(m_labels.size());
+
+      return m_labels.back();
+    }
+  };
+
+  /** @brief The state of one assemble */
+  class parser {
+    const char *m_pos;
+    const char *m_end;
+    std::size_t m_line = 1;
+    he_module *m_mod;
+    label_table m_labels;
+    std::vector<fixup> m_fixups;
+    std::string m_scratch; // unescaped string constants
+    std::string &m_error;
+    std::size_t &m_error_line;
+
+    bool fail(std::string message) {
+      m_error = std::move(message);
+      m_error_line = m_line;
+
+      return false;
+    }
+
+    /** @brief Skips spaces and comments, stopping at the end of the line if @p lines is false */
+    void skip_space(bool lines) {
+      while (m_pos != m_end) {
+        auto c = *m_pos;
+
+        if (c == ';') {
+          while (m_pos != m_end && *m_pos != '\n') {
+            ++m_pos;
+          }
+        } else if (c == '\n' && lines) {
+          ++m_line;
+          ++m_pos;
+        } else if (c == ' ' || c == '\t' || c == '\r') {
+          ++m_pos;
+        } else {
+          return;
+        }
+      }
+    }
+
+    /** @brief Reads everything up to the next space, comment or line break */
+    std::string_view word() {
+      auto *start = m_pos;
+
+      while (m_pos != m_end && *m_pos != ' ' && *m_pos != '\t' && *m_pos != '\r' &&
+             *m_pos != '\n' && *m_pos != ';') {
+        ++m_pos;
+      }
+
+      return std::string_view(start, static_cast<std::size_t>(m_pos - start));
+    }
+
+    std::string_view identifier() {
+      auto *start = m_pos;
+
+      if (m_pos != m_end && is_identifier_start(*m_pos)) {
+        while (m_pos != m_end && is_identifier(*m_pos)) {
+          ++m_pos;
+        }
+      }
+
+      return std::string_view(start, static_cast<std::size_t>(m_pos - start));
+    }
+
+    void write_byte(std::uint8_t byte) { he_module_write_byte(m_mod, byte); }
+
+    /** @brief Writes @p num padded out to FIXUP_SIZE bytes at @p offset */
+    void patch(std::size_t offset, std::size_t num) {
+      auto *bytes = static_cast<std::uint8_t *>(m_mod->ops.array) + offset;
+
+      for (std::size_t i = 0; i < FIXUP_SIZE; ++i, num >>= 7) {
+        bytes[i] = static_cast<std::uint8_t>((num & 0x7F) | (i + 1 < FIXUP_SIZE ? 0x80 : 0));
+      }
+    }
+
+    bool define_label(std::string_view name) {
+      auto &l = m_labels.get(name, m_line);
+
+      if (l.address != NONE) { return fail("label '" + std::string(name) + "' defined twice"); }
+
+      l.address = m_mod->ops.size;
+
+      for (auto at = l.fixups; at != NONE; at = m_fixups[at].next) {
+        patch(m_fixups[at].offset, l.address);
+      }
+
+      l.fixups = NONE;
+
+      return true;
+    }
+
+    bool parse_address() {
+      if (m_pos != m_end && *m_pos >= '0' && *m_pos <= '9') {
+        auto text = word();
+        auto address = std::size_t{0};
+        auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), address);
+
+        if (error != std::errc{} || end != text.data() + text.size()) {
+          return fail("invalid address '" + std::string(text) + "'");
+        }
+
+        he_module_write_int(m_mod, address);
+
+        return true;
+      }
+
+      auto name = identifier();
+
+      if (name.empty()) { return fail("expected a label"); }
+
+      auto &l = m_labels.get(name, m_line);
+
+      if (l.address != NONE) {
+        he_module_write_int(m_mod, l.address);
+      } else {
+        m_fixups.push_back({m_mod->ops.size, l.fixups});
+        l.fixups = m_fixups.size() - 1;
+
+        for (std::size_t i = 0; i < FIXUP_SIZE; ++i) {
+          write_byte(0);
+        }
+      }
+
+      return true;
+    }
+
+    bool parse_string(he_value *val) {
+      auto *start = ++m_pos;
+      auto escaped = false;
+
+      while (m_pos != m_end && *m_pos != '"' && *m_pos != '\n') {
+        escaped = escaped || *m_pos == '\\';
+        m_pos += (*m_pos == '\\' && m_pos + 1 != m_end) ? 2 : 1;
+      }
+
+      if (m_pos == m_end || *m_pos != '"') { return fail("unterminated string"); }
+
+      auto chars = std::string_view(start, static_cast<std::size_t>(m_pos - start));
+      ++m_pos;
+
+      if (escaped) {
+        m_scratch.clear();
+
+        for (std::size_t i = 0; i < chars.size(); ++i) {
+          auto c = chars[i];
+
+          if (c == '\\') {
+            switch (chars[++i]) {
+              case 'n': c = '\n'; break;
+              case 't': c = '\t'; break;
+              case '0': c = '\0'; break;
+              case '\\': c = '\\'; break;
+              case '"': c = '"'; break;
+              default: return fail("unknown escape in string");
+            }
+          }
+
+          m_scratch.push_back(c);
+        }
+
+        chars = m_scratch;
+      }
+
+      *val = he_val_wrap_string(he_intern(chars.data(), chars.size()));
+
+      return true;
+    }
+
+    bool parse_number(std::string_view text, he_value *val) {
+      auto *first = text.data();
+      auto *last = first + text.size();
+      auto negative = first != last && *first == '-';
+      auto *digits = first + ((negative || (first != last && *first == '+')) ? 1 : 0);
+
+      if (last - digits > 2 && digits[0] == '0' && to_lower(digits[1]) == 'x') {
+        auto magnitude = std::uint64_t{0};
+        auto [end, error] = std::from_chars(digits + 2, last, magnitude, 16);
+
+        if (error == std::errc{} && end == last && magnitude <= INT64_MAX) {
+          auto integer = static_cast<std::int64_t>(magnitude);
+          *val = he_val_from_int(negative ? -integer : integer);
+
+          return true;
+        }
+      } else if (text.find_first_of(".eEin") == std::string_view::npos) {
+        auto integer = std::int64_t{0};
+        auto [end, error] = std::from_chars(negative ? first : digits, last, integer);
+
+        if (error == std::errc{} && end == last) {
+          *val = he_val_from_int(integer);
+
+          return true;
+        }
+      } else {
+        // strtod wants a terminator, and no number worth writing is longer than this
+        char buffer[64];
+
+        if (text.size() < sizeof(buffer)) {
+          std::memcpy(buffer, first, text.size());
+          buffer[text.size()] = '\0';
+
+          char *end = nullptr;
+          auto number = std::strtod(buffer, &end);
+
+          if (end == buffer + text.size()) {
+            *val = he_val_from_float(number);
+
+            return true;
+          }
+        }
+      }
+
+      return fail("invalid constant '" + std::string(text) + "'");
+    }
+
+    bool parse_constant() {
+      auto val = he_value{};
+
+      if (m_pos != m_end && *m_pos == '"') {
+        if (!parse_string(&val)) { return false; }
+      } else {
+        auto text = word();
+
+        if (text.empty()) { return fail("expected a constant"); }
+
+        if (text == "true" || text == "false") {
+          val = he_val_from_bool(text == "true");
+        } else if (!parse_number(text, &val)) {
+          return false;
+        }
+      }
+
+      he_module_write_int(m_mod, he_module_push_constant(m_mod, val));
+
+      return true;
+    }
+
+  public:
+    parser(std::string_view source, he_module *mod, std::string &error, std::size_t &line)
+        : m_pos(source.data()), m_end(source.data() + source.size()), m_mod(mod),
+          m_error(error), m_error_line(line) {}
+
+    bool run() {
+      static const mnemonic_table mnemonics;
+
+      for (skip_space(true); m_pos != m_end; skip_space(true)) {
+        auto name = identifier();
+
+        if (name.empty()) { return fail("expected an instruction or a label"); }
+
+        if (m_pos != m_end && *m_pos == ':') {
+          ++m_pos;
+
+          if (!define_label(name)) { return false; }
+
+          continue;
+        }
+
+        auto op = mnemonics.find(name);
+
+        if (!mnemonic_table::found(op)) {
+          return fail("unknown instruction '" + std::string(name) + "'");
+        }
+
+        write_byte(op);
+
+        if (he_opcode_has_operand(static_cast<he_opcode>(op))) {
+          skip_space(false);
+
+          auto is_address = op == OP_CALL || he_opcode_is_jump(static_cast<he_opcode>(op));
+
+          if (!(is_address ? parse_address() : parse_constant())) { return false; }
+        }
+
+        // anything else has to wait for the next line
+        skip_space(false);
+
+        if (m_pos != m_end && *m_pos != '\n') {
+          return fail("unexpected '" + std::string(word()) + "' after instruction");
+        }
+      }
+
+      for (const auto &l : m_labels.labels()) {
+        if (l.address == NONE) {
+          m_line = l.line;
+
+          return fail("label '" + std::string(l.name) + "' is never defined");
+        }
+      }
+
+      return true;
+    }
+  };
+} // namespace
+
+namespace helium_as {
+  assembler::assembler(std::string_view source) : m_source(source) {}
+
+  he_module assembler::assemble() {
+    he_module mod;
+    he_module_init(&mod);
+
+    if (!assemble(&mod)) { he_module_destroy(&mod); }
+
+    return mod;
+  }
+
+  bool assembler::assemble(he_module *mod) {
+    m_error.clear();
+    m_error_line = 0;
+
+    return parser(m_source, mod, m_error, m_error_line).run();
+  }
+} // namespace helium_as
@@ -2,16 +2,49 @@
 #define HELIUM_AS_ASSEMBLER_HH
 
 #include "helium/module.h"
+#include <cstddef>
+#include <string>
 #include <string_view>
 
 namespace helium_as {
+  /**
+   * @brief Assembles the textual form of a module in a single pass over the source.
+   *
+   * Each instruction is a mnemonic, the opcode's name without `OP_` in any case, followed
+   * by its operand if it has one. Constant operands are integers (decimal or `0x` hex),
+   * floats, `true`, `false` or double-quoted strings. Jump and call operands are labels,
+   * defined by a name followed by `:`, or byte offsets. `;` starts a comment.
+   *
+   * The source is only read through the string_view, nothing is copied per token. A jump
+   * to a label that hasn't been defined yet gets a fixed width operand that's patched when
+   * the label turns up, so those take a few more bytes than they need.
+   */
   class assembler {
     std::string_view m_source;
+    std::string m_error;
+    std::size_t m_error_line = 0;
 
   public:
     explicit assembler(std::string_view source);
 
+    /**
+     * @brief Assembles the source into a new module
+     * @return The module, empty if error() has something to say
+     */
     he_module assemble();
+
+    /**
+     * @brief Assembles the source onto the end of a module
+     * @param mod An initialized module
+     * @return Whether the source assembled, the module may be half written if not
+     */
+    bool assemble(he_module *mod);
+
+    /** @brief Why the last assemble failed, empty if it didn't */
+    [[nodiscard]] const std::string &error() const { return m_error; }
+
+    /** @brief The line the last assemble failed on, counting from 1 */
+    [[nodiscard]] std::size_t error_line() const { return m_error_line; }
   };
 } // namespace helium_as
 
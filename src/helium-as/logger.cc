@@ -1,74 +1,77 @@
 #include "logger.hh"
+#include "helium/disasm.h"
+#include <cstdio>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <vector>
 
-constexpr auto NUM_PRECISION = 8;
+void helium_as::print(const helium::mod &mod) {
+  // flushed, so the disassembly written to stdout comes out after it
+  std::cout << "== module disassembly ==" << std::endl;
 
-#define SIMPLE_OP(name)                                                                            \
-  case name:                                                                                       \
-    std::cout << #name << ')';                                                                     \
-    break
+  he_disasm_file(mod.raw(), 0, mod.ops_size(), stdout);
+  std::fflush(stdout);
 
-void helium_as::print(const helium::mod &mod) {
-  std::cout << "== module disassembly ==\n";
-
-  for (auto it = mod.begin(); it != mod.end(); ++it) {
-    auto byte = *it;
-    auto offset = &it - mod.raw()->ops.array;
-
-    std::cout << std::setfill('0') << std::setw(NUM_PRECISION) << offset << ": "
-              << std::setfill('0') << std::setw(2) << std::hex << static_cast<int>(byte) << " (";
-
-    switch (byte) {
-      SIMPLE_OP(OP_RET);
-      SIMPLE_OP(OP_CALL);
-      SIMPLE_OP(OP_ADD);
-      SIMPLE_OP(OP_SUB);
-      SIMPLE_OP(OP_MUL);
-      SIMPLE_OP(OP_DIV);
-      SIMPLE_OP(OP_MOD);
-      SIMPLE_OP(OP_GT);
-      SIMPLE_OP(OP_LT);
-      SIMPLE_OP(OP_GTEQ);
-      SIMPLE_OP(OP_LTEQ);
-      SIMPLE_OP(OP_EQ);
-      SIMPLE_OP(OP_NOT);
-      SIMPLE_OP(OP_NEGATE);
-      SIMPLE_OP(OP_POP);
-      case OP_LOAD_CONST: {
-        auto *addr = reinterpret_cast<const std::size_t *>(&it + 1);
-        std::cout << "OP_LOAD_CONST) arg: " << std::setfill('0') << std::setw(NUM_PRECISION)
-                  << *addr;
-        it += sizeof(size_t);
-        break;
-      }
-      case OP_JMP: {
-        auto *addr = reinterpret_cast<const std::size_t *>(&it + 1);
-        std::cout << "OP_JMP) arg: " << std::setfill('0') << std::setw(NUM_PRECISION) << *addr;
-        it += sizeof(size_t);
-        break;
-      }
-      case OP_JNZ: {
-        auto *addr = reinterpret_cast<const std::size_t *>(&it + 1);
-        std::cout << "OP_JNZ) arg: " << std::setfill('0') << std::setw(NUM_PRECISION) << *addr;
-        it += sizeof(size_t);
-        break;
-      }
-      case OP_JZ: {
-        auto *addr = reinterpret_cast<const std::size_t *>(&it + 1);
-        std::cout << "OP_JZ) arg: " << std::setfill('0') << std::setw(NUM_PRECISION) << *addr;
-        it += sizeof(size_t);
-        break;
-      }
+  std::cout << "== end module disassembly ==\n";
+}
+
+void helium_as::print_ngrams(const he_ngram_table &table, std::size_t top) {
+  std::vector<he_ngram> ngrams(top);
+  auto count = he_ngram_table_top(&table, ngrams.data(), top);
+
+  std::cout << "== top " << table.n << "-grams ==\n";
+
+  for (std::size_t i = 0; i < count; ++i) {
+    std::cout << std::dec << std::setfill(' ') << std::setw(12) << ngrams[i].count << ":";
+
+    for (std::size_t j = 0; j < table.n; ++j) {
+      std::cout << " " << he_opcode_name(he_ngram_opcode(&table, ngrams[i].key, j));
     }
 
     std::cout << "\n";
   }
-  std::cout << "== end module disassembly ==\n";
+
+  std::cout << "== end " << table.n << "-grams ==\n";
+}
+
+void helium_as::print_bounds(const helium::mod &mod) {
+  const he_module *raw = mod;
+
+  std::cout << "== stack bounds ==\n";
+
+  for (std::size_t i = 0; i < raw->function_count; ++i) {
+    const auto &fn = raw->functions[i];
+
+    std::cout << std::hex << std::setfill('0') << std::setw(8) << fn.offset << std::dec << ": ";
+
+    if (fn.recursive) {
+      std::cout << "recursive\n";
+    } else {
+      std::cout << fn.stack_inputs << " in, " << fn.max_stack_depth << " values, "
+                << fn.max_return_depth << " calls deep\n";
+    }
+  }
+
+  std::cout << "== end stack bounds ==\n";
 }
 
-#undef SIMPLE_OP
+void helium_as::print_stats(const helium::vm &vm) {
+  const auto &stats = vm.raw()->stats;
+
+  std::cout << "== opcode stats (" << he_vm_stats_unit() << ") ==\n";
+
+  for (std::size_t op = 0; op < HE_DISPATCH_OPCODE_COUNT; ++op) {
+    if (stats.counts[op] == 0) { continue; }
+
+    std::cout << std::dec << std::setfill(' ') << std::setw(12) << stats.counts[op]
+              << std::setw(16) << stats.time[op] << std::setw(10)
+              << stats.time[op] / stats.counts[op] << " per op: "
+              << he_opcode_name(static_cast<he_opcode>(op)) << "\n";
+  }
+
+  std::cout << "== end opcode stats ==\n";
+}
 
 static std::string stringify(const helium::value &val) {
   using type = helium::value::type;
@@ -100,36 +103,12 @@ void helium_as::print_result(const helium::vm &vm) {
   std::cout << "result: " << stringify(vm.top()) << "\n";
 }
 
-void helium_as::print_state(const helium::vm &vm) {
-  std::cout << "== VM State ==\n";
-  std::cout << "pc: " << vm.raw()->pc << "\n";
-  std::cout << "return addresses: [";
-
-  if (vm.raw()->ret_addrs.vec.size != 0) {
-    std::cout << "\n";
-
-    // i is unsigned, so I'm using the size starting at 1 and just `vec[i - 1]`
-    // it lets me check if it's valid without underflowing and without a bunch of `if`s
-    for (auto i = vm.raw()->ret_addrs.vec.size; i > 0; --i) {
-      auto addr = reinterpret_cast<int64_t *>(he_vector_at(&vm.raw()->ret_addrs.vec, i - 1));
+void helium_as::print_trace(const helium::vm &vm, std::size_t last) {
+  // flushed, so the trace written to stdout comes out after it
+  std::cout << "== last " << last << " instructions ==" << std::endl;
 
-      std::cout << "   [" << i << "]: " << std::setfill('0') << std::setw(NUM_PRECISION) << addr
-                << "\n";
-    }
-  }
-
-  std::cout << "]\n";
-  std::cout << "stack: [";
-
-  if (vm.raw()->stack.vec.size != 0) {
-    std::cout << "\n";
-
-    for (auto i = vm.raw()->stack.vec.size; i > 0; --i) {
-      auto *val = reinterpret_cast<he_value *>(he_vector_at(&vm.raw()->stack.vec, i - 1));
-
-      std::cout << "  [" << i << "]: " << stringify(helium::value(*val)) << "\n";
-    }
-  }
+  he_trace_print(&vm.raw()->trace, last, stdout);
+  std::fflush(stdout);
 
-  std::cout << "]\n";
+  std::cout << "== end trace ==\n";
 }
@@ -11,16 +11,36 @@ namespace helium_as {
   void print(const helium::mod &mod);
 
   /**
-   * @brief Prints the state of a VM
-   * @param vm The VM that owns the state to look at
+   * @brief Prints the last instructions a VM ran
+   * @param vm The VM, initialized with a trace_size
+   * @param last The most instructions to print
    */
-  void print_state(const helium::vm &vm);
+  void print_trace(const helium::vm &vm, std::size_t last);
 
   /**
    * @brief Prints the top of the stack of a VM
    * @param vm The VM that owns the stack to look at
    */
   void print_result(const helium::vm &vm);
+
+  /**
+   * @brief Prints the most frequent opcode sequences of a profile
+   * @param table The profile, made with he_vm_profile_ngrams
+   * @param top The most sequences to print
+   */
+  void print_ngrams(const he_ngram_table &table, std::size_t top);
+
+  /**
+   * @brief Prints how much of each stack every function of a verified module uses
+   * @param mod The module, verified with he_module_verify
+   */
+  void print_bounds(const helium::mod &mod);
+
+  /**
+   * @brief Prints how many times a VM ran each opcode and how long they took
+   * @param vm The VM, from a library built with HELIUM_PROFILE
+   */
+  void print_stats(const helium::vm &vm);
 } // namespace helium_as
 
 #endif
@@ -1,31 +1,135 @@
 #include "helium/cxx_bindings.hh"
 #include "helium_as.hh"
 #include "logger.hh"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
 
 using result = helium::vm::result;
 
-int main() {
+constexpr auto NGRAMS_SHOWN = 16;
+
+// the trace keeps this many instructions, and --trace shows up to that many of them
+constexpr auto TRACE_SIZE = 4096;
+constexpr auto TRACE_SHOWN = 32;
+
+int main(int argc, char **argv) {
+  auto fuse = false;
+  auto level = OPT_NONE;
+  const char *asm_path = nullptr;
+  const char *load_path = nullptr;
+  const char *save_path = nullptr;
+  auto ngram_length = std::size_t{0};
+  auto stats = false;
+  auto trace_shown = std::size_t{TRACE_SHOWN};
+
+  for (auto i = 1; i < argc; ++i) {
+    auto arg = std::string_view(argv[i]);
+
+    if (arg == "--fuse") {
+      fuse = true;
+    } else if (arg.size() == 3 && arg.substr(0, 2) == "-O" && arg[2] >= '0' && arg[2] <= '3') {
+      level = static_cast<he_opt_level>(arg[2] - '0');
+    } else if (arg == "--asm" && i + 1 < argc) {
+      asm_path = argv[++i];
+    } else if (arg == "--load" && i + 1 < argc) {
+      load_path = argv[++i];
+    } else if (arg == "--save" && i + 1 < argc) {
+      save_path = argv[++i];
+    } else if (arg == "--ngrams" && i + 1 < argc) {
+      ngram_length = std::strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--trace" && i + 1 < argc) {
+      trace_shown = std::strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--stats") {
+      stats = true;
+    }
+  }
+
   helium::mod mod;
 
-  mod.add_constant(helium::value::from_int(12));
-  mod.add_constant(helium::value::from_int(12));
-  mod.write_byte(OP_ADD);
-  mod.add_constant(helium::value::from_int(24));
-  mod.write_byte(OP_EQ);
+  if (asm_path) {
+    std::ifstream file(asm_path, std::ios::binary);
+    auto source = std::string(std::istreambuf_iterator<char>(file), {});
+
+    if (!file) {
+      std::cerr << "helium-as: unable to read '" << asm_path << "'\n";
+      return EXIT_FAILURE;
+    }
+
+    helium_as::assembler assembler(source);
+
+    if (!assembler.assemble(mod.raw())) {
+      std::cerr << asm_path << ':' << assembler.error_line() << ": " << assembler.error() << '\n';
+      return EXIT_FAILURE;
+    }
+  } else if (load_path) {
+    if (!mod.load_mapped(load_path)) {
+      std::cerr << "helium-as: unable to load module '" << load_path << "'\n";
+      return EXIT_FAILURE;
+    }
+  } else {
+    mod.add_constant(helium::value::from_int(12));
+    mod.add_constant(helium::value::from_int(12));
+    mod.write_byte(OP_ADD);
+    mod.add_constant(helium::value::from_int(24));
+    mod.write_byte(OP_EQ);
+  }
+
+  mod.optimize(level);
+
+  if (fuse) { mod.fuse(); }
+
+  auto error = he_verify_error{};
+
+  // unverified modules still run, just with every check in place
+  if (!mod.verify(&error)) {
+    std::cerr << "helium-as: warning: module failed verification at byte " << error.offset
+              << ": " << error.message << '\n';
+  }
+
+  if (save_path && !mod.save(save_path)) {
+    std::cerr << "helium-as: unable to save module to '" << save_path << "'\n";
+    return EXIT_FAILURE;
+  }
 
   helium_as::print(mod);
 
-  helium::vm vm;
-  helium_as::print_state(vm);
+  if (static_cast<const he_module *>(mod)->verified) { helium_as::print_bounds(mod); }
+
+  if (ngram_length != 0 && ngram_length <= HE_NGRAM_MAX) {
+    helium::vm vm;
+    he_ngram_table table;
+
+    he_ngram_table_init(&table, ngram_length);
 
-  vm.use(mod);
+    if (he_vm_profile_ngrams(vm.raw(), mod.raw(), &table, 0) == INTERPRET_SUCCESS) {
+      helium_as::print_ngrams(table, NGRAMS_SHOWN);
+    }
 
-  auto result = result::success;
+    he_ngram_table_destroy(&table);
+  }
 
-  do {
-    result = vm.execute_instruction();
-    helium_as::print_state(vm);
-  } while (vm.pc() != mod.ops_size());
+  auto config = he_vm_default_config();
+  config.trace_size = TRACE_SIZE;
+
+  helium::vm vm(config);
+
+  auto result = vm.run(mod);
+
+  helium_as::print_trace(vm, trace_shown);
+
+  if (result == result::failure) { return EXIT_FAILURE; }
 
   helium_as::print_result(vm);
+
+  if (stats) {
+    if (he_vm_stats_enabled()) {
+      helium_as::print_stats(vm);
+    } else {
+      std::cerr << "helium-as: --stats needs helium built with HELIUM_PROFILE\n";
+    }
+  }
 }
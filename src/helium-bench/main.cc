@@ -0,0 +1,596 @@
+#include "helium/cxx_bindings.hh"
+#include "helium/helium.h"
+#include "helium/memory.h"
+#include "helium/vector.h"
+#include "helium_as.hh"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+  /** @brief Builds a module out of instructions whose jumps are instruction indices */
+  class program {
+    helium::mod m_mod;
+    std::vector<he_module_op> m_ops;
+
+  public:
+    /** @brief The index the next instruction gets */
+    [[nodiscard]] std::size_t here() const { return m_ops.size(); }
+
+    /** @brief Adds an instruction, returning its index so a jump can be patched later */
+    std::size_t op(he_opcode opcode, std::size_t operand = 0) {
+      m_ops.push_back({static_cast<std::uint8_t>(opcode), operand});
+
+      return m_ops.size() - 1;
+    }
+
+    void constant(he_value val) { op(OP_LOAD_CONST, he_module_push_constant(m_mod.raw(), val)); }
+
+    void patch(std::size_t at, std::size_t target) { m_ops[at].operand = target; }
+
+    /** @brief Writes the instructions into the module */
+    const helium::mod &finish() {
+      he_module_write_ops(m_mod.raw(), m_ops.data(), m_ops.size());
+
+      return m_mod;
+    }
+
+    /** @brief Writes the instructions into the module and runs the verifier over it */
+    const helium::mod &finish_verified() {
+      finish();
+      he_module_verify(m_mod.raw(), nullptr);
+
+      return m_mod;
+    }
+  };
+
+  /** @brief Runs @p body (which must leave the stack as it found it) @p count times */
+  template <class Body> void repeat(program &p, std::int64_t count, Body body) {
+    p.constant(he_val_from_int(count));
+
+    auto loop = p.here();
+    body();
+
+    p.constant(he_val_from_int(1));
+    p.op(OP_SUB);
+    p.op(OP_DUP);
+    p.constant(he_val_from_int(0));
+    p.op(OP_GT);
+    auto again = p.op(OP_JZ);
+    p.op(OP_POP);
+    auto out = p.op(OP_JMP);
+    p.patch(again, p.here());
+    p.op(OP_POP);
+    p.op(OP_JMP, loop);
+    p.patch(out, p.here());
+    p.op(OP_POP);
+  }
+
+  /** @brief An empty loop, nothing but dispatch and the loop's own compare and branch */
+  void build_dispatch(program &p, std::int64_t scale) {
+    repeat(p, 2'000'000 * scale, [] {});
+  }
+
+  /** @brief Long integer and float expressions */
+  void build_arithmetic(program &p, std::int64_t scale) {
+    repeat(p, 200'000 * scale, [&] {
+      p.constant(he_val_from_int(3));
+      p.constant(he_val_from_int(4));
+      p.op(OP_MUL);
+      p.constant(he_val_from_int(5));
+      p.op(OP_ADD);
+      p.constant(he_val_from_int(2));
+      p.op(OP_SUB);
+      p.constant(he_val_from_int(7));
+      p.op(OP_MUL);
+      p.constant(he_val_from_int(9));
+      p.op(OP_MOD);
+      p.op(OP_NEGATE);
+      p.constant(he_val_from_int(-1));
+      p.op(OP_LT);
+      p.op(OP_POP);
+      p.constant(he_val_from_float(1.5));
+      p.constant(he_val_from_float(2.25));
+      p.op(OP_MUL);
+      p.constant(he_val_from_float(0.5));
+      p.op(OP_DIV);
+      p.constant(he_val_from_float(3.0));
+      p.op(OP_GTEQ);
+      p.op(OP_POP);
+    });
+  }
+
+  constexpr auto RECURSION_DEPTH = 1000;
+
+  // the register interpreter keeps two words per frame, with room to spare
+  constexpr auto RETURN_STACK_SIZE = RECURSION_DEPTH * 4;
+
+  /** @brief Counts down to zero through @p RECURSION_DEPTH nested calls, over and over */
+  void build_recursion(program &p, std::int64_t scale) {
+    auto call = std::size_t{0};
+
+    repeat(p, 500 * scale, [&] {
+      p.constant(he_val_from_int(RECURSION_DEPTH));
+      call = p.op(OP_CALL);
+      p.op(OP_POP);
+    });
+
+    p.op(OP_HALT);
+
+    // f(n): n > 0 ? f(n - 1) : n
+    auto fn = p.here();
+    p.op(OP_DUP);
+    p.constant(he_val_from_int(0));
+    p.op(OP_GT);
+    auto base = p.op(OP_JNZ);
+    p.op(OP_POP);
+    p.constant(he_val_from_int(1));
+    p.op(OP_SUB);
+    p.op(OP_CALL, fn);
+    p.op(OP_RET);
+    p.patch(base, p.here());
+    p.op(OP_POP);
+    p.op(OP_RET);
+
+    p.patch(call, fn);
+  }
+
+  constexpr auto POOL_CONSTANTS = 1024;
+
+  /** @brief A loop body that sums a thousand different constants from the pool */
+  void build_constants(program &p, std::int64_t scale) {
+    repeat(p, 2'000 * scale, [&] {
+      p.constant(he_val_from_int(0));
+
+      for (auto i = 1; i < POOL_CONSTANTS; ++i) {
+        p.constant(he_val_from_int(i * 7919));
+        p.op(OP_ADD);
+      }
+
+      p.op(OP_POP);
+    });
+  }
+
+  /** @brief The result of timing one workload */
+  struct measurement {
+    const char *name;
+    const char *engine;
+    std::size_t runs;
+    std::uint64_t operations;
+    double median_seconds;
+    double best_seconds;
+    std::size_t allocations;
+    std::size_t allocated_bytes;
+    bool ok;
+  };
+
+  double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  /** @brief Counts the instructions a module runs by stepping through it */
+  std::uint64_t count_instructions(const helium::mod &mod, const he_vm_config &config) {
+    helium::vm vm(config);
+    const he_module *raw = mod;
+    auto count = std::uint64_t{0};
+
+    vm.use(mod);
+
+    while (vm.pc() < raw->ops.size && raw->ops.array[vm.pc()] != OP_HALT) {
+      if (vm.execute_instruction() == helium::vm::result::failure) { return 0; }
+
+      ++count;
+    }
+
+    return count;
+  }
+
+  /** @brief Fills in the timing part of a measurement from the time of every run */
+  void summarize(measurement &m, std::vector<double> &times, he_memory_stats before) {
+    auto after = he_memory_stats_get();
+
+    std::sort(times.begin(), times.end());
+
+    m.runs = times.size();
+    m.median_seconds = times[times.size() / 2];
+    m.best_seconds = times.front();
+    m.allocations = (after.allocations - before.allocations) / times.size();
+    m.allocated_bytes = (after.bytes - before.bytes) / times.size();
+  }
+
+  struct engine_choice {
+    const char *name;
+    he_vm_engine engine;
+
+    /** @brief The VM's trace_size, traced VMs always run on the stack interpreter */
+    std::size_t trace_size;
+  };
+
+  measurement run_module(const char *name, const helium::mod &mod, std::uint64_t instructions,
+                         const engine_choice &engine, std::size_t runs) {
+    auto config = he_vm_default_config();
+    config.engine = engine.engine;
+    config.return_stack_size = RETURN_STACK_SIZE;
+    config.trace_size = engine.trace_size;
+
+    auto m = measurement{name, engine.name, 0, instructions, 0, 0, 0, 0, instructions != 0};
+    helium::vm vm(config);
+
+    // the first run decodes, translates or compiles the module, which isn't timed
+    m.ok = m.ok && vm.run(mod) == helium::vm::result::success;
+
+    std::vector<double> times;
+    auto before = he_memory_stats_get();
+
+    for (std::size_t i = 0; i < runs && m.ok; ++i) {
+      he_vm_reset(vm.raw());
+
+      auto start = std::chrono::steady_clock::now();
+      m.ok = vm.run(mod) == helium::vm::result::success;
+      times.push_back(seconds_since(start));
+    }
+
+    if (m.ok) { summarize(m, times, before); }
+
+    return m;
+  }
+
+  /** @brief Pushes and pops integers through a he_vector, growing it from empty every run */
+  measurement run_vector(std::int64_t scale, std::size_t runs) {
+    const auto count = static_cast<std::size_t>(1'000'000 * scale);
+    auto m = measurement{"vector", "none", 0, 2 * count, 0, 0, 0, 0, true};
+
+    std::vector<double> times;
+    auto before = he_memory_stats_get();
+
+    for (std::size_t i = 0; i < runs; ++i) {
+      he_vector vec;
+      auto sum = std::int64_t{0};
+
+      auto start = std::chrono::steady_clock::now();
+      he_vector_init(&vec, sizeof(std::int64_t));
+
+      for (std::size_t j = 0; j < count; ++j) {
+        auto item = static_cast<std::int64_t>(j);
+        he_vector_push_val(&vec, item);
+      }
+
+      for (std::size_t j = 0; j < count; ++j) {
+        auto item = std::int64_t{0};
+        he_vector_pop(&vec, &item);
+        sum += item;
+      }
+
+      he_vector_destroy(&vec);
+      times.push_back(seconds_since(start));
+
+      m.ok = m.ok && sum == static_cast<std::int64_t>(count * (count - 1) / 2);
+    }
+
+    summarize(m, times, before);
+
+    return m;
+  }
+
+  constexpr auto ASSEMBLER_BLOCKS = 50'000;
+
+  /**
+   * @brief Writes assembly for the assembler benchmark, about 12 MB of it per unit of
+   * scale with a label, a forward and a backward jump and every kind of constant per block
+   */
+  std::string generate_assembly(std::int64_t scale) {
+    std::string source;
+    char line[64];
+
+    for (std::int64_t i = 0; i < ASSEMBLER_BLOCKS * scale; ++i) {
+      auto append = [&](int length) { source.append(line, static_cast<std::size_t>(length)); };
+
+      append(std::snprintf(line, sizeof(line), "block_%lld:\n", static_cast<long long>(i)));
+      append(std::snprintf(line, sizeof(line), "    load_const %lld\n",
+                           static_cast<long long>(i * 7919)));
+      source += "    load_const 2.5\n"
+                "    mul\n"
+                "    load_const_add 0x7f  ; fused\n"
+                "    dup\n"
+                "    load_const \"block\"\n"
+                "    pop\n"
+                "    LOAD_CONST true\n"
+                "    jnz skip_";
+      append(std::snprintf(line, sizeof(line), "%lld\n", static_cast<long long>(i)));
+      source += "    load_const -1\n"
+                "    gt\n"
+                "    jz block_";
+      append(std::snprintf(line, sizeof(line), "%lld\n", static_cast<long long>(i)));
+      append(std::snprintf(line, sizeof(line), "skip_%lld:\n", static_cast<long long>(i)));
+      source += "    pop\n"
+                "    pop\n";
+    }
+
+    source += "    halt\n";
+
+    return source;
+  }
+
+  /** @brief Assembles generated source, one operation per byte so Mops/s reads as MB/s */
+  measurement run_assembler(std::int64_t scale, std::size_t runs) {
+    auto source = generate_assembly(scale);
+    auto m = measurement{"assembler", "none", 0, source.size(), 0, 0, 0, 0, true};
+
+    std::vector<double> times;
+    auto before = he_memory_stats_get();
+
+    for (std::size_t i = 0; i < runs && m.ok; ++i) {
+      helium_as::assembler assembler(source);
+
+      auto start = std::chrono::steady_clock::now();
+      auto mod = assembler.assemble();
+      times.push_back(seconds_since(start));
+
+      m.ok = assembler.error().empty() && mod.ops.size != 0;
+      he_module_destroy(&mod);
+    }
+
+    if (m.ok) { summarize(m, times, before); }
+
+    return m;
+  }
+
+  /** @brief Disassembles the assembler benchmark's module into a buffer, per bytecode byte */
+  measurement run_disassembler(std::int64_t scale, std::size_t runs) {
+    auto source = generate_assembly(scale);
+    auto mod = helium_as::assembler(source).assemble();
+    auto m = measurement{"disasm", "none", 0, mod.ops.size, 0, 0, 0, 0, mod.ops.size != 0};
+
+    std::vector<char> buffer(64 * 1024);
+    std::vector<double> times;
+    auto before = he_memory_stats_get();
+
+    for (std::size_t i = 0; i < runs && m.ok; ++i) {
+      auto offset = std::size_t{0};
+      auto characters = std::size_t{0};
+
+      auto start = std::chrono::steady_clock::now();
+
+      while (auto written = he_disasm_range(&mod, &offset, mod.ops.size, buffer.data(),
+                                            buffer.size())) {
+        characters += written;
+      }
+
+      times.push_back(seconds_since(start));
+
+      m.ok = characters != 0;
+    }
+
+    if (m.ok) { summarize(m, times, before); }
+
+    he_module_destroy(&mod);
+
+    return m;
+  }
+
+  constexpr auto BATCH_LANES = 100'000;
+
+  /** @brief An integer expression over two inputs, the module every batch lane runs */
+  void build_lane_expression(program &p) {
+    p.op(OP_MUL);
+    p.constant(he_val_from_int(3));
+    p.op(OP_ADD);
+    p.constant(he_val_from_int(7));
+    p.op(OP_MUL);
+    p.constant(he_val_from_int(1000));
+    p.op(OP_SUB);
+    p.op(OP_NEGATE);
+    p.constant(he_val_from_int(2));
+    p.op(OP_MUL);
+    p.constant(he_val_from_int(5));
+    p.op(OP_ADD);
+  }
+
+  /**
+   * @brief Runs the lane expression over many inputs, one operation per lane. The "lanes"
+   * engine is he_vm_run_batch, "stack" runs every lane through he_vm_run
+   */
+  measurement run_batch(std::int64_t scale, std::size_t runs, bool batched) {
+    const auto lanes = static_cast<std::size_t>(BATCH_LANES * scale);
+    auto m = measurement{"batch", batched ? "lanes" : "stack", 0, lanes, 0, 0, 0, 0, true};
+
+    program p;
+    build_lane_expression(p);
+
+    const auto &mod = p.finish_verified();
+    std::vector<he_value> inputs;
+    std::vector<he_value> results(lanes);
+
+    for (std::size_t i = 0; i < lanes; ++i) {
+      inputs.push_back(he_val_from_int(static_cast<std::int64_t>(i)));
+      inputs.push_back(he_val_from_int(static_cast<std::int64_t>(i % 97)));
+    }
+
+    helium::vm vm;
+    vm.use(mod);
+
+    std::vector<double> times;
+    auto before = he_memory_stats_get();
+
+    for (std::size_t i = 0; i < runs && m.ok; ++i) {
+      auto start = std::chrono::steady_clock::now();
+
+      if (batched) {
+        m.ok = he_vm_run_batch(vm.raw(), mod, inputs.data(), 2, lanes, results.data(),
+                               nullptr) == INTERPRET_SUCCESS;
+      } else {
+        for (std::size_t lane = 0; lane < lanes && m.ok; ++lane) {
+          he_vm_reset(vm.raw());
+          he_vm_push_values(vm.raw(), &inputs[lane * 2], 2);
+
+          m.ok = he_vm_run(vm.raw(), mod) == INTERPRET_SUCCESS;
+          results[lane] = vm.raw()->stack.sp[-1];
+        }
+      }
+
+      times.push_back(seconds_since(start));
+    }
+
+    if (m.ok) { summarize(m, times, before); }
+
+    return m;
+  }
+
+  void print_text(const std::vector<measurement> &results) {
+    std::printf("%-12s %-9s %14s %10s %12s %12s %12s\n", "benchmark", "engine", "operations",
+                "ns/op", "Mops/s", "allocs/run", "bytes/run");
+
+    for (const auto &m : results) {
+      if (!m.ok) {
+        std::printf("%-12s %-9s failed\n", m.name, m.engine);
+        continue;
+      }
+
+      auto ops = static_cast<double>(m.operations);
+
+      std::printf("%-12s %-9s %14llu %10.3f %12.1f %12zu %12zu\n", m.name, m.engine,
+                  static_cast<unsigned long long>(m.operations), m.median_seconds * 1e9 / ops,
+                  ops / m.median_seconds / 1e6, m.allocations, m.allocated_bytes);
+    }
+  }
+
+  void print_json(const std::vector<measurement> &results, std::int64_t scale) {
+    std::printf("{\n");
+    std::printf("  \"value_size\": %zu,\n", sizeof(he_value));
+    std::printf("  \"jit\": %s,\n", he_jit_supported() ? "true" : "false");
+    std::printf("  \"profiling\": %s,\n", he_vm_stats_enabled() ? "true" : "false");
+    std::printf("  \"scale\": %lld,\n", static_cast<long long>(scale));
+    std::printf("  \"benchmarks\": [");
+
+    for (std::size_t i = 0; i < results.size(); ++i) {
+      const auto &m = results[i];
+      auto ops = static_cast<double>(m.operations);
+
+      std::printf("%s\n    {\"name\": \"%s\", \"engine\": \"%s\", \"ok\": %s", i ? "," : "",
+                  m.name, m.engine, m.ok ? "true" : "false");
+
+      if (m.ok) {
+        std::printf(", \"runs\": %zu, \"operations\": %llu, \"median_seconds\": %.9f, "
+                    "\"best_seconds\": %.9f, \"ns_per_op\": %.4f, \"ops_per_second\": %.1f, "
+                    "\"allocations_per_run\": %zu, \"allocated_bytes_per_run\": %zu",
+                    m.runs, static_cast<unsigned long long>(m.operations), m.median_seconds,
+                    m.best_seconds, m.median_seconds * 1e9 / ops, ops / m.median_seconds,
+                    m.allocations, m.allocated_bytes);
+      }
+
+      std::printf("}");
+    }
+
+    std::printf("\n  ]\n}\n");
+  }
+
+  constexpr auto TRACE_SIZE = std::size_t{1024};
+
+  constexpr engine_choice ENGINES[] = {
+      {"stack", ENGINE_STACK, 0},
+      {"traced", ENGINE_STACK, TRACE_SIZE},
+      {"register", ENGINE_REGISTER, 0},
+      {"jit", ENGINE_JIT, 0},
+  };
+
+  struct workload {
+    const char *name;
+    void (*build)(program &, std::int64_t);
+  };
+
+  constexpr workload WORKLOADS[] = {
+      {"dispatch", build_dispatch},
+      {"arithmetic", build_arithmetic},
+      {"recursion", build_recursion},
+      {"constants", build_constants},
+  };
+
+  constexpr auto DEFAULT_RUNS = 5;
+} // namespace
+
+int main(int argc, char **argv) {
+  auto json = false;
+  auto runs = std::size_t{DEFAULT_RUNS};
+  auto scale = std::int64_t{1};
+  const char *only_engine = nullptr;
+  const char *only_benchmark = nullptr;
+
+  for (auto i = 1; i < argc; ++i) {
+    auto arg = std::string_view(argv[i]);
+
+    if (arg == "--json") {
+      json = true;
+    } else if (arg == "--runs" && i + 1 < argc) {
+      runs = std::max<std::size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--scale" && i + 1 < argc) {
+      scale = std::max<std::int64_t>(1, std::strtoll(argv[++i], nullptr, 10));
+    } else if (arg == "--engine" && i + 1 < argc) {
+      only_engine = argv[++i];
+    } else if (arg == "--benchmark" && i + 1 < argc) {
+      only_benchmark = argv[++i];
+    } else {
+      std::fprintf(stderr,
+                   "usage: helium-bench [--json] [--runs N] [--scale N] "
+                   "[--engine stack|traced|register|jit] [--benchmark NAME]\n");
+      return EXIT_FAILURE;
+    }
+  }
+
+  auto wanted = [](const char *only, const char *name) {
+    return !only || std::strcmp(only, name) == 0;
+  };
+
+  std::vector<measurement> results;
+
+  for (const auto &w : WORKLOADS) {
+    if (!wanted(only_benchmark, w.name)) { continue; }
+
+    program p;
+    w.build(p, scale);
+
+    const auto &mod = p.finish();
+    auto config = he_vm_default_config();
+    config.return_stack_size = RETURN_STACK_SIZE;
+
+    auto instructions = count_instructions(mod, config);
+
+    for (const auto &e : ENGINES) {
+      if (wanted(only_engine, e.name)) {
+        results.push_back(run_module(w.name, mod, instructions, e, runs));
+      }
+    }
+  }
+
+  if (wanted(only_benchmark, "vector") && !only_engine) {
+    results.push_back(run_vector(scale, runs));
+  }
+
+  if (wanted(only_benchmark, "assembler") && !only_engine) {
+    results.push_back(run_assembler(scale, runs));
+  }
+
+  if (wanted(only_benchmark, "disasm") && !only_engine) {
+    results.push_back(run_disassembler(scale, runs));
+  }
+
+  if (wanted(only_benchmark, "batch") && !only_engine) {
+    results.push_back(run_batch(scale, runs, false));
+    results.push_back(run_batch(scale, runs, true));
+  }
+
+  if (json) {
+    print_json(results, scale);
+  } else {
+    print_text(results);
+  }
+
+  auto failed = std::any_of(results.begin(), results.end(), [](const auto &m) { return !m.ok; });
+
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}